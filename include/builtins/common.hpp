@@ -1,5 +1,6 @@
 #pragma once
 #include <interpreter/types.hpp>
+#include <cmath>
 #include <stdexcept>
 #include <string>
 
@@ -25,7 +26,7 @@ assert_vec_type(const ArgList& args, const std::string& type) {
 
 inline void
 assert_callable(const Obj& obj) {
-  if (!is_procedure(obj) && !is_builtin(obj)) {
+  if (!is_callable(obj)) {
     throw std::runtime_error("incorrect type for " + stringify(obj) + ", expected procedure");
   }
 }
@@ -58,6 +59,25 @@ assert_numbers(const ArgList& args, size_t lb, size_t rb) {
   }
 }
 
+// a non-negative integer no greater than limit
+inline size_t
+get_index(const Obj& obj, const size_t limit) {
+  assert_obj_type<double>(obj, "number");
+  const auto n = as_number(obj);
+  if (!(0 <= n && n <= limit) || n != std::trunc(n)) {
+    throw std::runtime_error("index " + stringify(obj) + " out of range");
+  }
+  return n;
+}
+
+// optional [start [end]] arguments beginning at args[from]
+inline std::pair<size_t, size_t>
+get_range(const ArgList& args, const size_t from, const size_t length) {
+  const size_t end = args.size() > from + 1 ? get_index(args[from + 1], length) : length;
+  const size_t start = args.size() > from ? get_index(args[from], end) : 0;
+  return {start, end};
+}
+
 inline double 
 get_single_number(const ArgList& args) {
   assert_numbers(args, 1, 1);
@@ -10,7 +10,7 @@ private:
   Environment *env;
   Interpreter& interp;
 
-  void install(const std::string& str, const std::function<Obj(const ArgList&, Interpreter&)> func);
+  void install(const std::string& str, const std::function<Obj(ArgList&, Interpreter&)> func, Primitive prim = Primitive::NONE);
 
 public:
   BuiltinInstaller(Environment *env, Interpreter& interp): env {env}, interp {interp} {}
@@ -18,6 +18,14 @@ public:
   void install_data_functions();
   void install_predicates();
   void install_misc_functions();
+  void install_list_functions();
+  void install_hash_table_functions();
+  void install_bytevector_functions();
+  void install_string_functions();
+  void install_persistent_map_functions();
+  void install_sort_functions();
+  void install_lazy_functions();
+  void install_control_functions();
   void install_all_functions();
 
 };
@@ -0,0 +1,109 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <new>
+
+namespace Scheme {
+
+// a buffer that a collection during evaluation can find. argument lists and
+// the other vectors of Objs that builtins keep on the C++ stack allocate
+// here, so that a pointer into one found on a stack leads the collector to
+// the Objs it holds. the live buffers are linked in a ring after a header.
+//
+// a continuation holds the buffers its copy of the stack refers to. one
+// released while held is parked, off the ring, until the continuation
+// brings it back to life or lets it go.
+struct alignas(16) ScannedBlock {
+  ScannedBlock *prev;
+  ScannedBlock *next;
+  size_t bytes;
+  bool scanned;
+  bool released;
+  uint32_t holds;
+};
+
+inline ScannedBlock scanned_blocks {&scanned_blocks, &scanned_blocks, 0, false, false, 0};
+
+inline void
+link_scanned(ScannedBlock *block) {
+  block->prev = &scanned_blocks;
+  block->next = scanned_blocks.next;
+  scanned_blocks.next->prev = block;
+  scanned_blocks.next = block;
+}
+
+inline void
+unlink_scanned(ScannedBlock *block) noexcept {
+  block->prev->next = block->next;
+  block->next->prev = block->prev;
+  block->prev = block;
+  block->next = block;
+}
+
+inline void*
+allocate_scanned(const size_t bytes) {
+  const auto block = static_cast<ScannedBlock*>(::operator new(sizeof(ScannedBlock) + bytes));
+  block->bytes = bytes;
+  block->scanned = false;
+  block->released = false;
+  block->holds = 0;
+  link_scanned(block);
+  return block + 1;
+}
+
+inline void
+release_scanned(void *ptr) noexcept {
+  const auto block = static_cast<ScannedBlock*>(ptr) - 1;
+  unlink_scanned(block);
+  if (block->holds) {
+    block->released = true;
+  }
+  else {
+    ::operator delete(block);
+  }
+}
+
+// takes the buffer of a vector that an object on the heap now owns out of
+// the ring. the collector reaches what it holds through the owner, and a
+// continuation only looks for the buffers of frames among those left.
+template<typename Vec>
+void
+disown_scanned(const Vec& vec) noexcept {
+  if (vec.capacity()) {
+    unlink_scanned(reinterpret_cast<ScannedBlock*>(const_cast<typename Vec::value_type*>(vec.data())) - 1);
+  }
+}
+
+// a continuation's hold on a buffer, and its letting go of one
+inline void
+hold_scanned(ScannedBlock *block) noexcept {
+  block->holds++;
+}
+
+inline void
+drop_scanned(ScannedBlock *block) noexcept {
+  if (--block->holds == 0 && block->released) {
+    ::operator delete(block);
+  }
+}
+
+template<typename T>
+struct ScannedAllocator {
+  using value_type = T;
+
+  ScannedAllocator() noexcept = default;
+  template<typename U>
+  ScannedAllocator(const ScannedAllocator<U>&) noexcept {}
+
+  T *allocate(const size_t n) {
+    return static_cast<T*>(allocate_scanned(n * sizeof(T)));
+  }
+  void deallocate(T *ptr, size_t) noexcept {
+    release_scanned(ptr);
+  }
+
+  template<typename U>
+  bool operator==(const ScannedAllocator<U>&) const noexcept {return true;}
+};
+
+}
@@ -0,0 +1,190 @@
+#pragma once
+#include <interpreter/types.hpp>
+#include <exception>
+#include <memory>
+#include <optional>
+#include <utility>
+#include <vector>
+
+namespace Scheme {
+
+struct HandlerFrame;
+class ParameterSwap;
+struct Fiber;
+struct Segment;
+class Winder;
+class ContinuationFrame;
+class Allocator;
+
+// a thunk run on a stack of its own, so that it can be suspended anywhere in
+// the evaluator by yield. calling the coroutine resumes it: the call returns
+// the value given to yield, or the eof object once the thunk has returned.
+// a value passed to the call becomes the result of the suspended yield.
+class Coroutine : public HeapEntity {
+public:
+  enum class Status {READY, RUNNING, SUSPENDED, DONE};
+
+  Obj thunk;
+  Status status;
+  // the value passing through the switch, in either direction
+  Obj transfer;
+  std::unique_ptr<Fiber> fiber;
+  Coroutine *resumer;
+  // the coroutine's own dynamic state, kept here while it is switched out
+  HandlerFrame *handlers;
+  ParameterSwap *parameterizations;
+  Winder *winders;
+  ContinuationFrame *continuation_frames;
+  std::exception_ptr error;
+  bool abandoned;
+  // the interpreter's stack limit while the coroutine is switched out
+  char *stack_limit;
+  // the innermost segment the coroutine runs on while it is switched out,
+  // and its resumer's while it runs, and the same for the calls counted
+  // against the stack limit
+  Segment *segments;
+  size_t call_depth;
+  // whether a collection has scanned its stacks yet
+  bool scanned;
+
+  explicit Coroutine(Obj thunk);
+  ~Coroutine();
+  void push_children(MarkStack&) override;
+  // roots what its stacks hold while it is suspended
+  void scan(Allocator&, std::vector<HeapEntity*>&) const;
+};
+
+// thrown from yield in a coroutine that is being discarded, to unwind its
+// stack. it does not derive from std::exception, so nothing but the
+// coroutine's own entry stops it.
+struct CoroutineAbandoned {};
+
+Obj resume(Coroutine*, const ArgList&, Interpreter&);
+Obj yield(Obj, Interpreter&);
+void abandon(Coroutine*, Interpreter&);
+
+// a dynamic-wind in effect, from when its before thunk has returned until
+// its after thunk is called. the ones in effect link outward through the
+// interpreter, each with a serial number, so a continuation can tell which
+// of those it was captured under are still in effect when it is invoked.
+class Winder {
+private:
+  Interpreter& interp;
+  inline static uint64_t serials = 0;
+public:
+  const Obj before;
+  const Obj after;
+  const uint64_t serial;
+  Winder *const outer;
+
+  Winder(Obj before, Obj after, Interpreter&);
+  ~Winder();
+};
+
+// what call/cc passes to its procedure. while the call/cc has not returned,
+// invoking the continuation throws to its frame, so an escape costs one
+// unwind and copies nothing. as the call/cc returns, the frames from it up
+// to the top-level form are copied, with the argument buffers they own;
+// invoking the continuation after that unwinds the form being evaluated and
+// copies them back, and the call/cc returns again. one captured in a
+// generator, on a segment of deep recursion or over a frame that cannot be
+// copied stays escape-only, as does one that call/cc can tell only an
+// escape will ever invoke, which is not copied at all.
+class Continuation : public Builtin {
+public:
+  // how many of its call/cc frames are on a stack now
+  size_t active;
+  // the copy of the stack, which ran from low up to top
+  char *low;
+  char *top;
+  std::unique_ptr<char[]> image;
+  // the buffers the copy refers to, held so they outlive their frames, and
+  // what each held when it was copied
+  std::vector<std::pair<ScannedBlock*, std::unique_ptr<char[]>>> buffers;
+  // the dynamic state in effect at the call/cc, as far as the top-level
+  // form: the chains the copied frames link into, the calls they make up,
+  // the value of each parameter bound there, the before thunk of each
+  // dynamic-wind by serial number, outermost first, the continuations whose
+  // call/cc frames were copied along and the forms being evaluated
+  HandlerFrame *handlers;
+  ParameterSwap *parameterizations;
+  Winder *winders;
+  ContinuationFrame *frames;
+  size_t call_depth;
+  std::vector<std::pair<Parameter*, Obj>> parameters;
+  std::vector<std::pair<uint64_t, Obj>> winds;
+  std::vector<Continuation*> calls;
+  std::vector<Expression*> evaluating;
+  // an error leaving the call/cc, kept here while the stack is copied, as
+  // a copy of the frame holding it would release it a second time
+  std::exception_ptr error;
+  // whether a collection has scanned the copy yet
+  bool scanned;
+
+  Continuation();
+  ~Continuation();
+  void push_children(MarkStack&) override;
+  // roots what the copy and its buffers point to, as a scan of a stack would
+  void scan(Allocator&, std::vector<HeapEntity*>&) const;
+  // the memory the copies take
+  size_t bytes() const;
+};
+
+// a call/cc that has not returned, linked outward through the interpreter
+class ContinuationFrame {
+private:
+  Interpreter& interp;
+public:
+  Continuation *const k;
+  ContinuationFrame *const outer;
+
+  ContinuationFrame(Continuation*, Interpreter&);
+  ~ContinuationFrame();
+};
+
+// marks a frame that owns what a copy of it would release again, such as
+// an exception held to be thrown once more. a continuation captured while
+// one is on the stack stays escape-only.
+class UncopyableFrame {
+private:
+  Interpreter& interp;
+  const bool counted;
+public:
+  UncopyableFrame(Interpreter&, bool counted = true);
+  ~UncopyableFrame();
+};
+
+// evaluates a top-level form. continuations are captured from their call/cc
+// up to here, and re-entered here: the form being evaluated when one is
+// invoked is unwound, and evaluation goes on in the copy.
+Obj run_delimited(Expression*, Interpreter&);
+
+// copies the stack for a continuation whose call/cc is returning. returns
+// nothing then, and the values the continuation was invoked with when the
+// copy is running again.
+std::optional<Obj> capture(Continuation*, Interpreter&);
+
+// what invoking a continuation does, by throwing
+[[noreturn]] void invoke(Continuation*, const ArgList&, Interpreter&);
+
+// the stack limit of the thread's own stack, leaving room below for the
+// native code that runs between checks
+char *main_stack_limit();
+
+// applies a procedure on a fresh stack segment, for a call made when the
+// current stack has run down to its limit. the calls made on segments are
+// bounded by the interpreter's call budget; past that apply fails with an
+// error that Scheme code can catch.
+Obj apply_on_new_segment(Obj, ArgList, Interpreter&);
+
+// scans every stack in use for a collection during evaluation: the running
+// one from here up, and those switched out beneath it, of the segments it
+// runs on and of the coroutines that resumed it. false if the thread's own
+// stack cannot be found, and so cannot be scanned.
+bool scan_stacks(Interpreter&, std::vector<HeapEntity*>&);
+
+// zeroes a stretch of the stack below the caller, so that the frames made
+// there next hold no stale pointers for those scans to find
+void clear_stack();
+
+}
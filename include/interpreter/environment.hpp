@@ -14,6 +14,7 @@ public:
   Environment *const super;
   Environment(): frame {}, super {nullptr} {};
   Environment(Environment *super): frame {}, super {super} {};
+  const std::unordered_map<Symbol, Obj>& bindings() const {return frame;}
   Obj& get(const Symbol&);
   std::pair<Obj&, int> get_with_depth(const Symbol&);
   void set(const Symbol&, const Obj);
@@ -1,11 +1,18 @@
 #pragma once
 #include <interpreter/types.hpp>
 #include <interpreter/expressions.hpp>
+#include <interpreter/interpreter.hpp>
 
 namespace Scheme {
 
-class Interpreter;
-
 EvalResult apply(Obj, ArgList, Interpreter&);
+Builtin *make_record_procedure(RecordType*, RecordRole, size_t, Interpreter&);
+
+// apply for builtins that need the procedure's value rather than a tail call.
+// that is a single value, as what they do with it is keep or test it.
+inline Obj
+call(const Obj& proc, ArgList args, Interpreter& interp) {
+  return interp.one_value(as_obj(apply(proc, std::move(args), interp)));
+}
 
 }
@@ -0,0 +1,127 @@
+#pragma once
+#include <interpreter/types.hpp>
+#include <interpreter/interpreter.hpp>
+#include <interpreter/coroutine.hpp>
+#include <algorithm>
+#include <exception>
+#include <string>
+
+namespace Scheme {
+
+// a with-exception-handler or guard in effect. frames live on the C++ stack
+// of the form that installed them and link outward. a guard's frame has no
+// handler: raising to it unwinds to the guard instead of calling out.
+struct HandlerFrame {
+  Obj handler;
+  HandlerFrame *outer;
+  bool is_guard() const {return is_void(handler);}
+};
+
+// makes frame the innermost handler until the scope ends
+class HandlerScope {
+private:
+  Interpreter& interp;
+  HandlerFrame *const saved;
+public:
+  HandlerScope(Interpreter& interp, HandlerFrame *frame): interp {interp}, saved {interp.handlers} {
+    interp.handlers = frame;
+  }
+  ~HandlerScope() {
+    interp.handlers = saved;
+  }
+};
+
+// a raised object unwinding to the guard that owns target, or to the top
+// level when target is null. the message is only formatted if what() is
+// asked for it.
+class SchemeError : public std::exception {
+private:
+  const RecordType *error_type;
+  mutable std::string message;
+  // the payload stays a root while the error is in flight
+  PinnedObj pin;
+public:
+  Obj payload;
+  const HandlerFrame *const target;
+  SchemeError(Obj payload, const HandlerFrame *target, const Interpreter& interp):
+    error_type {interp.get_error_type()},
+    message {},
+    pin {this->payload},
+    payload {std::move(payload)},
+    target {target}
+  {}
+  SchemeError(const SchemeError& other):
+    std::exception(other),
+    error_type {other.error_type},
+    message {other.message},
+    pin {payload},
+    payload {other.payload},
+    target {other.target}
+  {}
+  const char *what() const noexcept override;
+};
+
+// thrown by invoking a continuation whose call/cc has not returned. it
+// carries no message, so escaping costs one unwind to that call/cc and
+// nothing else. it does not derive from std::exception, so only that
+// frame stops it. values is the one value passed, or a vector of them.
+struct ContinuationThrow {
+  Continuation *k;
+  Obj values;
+  bool many;
+  // the values stay a root while the throw is in flight
+  PinnedObj pin;
+  ContinuationThrow(Continuation *k, Obj values, bool many):
+    k {k},
+    values {std::move(values)},
+    many {many},
+    pin {this->values}
+  {}
+  ContinuationThrow(const ContinuationThrow& other):
+    k {other.k},
+    values {other.values},
+    many {other.many},
+    pin {values}
+  {}
+};
+
+// thrown by invoking a continuation whose call/cc has returned, to unwind
+// the top-level form to where the copy of the stack is put back. the
+// first common of the dynamic-winds the continuation was captured under
+// are still in effect, and let it pass without calling their after thunks.
+struct Reinstate {
+  Obj k;
+  Obj values;
+  bool many;
+  size_t common;
+  PinnedObj k_pin;
+  PinnedObj pin;
+  Reinstate(Continuation *k, Obj values, bool many, size_t common):
+    k {k},
+    values {std::move(values)},
+    many {many},
+    common {common},
+    k_pin {this->k},
+    pin {this->values}
+  {}
+  Reinstate(const Reinstate& other):
+    k {other.k},
+    values {other.values},
+    many {other.many},
+    common {other.common},
+    k_pin {k},
+    pin {values}
+  {}
+  Continuation *target() const {return static_cast<Continuation*>(as_builtin(k));}
+  bool keeps(const Winder& wind) const {
+    const auto& winds = target()->winds;
+    return std::any_of(winds.begin(), winds.begin() + common, [&](const auto& w) {return w.first == wind.serial;});
+  }
+};
+
+Obj make_error_object(Obj message, Obj irritants, Interpreter&);
+Obj make_error_object(const std::exception&, Interpreter&);
+bool is_error_object(const Obj&, const Interpreter&);
+Obj raise(Obj, bool continuable, Interpreter&);
+
+}
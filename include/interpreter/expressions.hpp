@@ -3,10 +3,12 @@
 #include <interpreter/environment.hpp>
 #include <interpreter/interpreter.hpp>
 #include <variant>
+#include <optional>
 
 namespace Scheme {
 
 class Interpreter;
+class ImageWriter;
 
 struct TailCall {
   Obj proc;
@@ -17,15 +19,21 @@ struct TailCall {
   {}
 };
 
+// returned by a Recur to the Loop around it, whose variables it has
+// already rebound
+struct NextIteration {};
+
 using EvalResult = std::variant<
   Obj,
-  TailCall
+  TailCall,
+  NextIteration
 >;
 
 using ExprList = std::vector<Expression*>;
 
 inline bool is_obj(const EvalResult& res) {return std::holds_alternative<Obj>(res); }
 inline bool is_tailcall(const EvalResult& res) {return std::holds_alternative<TailCall>(res); }
+inline bool is_next_iteration(const EvalResult& res) {return std::holds_alternative<NextIteration>(res); }
 
 inline Obj& as_obj(EvalResult& res) { return std::get<Obj>(res); }
 inline const Obj& as_obj(const EvalResult& res) { return std::get<Obj>(res); }
@@ -39,6 +47,7 @@ public:
   virtual ~Expression() = default;
   virtual EvalResult eval(Environment*, Interpreter&) = 0;
   virtual void tco() {}
+  virtual void save(ImageWriter&) const = 0;
 };
 
 struct Literal : public Expression {
@@ -46,6 +55,7 @@ struct Literal : public Expression {
   explicit Literal(Obj o): obj(std::move(o)) {}
   EvalResult eval(Environment*, Interpreter&) override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 struct Variable : public Expression {
@@ -55,6 +65,17 @@ struct Variable : public Expression {
   explicit Variable(Symbol s, int d = 0, bool r = false): sym(s), depth(d), resolved(r) {}
   EvalResult eval(Environment*, Interpreter&) override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+// a reference from a top-level macro's expansion to a top-level variable
+// that a binding around the macro use shadows
+struct GlobalVariable : public Expression {
+  Symbol sym;
+  explicit GlobalVariable(Symbol s): sym {s} {}
+  EvalResult eval(Environment*, Interpreter&) override;
+  void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 struct Quoted : public Expression {
@@ -62,6 +83,7 @@ struct Quoted : public Expression {
   explicit Quoted(Obj text): text {text} {}
   EvalResult eval(Environment*, Interpreter&) override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 struct Quasiquoted : public Expression {
@@ -70,6 +92,7 @@ struct Quasiquoted : public Expression {
   explicit Quasiquoted(Obj obj): text {obj} {}
   EvalResult eval(Environment*, Interpreter&) override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 struct Set : public Expression {
@@ -78,6 +101,7 @@ struct Set : public Expression {
   Set(Symbol var, Expression *val): variable {std::move(var)}, value {val} {}
   EvalResult eval(Environment*, Interpreter&) override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 struct If : public Expression {
@@ -88,6 +112,7 @@ struct If : public Expression {
   EvalResult eval(Environment*, Interpreter&) override;
   void tco() override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 struct Begin : public Expression {
@@ -96,6 +121,7 @@ struct Begin : public Expression {
   EvalResult eval(Environment*, Interpreter&) override;
   void tco() override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 struct Lambda : public Expression {
@@ -111,6 +137,7 @@ struct Lambda : public Expression {
   }
   EvalResult eval(Environment*, Interpreter&) override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 struct Define : public Expression {
@@ -119,6 +146,7 @@ struct Define : public Expression {
   Define(Symbol var, Expression *val): variable {std::move(var)}, value {val} {}
   EvalResult eval(Environment*, Interpreter&) override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 using LetBindings = std::vector<std::pair<Symbol, Expression*>>;
@@ -128,7 +156,9 @@ struct Let : public Expression {
   Expression *body;
   Let(decltype(bindings) bn, Expression *bd): bindings {std::move(bn)}, body {bd} {}
   EvalResult eval(Environment*, Interpreter&) override;
+  void tco() override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 struct LetSeq : public Expression {
@@ -136,7 +166,30 @@ struct LetSeq : public Expression {
   Expression *body;
   LetSeq(decltype(bindings) bn, Expression *bd): bindings {std::move(bn)}, body {bd} {}
   EvalResult eval(Environment*, Interpreter&) override;
+  void tco() override;
+  void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+// formals as in lambda, bound to the values of expr
+struct ValuesBinding {
+  ParamList formals;
+  bool is_variadic;
+  Expression *expr;
+};
+
+// let-values, let*-values and receive. the values are bound straight from
+// the interpreter's values register, so nothing is consed unless the formals
+// have a rest variable.
+struct LetValues : public Expression {
+  std::vector<ValuesBinding> bindings;
+  bool sequential;
+  Expression *body;
+  LetValues(decltype(bindings) bn, bool s, Expression *bd): bindings {std::move(bn)}, sequential {s}, body {bd} {}
+  EvalResult eval(Environment*, Interpreter&) override;
+  void tco() override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 struct Clause {
@@ -151,30 +204,185 @@ struct Cond : public Expression {
   EvalResult eval(Environment*, Interpreter&) override;
   void tco() override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+// the body runs with a handler that unwinds back here; the condition is then
+// bound to variable for the clauses, and re-raised if none of them applies
+struct Guard : public Expression {
+  Symbol variable;
+  std::vector<Clause> clauses;
+  Expression *body;
+  Guard(Symbol v, decltype(clauses) c, Expression *b): variable {v}, clauses {std::move(c)}, body {b} {}
+  EvalResult eval(Environment*, Interpreter&) override;
+  void tco() override;
+  void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+// named let and do whose loop name is only called in tail position and
+// whose variables no closure captures. one frame is made on entry and every
+// iteration reuses it, so looping allocates nothing.
+struct Loop : public Expression {
+  Symbol name;
+  ParamList variables;
+  ExprList inits;
+  Expression *body;
+  Loop(Symbol n, ParamList v, ExprList i, Expression *b):
+    name {n},
+    variables {std::move(v)},
+    inits {std::move(i)},
+    body {b}
+  {}
+  EvalResult eval(Environment*, Interpreter&) override;
+  void tco() override;
+  void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+// a tail call of a Loop's name: computes the new values, stores them in the
+// loop's frame and goes round again
+struct Recur : public Expression {
+  ParamList variables;
+  ExprList args;
+  int depth = 0;
+  bool resolved = false;
+  Recur(ParamList v, ExprList a): variables {std::move(v)}, args {std::move(a)} {}
+  Recur(ParamList v, ExprList a, int d): variables {std::move(v)}, args {std::move(a)}, depth {d}, resolved {true} {}
+  EvalResult eval(Environment*, Interpreter&) override;
+  void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+// the body is not in tail position: the old values are put back after it
+struct Parameterize : public Expression {
+  std::vector<std::pair<Expression*, Expression*>> bindings;
+  Expression *body;
+  Parameterize(decltype(bindings) bn, Expression *bd): bindings {std::move(bn)}, body {bd} {}
+  EvalResult eval(Environment*, Interpreter&) override;
+  void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+// delay, delay-force and stream-lambda bodies: a promise over expr in the
+// current environment
+struct Delay : public Expression {
+  Expression *expr;
+  bool lazy;
+  bool stream;
+  Delay(Expression *e, bool l, bool s = false): expr {e}, lazy {l}, stream {s} {}
+  EvalResult eval(Environment*, Interpreter&) override;
+  void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+struct StreamCons : public Expression {
+  Expression *head;
+  Expression *tail;
+  StreamCons(Expression *h, Expression *t): head {h}, tail {t} {}
+  EvalResult eval(Environment*, Interpreter&) override;
+  void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+struct RecordField {
+  size_t slot;
+  Symbol accessor;
+  std::optional<Symbol> modifier;
+};
+
+// evaluating define-record-type makes a fresh record type and binds it along
+// with its constructor, predicate, accessors and modifiers
+struct DefineRecord : public Expression {
+  Symbol type_name;
+  std::vector<Symbol> fields;
+  std::optional<Symbol> constructor;
+  std::vector<size_t> constructor_slots;
+  Symbol predicate;
+  std::vector<RecordField> procedures;
+  DefineRecord(Symbol t, std::vector<Symbol> f, std::optional<Symbol> c, std::vector<size_t> cs, Symbol p, std::vector<RecordField> ps):
+    type_name {t},
+    fields {std::move(f)},
+    constructor {c},
+    constructor_slots {std::move(cs)},
+    predicate {p},
+    procedures {std::move(ps)}
+  {}
+  EvalResult eval(Environment*, Interpreter&) override;
+  void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+// call sites start out UNSEEN, record the builtin and operand types of their
+// first call, and from then on run that builtin inline behind a guard. a failed
+// guard deoptimizes the site to GENERIC for good.
+enum class CallShape {
+  UNSEEN,
+  BINARY_NUMERIC,
+  UNARY_PAIR,
+  UNARY_RECORD,
+  GENERIC
 };
 
 struct Application : public Expression {
   Expression *op;
   ExprList params;
   bool at_tail = false;
+  CallShape shape = CallShape::UNSEEN;
+  Builtin *feedback_target = nullptr;
   Application(Expression *o, ExprList p): op {o}, params {std::move(p)} {}
   EvalResult eval(Environment*, Interpreter&) override;
   void tco() override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+
+private:
+  void record_feedback(const Obj&, const ArgList&);
+  void deoptimize();
 };
 
+// and and or give the value of the expression that decided them, and their
+// last expression is in tail position
 struct And : public Expression {
   ExprList exprs;
   And(ExprList e): exprs {std::move(e)} {}
   EvalResult eval(Environment*, Interpreter&) override;
+  void tco() override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 struct Or : public Expression {
   ExprList exprs;
   Or(ExprList e): exprs {std::move(e)} {}
   EvalResult eval(Environment*, Interpreter&) override;
+  void tco() override;
+  void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+// the body of a procedure with SelfCalls in it: evaluated again, in the same
+// frame, each time one of them goes round
+struct Repeat : public Expression {
+  Expression *body;
+  Repeat(Expression *b): body {b} {}
+  EvalResult eval(Environment*, Interpreter&) override;
+  void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
+};
+
+// a procedure's tail call of its own name. while the name still holds a
+// procedure with this body over the same environment, the call is a Recur
+// into the procedure's frame; otherwise it is the ordinary call. body is the
+// procedure's Repeat, only compared against, so it is not a child.
+struct SelfCall : public Expression {
+  Recur *recur;
+  Application *call;
+  Repeat *body;
+  SelfCall(Recur *r, Application *c, Repeat *b): recur {r}, call {c}, body {b} {}
+  EvalResult eval(Environment*, Interpreter&) override;
   void push_children(MarkStack&) override;
+  void save(ImageWriter&) const override;
 };
 
 Expression *combine_expr(const Obj&, Interpreter&);
@@ -0,0 +1,53 @@
+#pragma once
+#include <interpreter/types.hpp>
+#include <vector>
+
+namespace Scheme {
+
+// open-addressing table with linear probing. every slot caches the hash of
+// its key, so probes compare hashes before keys and growth never rehashes.
+// deletion shifts the following run back instead of leaving tombstones.
+class HashTable : public HeapEntity {
+public:
+  enum class Kind {
+    EQ,
+    EQV,
+    EQUAL,
+    STRING
+  };
+
+private:
+  struct Slot {
+    Obj key;
+    Obj value;
+    size_t hash;
+    bool full;
+  };
+
+  std::vector<Slot> slots;
+  size_t count;
+
+  size_t hash_key(const Obj&) const;
+  bool same_key(const Obj&, const Obj&) const;
+  size_t find_slot(const Obj&, const size_t) const;
+  void grow();
+
+public:
+  const Kind kind;
+
+  HashTable(Kind);
+  HashTable(const HashTable&) = default;
+
+  size_t size() const {return count;}
+  Obj *find(const Obj&);
+  void set(const Obj&, Obj);
+  bool erase(const Obj&);
+  void clear();
+  // a snapshot, in a buffer the collector can find, so walking it may call
+  // Scheme code that changes the table
+  std::vector<std::pair<Obj, Obj>, ScannedAllocator<std::pair<Obj, Obj>>> entries() const;
+
+  void push_children(MarkStack&) override;
+};
+
+}
@@ -0,0 +1,118 @@
+#pragma once
+#include <interpreter/types.hpp>
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <variant>
+#include <vector>
+
+namespace Scheme {
+
+class Macro;
+class PromiseState;
+
+// what a record in an image holds. the order is part of the format.
+enum class ImageKind : uint8_t {
+  STRING,
+  STRING_PORT,
+  CONS,
+  VECTOR,
+  BYTEVECTOR,
+  HASH_TABLE,
+  PMAP,
+  RECORD_TYPE,
+  RECORD,
+  PROMISE,
+  PROMISE_STATE,
+  RECORD_PROCEDURE,
+  PROCEDURE,
+  PARAMETER,
+  ENVIRONMENT,
+  MACRO,
+  LITERAL,
+  VARIABLE,
+  GLOBAL_VARIABLE,
+  QUOTED,
+  QUASIQUOTED,
+  SET,
+  IF,
+  BEGIN,
+  LAMBDA,
+  DEFINE,
+  LET,
+  LET_SEQ,
+  LET_VALUES,
+  COND,
+  GUARD,
+  LOOP,
+  RECUR,
+  PARAMETERIZE,
+  DELAY,
+  STREAM_CONS,
+  DEFINE_RECORD,
+  APPLICATION,
+  AND,
+  OR,
+  REPEAT,
+  SELF_CALL
+};
+
+// writes the interpreter's global state as an image: the global environment
+// and top-level macros, and everything reachable from them. objects are
+// numbered rather than addressed, so an image loads anywhere. an object that
+// another one needs to be made is written before it; every other reference
+// may point forward.
+class ImageWriter {
+private:
+  using Entity = std::variant<Obj, Environment*, Expression*, PromiseState*, Macro*>;
+  struct Storage {
+    uint32_t id;
+    size_t start;
+    size_t end;
+  };
+
+  Interpreter& interp;
+  std::unordered_map<const HeapEntity*, uint32_t> ids;
+  std::unordered_set<const HeapEntity*> written;
+  std::vector<Entity> pending;
+  std::unordered_map<Symbol, uint32_t> symbol_ids;
+  std::string symbols;
+  uint32_t symbol_count;
+  std::unordered_map<const uint8_t*, Storage> storages;
+  std::string objects;
+  uint32_t object_count;
+  // the record being written
+  std::string out;
+
+  uint32_t id_of(const HeapEntity*, const Entity&);
+  uint32_t dep(const HeapEntity*, const Entity&);
+  void write_record(const Entity&);
+  void write_entity(const Entity&);
+  void write_heap_obj(const Obj&);
+
+public:
+  explicit ImageWriter(Interpreter&);
+
+  void put_kind(ImageKind);
+  void put_u8(uint8_t);
+  void put_u32(uint32_t);
+  void put_u64(uint64_t);
+  void put_string(const std::string&);
+  void put_symbol(const Symbol&);
+  void put_symbols(const std::vector<Symbol>&);
+  void put_obj(const Obj&);
+  // expressions, which are made before the ones that contain them. null is
+  // written as no object.
+  void put_expr(Expression*);
+  void put_exprs(const std::vector<Expression*>&);
+  // an expression that may be made after the one referring to it
+  void put_expr_ref(Expression*);
+
+  void save(const std::string& path);
+};
+
+void save_image(const std::string& path, Interpreter&);
+void load_image(const std::string& path, Interpreter&);
+
+}
@@ -2,17 +2,34 @@
 #include <interpreter/types.hpp>
 #include <interpreter/environment.hpp>
 #include <interpreter/memory.hpp>
+#include <interpreter/macros.hpp>
 #include <unordered_map>
+#include <unordered_set>
 #include <string>
 #include <string_view>
 #include <chrono>
+#include <initializer_list>
+#include <optional>
+#include <cstdint>
+#include <algorithm>
 
 namespace Scheme {
 
+struct HandlerFrame;
+class ParameterSwap;
+class Coroutine;
+struct Segment;
+class Winder;
+class ContinuationFrame;
+struct Prompt;
+
 class Interpreter {
 private:
   std::unordered_map<std::string_view, std::string*> intern_table;
   Environment *global_env; 
+  RecordType *error_type;
+  Record *eof_object;
+  Record *values_marker;
   bool profiling;
 
   std::chrono::microseconds lexing_time {0};
@@ -22,17 +39,86 @@ private:
   std::chrono::microseconds garbage_collecting_time {0};
 
   void install_global_environment();
-  void load_preamble();
+  void load_preamble(bool from_image);
+  void collect_garbage(Obj&);
+  void collect_during_evaluation();
+  Expression* build(const std::string&);
 
 public:
   Allocator alloc;
+  // innermost exception handler in effect, null at the top level
+  HandlerFrame *handlers;
+  // innermost parameterize in effect, null at the top level
+  ParameterSwap *parameterizations;
+  // innermost dynamic-wind in effect and innermost call/cc that has not
+  // returned, null at the top level
+  Winder *winders;
+  ContinuationFrame *continuation_frames;
+  // the top-level form being evaluated, which continuations are captured up
+  // to, and the frames on the stack that cannot be copied
+  Prompt *prompt;
+  size_t uncopyable_frames;
+  // the coroutine running now, null on the main stack
+  Coroutine *current_coroutine;
+  // coroutines started and not yet finished
+  std::unordered_set<Coroutine*> live_coroutines;
+  // the values of a call that returns other than one value. they wait here,
+  // and the call returns the values marker in their place, so passing them
+  // to call-with-values or let-values conses nothing.
+  ArgList values;
+  // how far down the current stack may grow before calls move to a new
+  // segment
+  char *stack_limit;
+  // how many calls deep the running code is, and how deep it may go once it
+  // has moved to segments. counting calls rather than bytes keeps the limit
+  // the same however much native stack a call takes in a given build.
+  size_t call_depth;
+  size_t call_budget;
+  // the innermost segment the running code is on, null on its own stack
+  Segment *segments;
+  // top-level forms and eval'd expressions being evaluated, kept through
+  // collections during evaluation
+  std::vector<Expression*> evaluating;
+  // macros and the identifiers their expansions introduced
+  SyntaxTable syntax;
+  // the builtins installed at startup, in order. images refer to them by
+  // their place here, so an image only loads into the build that saved it.
+  std::vector<Builtin*> builtins;
 
-  Interpreter(bool);
+  // starts from the image at the given path instead of the preamble. the
+  // preamble comes from the image the build saved of it, unless that is
+  // not wanted or cannot be loaded.
+  Interpreter(bool, const std::optional<std::string>& = std::nullopt, bool preamble_image = true);
   ~Interpreter();
 
   bool is_profiled() {return profiling;}
+  // called where evaluation may collect: at applications of procedures, at
+  // loop iterations and in forcing. collects once enough has been allocated.
+  void safe_point() {
+    if (alloc.wants_collection()) {
+      collect_during_evaluation();
+    }
+  }
+  bool stack_exhausted() const {
+    char probe;
+    return reinterpret_cast<uintptr_t>(&probe) < reinterpret_cast<uintptr_t>(stack_limit);
+  }
+  bool calls_exhausted() const {
+    return segments && call_depth > call_budget;
+  }
   Environment *get_global_env() {return global_env;}
+  RecordType *get_error_type() const {return error_type;}
+  Record *get_eof_object() const {return eof_object;}
+  Record *get_values_marker() const {return values_marker;}
+  bool is_values(const Obj& obj) const {return is_record(obj) && as_record(obj) == values_marker;}
+  Obj return_values(const ArgList&);
+  // the value of an expression where only one is taken: the first of
+  // several, and an error where there are none
+  Obj one_value(const Obj& obj) const {return is_values(obj) ? first_value() : obj;}
+  Obj first_value() const;
+  Obj return_values(std::initializer_list<Obj>);
   Symbol intern_symbol(const std::string_view);
+  bool is_interned(const Symbol&) const;
   Obj interpret(const std::string&);
   void print_timings() const;
 
@@ -42,4 +128,32 @@ public:
   }
 };
 
+// a call being applied, counted while it runs
+class CallDepth {
+private:
+  Interpreter& interp;
+public:
+  explicit CallDepth(Interpreter& interp): interp {interp} {
+    interp.call_depth++;
+  }
+  ~CallDepth() {
+    interp.call_depth--;
+  }
+};
+
+// keeps an expression through collections while it is evaluated
+class EvaluationScope {
+private:
+  Interpreter& interp;
+  Expression *const expr;
+public:
+  EvaluationScope(Interpreter& interp, Expression *expr): interp {interp}, expr {expr} {
+    interp.evaluating.push_back(expr);
+  }
+  ~EvaluationScope() {
+    const auto itr = std::find(interp.evaluating.rbegin(), interp.evaluating.rend(), expr);
+    interp.evaluating.erase(std::next(itr).base());
+  }
+};
+
 }
@@ -1,4 +1,5 @@
 #pragma once
+#include <optional>
 #include <stdexcept>
 #include <string>
 #include <string_view>
@@ -14,13 +15,10 @@ struct Token {
     SYMBOL,
     STRING,
     VEC_BEGIN,
+    BYTEVEC_BEGIN,
     TRUE,
     FALSE,
     CHAR,
-    PLUS_INF,
-    PLUS_NAN,
-    MINUS_INF,
-    MINUS_NAN,
     DOT, 
     QUOTE,
     BACKTICK,
@@ -31,8 +29,11 @@ struct Token {
   } type;
 
   std::string_view lexeme;
+  double number = 0;
 };
 
+std::optional<double> read_number(std::string_view, int radix = 10);
+
 class Lexer {
 private:
   const std::string_view input;
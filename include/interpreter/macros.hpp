@@ -0,0 +1,117 @@
+#pragma once
+#include <interpreter/types.hpp>
+#include <chrono>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace Scheme {
+
+// a syntax-rules transformer. patterns and templates are kept as the data
+// they were read as. top_level is set for one defined outside any binding
+// form, whose free identifiers then always mean the top-level bindings.
+// depth is the number of syntax scopes it was defined in, those its
+// literals are looked up in.
+class Macro : public HeapEntity {
+public:
+  Symbol ellipsis;
+  bool has_ellipsis;
+  std::vector<Symbol> literals;
+  std::vector<std::pair<Obj, Obj>> rules;
+  bool top_level;
+  size_t depth;
+
+  Macro(Symbol e, bool he, std::vector<Symbol> l, decltype(rules) r, bool t, size_t d):
+    ellipsis {e},
+    has_ellipsis {he},
+    literals {std::move(l)},
+    rules {std::move(r)},
+    top_level {t},
+    depth {d}
+  {}
+  void push_children(MarkStack&) override;
+};
+
+// an identifier a template introduced, renamed apart from everything else
+// by its expansion: an uninterned symbol with the same name
+struct Alias {
+  Symbol original;
+  bool top_level;
+};
+
+// what build_ast knows of identifiers while it builds. each scope maps a
+// symbol to the macro it names there, or to null where a binding form makes
+// it a variable; the first scope holds the top-level macros. scopes for
+// let-syntax and friends make no frame at run time; the rest do.
+class SyntaxTable {
+private:
+  struct Scope {
+    std::unordered_map<Symbol, Macro*> names;
+    bool is_frame;
+  };
+  struct UseSite {
+    Macro *macro;
+    Obj form;
+  };
+  struct UseSiteHash {
+    size_t operator()(const UseSite&) const;
+  };
+  struct UseSiteEqual {
+    bool operator()(const UseSite&, const UseSite&) const;
+  };
+
+  std::vector<Scope> scopes;
+  size_t frames;
+  std::unordered_map<Symbol, Alias> aliases;
+  std::vector<std::unique_ptr<std::string>> alias_names;
+  // expansions by the macro and the form they expanded, so that a form
+  // built again, by eval or by loading the same code, is not re-expanded
+  std::unordered_map<UseSite, Obj, UseSiteHash, UseSiteEqual> expansions;
+
+  const std::pair<const Symbol, Macro*> *find(const Symbol&) const;
+  std::pair<size_t, Symbol> binding(const Symbol&, size_t visible) const;
+  Scope& innermost_frame();
+
+  friend class SyntaxScope;
+
+public:
+  std::chrono::microseconds expanding_time {0};
+
+  SyntaxTable();
+
+  Symbol make_alias(const Symbol&, bool top_level);
+  const Alias *get_alias(const Symbol&) const;
+  Symbol strip(Symbol) const;
+  Obj strip(const Obj&, Interpreter&) const;
+
+  Macro *get_macro(const Symbol&) const;
+  std::optional<Symbol> get_keyword(const Symbol&) const;
+  Symbol resolve(const Symbol&) const;
+  bool same_binding(const Symbol& form, const Symbol& literal, const Macro&) const;
+  Expression *make_reference(const Symbol&, Interpreter&) const;
+  Symbol bind(const Symbol&);
+  void define_macro(const Symbol&, Macro*);
+  bool at_top_level() const;
+  size_t depth() const;
+  const std::unordered_map<Symbol, Macro*>& top_level_macros() const;
+
+  Obj expand(Macro*, const Obj&, Interpreter&);
+  void push_roots(std::vector<HeapEntity*>&);
+};
+
+// a scope of build_ast, for as long as the form that opens it is built
+class SyntaxScope {
+private:
+  SyntaxTable& table;
+public:
+  SyntaxScope(Interpreter&, const ParamList& = {}, bool is_frame = true);
+  ~SyntaxScope();
+  void add(const ParamList&);
+  void add_macro(const Symbol&, Macro*);
+};
+
+Macro *make_macro(const Obj& spec, bool top_level, Interpreter&);
+
+}
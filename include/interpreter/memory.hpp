@@ -1,6 +1,11 @@
 #pragma once
 #include <interpreter/types.hpp>
+#include <interpreter/hash_table.hpp>
+#include <interpreter/persistent_map.hpp>
+#include <interpreter/promise.hpp>
+#include <interpreter/coroutine.hpp>
 #include <vector>
+#include <cstdint>
 
 namespace Scheme {
 
@@ -34,32 +39,127 @@ try_get_heap_entity(Obj& obj) {
     [](Vector* v) -> HeapEntity* {
       return v;
     },
+    [](HashTable* h) -> HeapEntity* {
+      return h;
+    },
+    [](Bytevector* b) -> HeapEntity* {
+      return b;
+    },
+    [](StringPort* p) -> HeapEntity* {
+      return p;
+    },
+    [](PersistentMap* m) -> HeapEntity* {
+      return m;
+    },
+    [](RecordType* t) -> HeapEntity* {
+      return t;
+    },
+    [](Record* r) -> HeapEntity* {
+      return r;
+    },
+    [](Promise* p) -> HeapEntity* {
+      return p;
+    },
     [](Procedure* p) -> HeapEntity* {
       return p;
     },
     [](Builtin* p) -> HeapEntity* {
       return p;
     },
+    [](Parameter* p) -> HeapEntity* {
+      return p;
+    },
+    [](Coroutine* c) -> HeapEntity* {
+      return c;
+    },
   }, obj);
 }
 
+// an Obj held where neither the heap nor a scan of the stacks reaches it, as
+// in an exception in flight. while the pin exists the Obj is a root of every
+// collection.
+class PinnedObj {
+private:
+  inline static PinnedObj *pins = nullptr;
+  PinnedObj *prev;
+  PinnedObj *next;
+  const Obj& obj;
+
+public:
+  explicit PinnedObj(const Obj& obj): prev {nullptr}, next {pins}, obj {obj} {
+    if (pins) {
+      pins->prev = this;
+    }
+    pins = this;
+  }
+  PinnedObj(const PinnedObj&) = delete;
+  PinnedObj& operator=(const PinnedObj&) = delete;
+  ~PinnedObj() {
+    (prev ? prev->next : pins) = next;
+    if (next) {
+      next->prev = prev;
+    }
+  }
+
+  static void push_roots(std::vector<HeapEntity*>&);
+};
+
 class Allocator {
 private:
   std::vector<HeapEntity*> live_memory;
-  void mark(const std::vector<HeapEntity*>&);
+  // collections during evaluation wait until this many objects are live.
+  // memory the objects hold besides, like the copies of the stack kept by
+  // continuations, counts as well, in objects' worth.
+  size_t threshold;
+  size_t held;
+  // the live objects and scanned buffers in address order, built for the
+  // stack scans of one collection
+  bool indexed;
+  std::vector<HeapEntity*> by_address;
+  std::vector<ScannedBlock*> blocks;
+  // every continuation and coroutine, as a marked one has its copy of the
+  // stack, or its own stacks, scanned
+  std::vector<Continuation*> continuations;
+  std::vector<Coroutine*> coroutines;
+  void index();
+  void drop_index();
+  HeapEntity *find_entity(uintptr_t) const;
+  ScannedBlock *find_block(uintptr_t) const;
   void sweep(); 
 
 public:
-  Allocator(): live_memory {} {};
+  Allocator(): live_memory {}, threshold {0}, held {0}, indexed {false}, by_address {}, blocks {}, continuations {}, coroutines {} {
+    defer_collection();
+  };
 
   template<typename T, typename... Args>
   T* spawn(Args&&... args) {
     static_assert(std::is_base_of_v<HeapEntity, T>, "attempt to allocate an object not derived from HeapEntity");
-    T* obj = new T(std::forward<Args>(args)...);
+    T* obj;
+    if constexpr (std::is_same_v<T, Record>) {
+      obj = new (args...) T(std::forward<Args>(args)...);
+      obj->extent = sizeof(T) + obj->type->fields.size() * sizeof(Obj);
+    }
+    else {
+      obj = new T(std::forward<Args>(args)...);
+      obj->extent = sizeof(T);
+    }
+    if constexpr (std::is_same_v<T, Continuation>) {
+      continuations.push_back(obj);
+    }
+    if constexpr (std::is_same_v<T, Coroutine>) {
+      coroutines.push_back(obj);
+    }
     live_memory.push_back(obj);
     return obj;
   }
 
+  bool wants_collection() const {return live_memory.size() + held >= threshold;}
+  void defer_collection();
+  void hold(size_t bytes);
+  void scan(const void*, const void*, std::vector<HeapEntity*>&);
+  void mark(const std::vector<HeapEntity*>&);
+  void unmark();
   void recycle();
   void recycle(const std::vector<HeapEntity*>&);
 };
@@ -0,0 +1,58 @@
+#pragma once
+#include <interpreter/types.hpp>
+#include <interpreter/interpreter.hpp>
+#include <vector>
+
+namespace Scheme {
+
+// the values a parameterize binds. while it is in effect the values it
+// replaced wait here, in a buffer the collector can find.
+using ParameterBindings = std::vector<std::pair<Parameter*, Obj>, ScannedAllocator<std::pair<Parameter*, Obj>>>;
+
+// a parameterize in effect. swaps each value with its parameter's current
+// one on entry and, in reverse order so a parameter bound twice comes out
+// right, again on exit. the ones in effect are linked through the
+// interpreter, so a coroutine can swap its own out when it is switched out
+// and back in when it resumes.
+class ParameterSwap {
+private:
+  Interpreter& interp;
+  ParameterBindings& bindings;
+public:
+  ParameterSwap *const outer;
+
+  ParameterSwap(Interpreter& interp, decltype(bindings) b):
+    interp {interp},
+    bindings {b},
+    outer {interp.parameterizations}
+  {
+    swap_in();
+    interp.parameterizations = this;
+  }
+
+  ~ParameterSwap() {
+    swap_out();
+    interp.parameterizations = outer;
+  }
+
+  void swap_in() {
+    for (auto& [param, value] : bindings) {
+      std::swap(param->value, value);
+    }
+  }
+
+  // each parameter bound here, with the value it has now
+  void save(std::vector<std::pair<Parameter*, Obj>>& out) const {
+    for (const auto& binding : bindings) {
+      out.emplace_back(binding.first, binding.first->value);
+    }
+  }
+
+  void swap_out() {
+    for (auto itr = bindings.rbegin(); itr != bindings.rend(); ++itr) {
+      std::swap(itr->first->value, itr->second);
+    }
+  }
+};
+
+}
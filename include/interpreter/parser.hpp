@@ -23,6 +23,7 @@ private:
   Obj parse_atom();
   Obj parse_list();
   Obj parse_vec();
+  Obj parse_bytevec();
   Obj parse_dotted_tail();
   Obj parse_quoted(const std::string&);
 
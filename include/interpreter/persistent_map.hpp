@@ -0,0 +1,72 @@
+#pragma once
+#include <interpreter/types.hpp>
+#include <cstdint>
+#include <vector>
+
+namespace Scheme {
+
+// hash array mapped trie node. each level consumes 5 bits of the key's hash;
+// bitmap marks which of the 32 branches are present and entries holds only
+// those, in branch order. an entry is either a key/value leaf or a child
+// node. once the hash bits run out, or two keys share their whole hash, the
+// colliding leaves are kept in a flat collision node.
+//
+// nodes are shared between every map version that reaches them. a node is
+// only mutated in place by the transient whose edit token it carries.
+class HamtNode : public HeapEntity {
+public:
+  struct Entry {
+    Obj key;
+    Obj value;
+    size_t hash;
+    HamtNode *child;
+  };
+
+  uint32_t bitmap;
+  bool collision;
+  uint64_t edit;
+  std::vector<Entry> entries;
+
+  HamtNode(uint32_t bitmap, bool collision, uint64_t edit, std::vector<Entry> entries):
+    bitmap {bitmap},
+    collision {collision},
+    edit {edit},
+    entries {std::move(entries)}
+  {}
+
+  void push_children(MarkStack&) override;
+};
+
+// persistent map, or persistent set when is_set (values are then unused).
+// a transient map edits nodes it created in place until it is made
+// persistent again, which makes bulk loading cheap.
+class PersistentMap : public HeapEntity {
+public:
+  HamtNode *root;
+  size_t count;
+  const bool is_set;
+  uint64_t edit;
+  bool transient;
+
+  PersistentMap(HamtNode *root, size_t count, bool is_set):
+    root {root},
+    count {count},
+    is_set {is_set},
+    edit {0},
+    transient {false}
+  {}
+
+  const Obj *find(const Obj&) const;
+  PersistentMap *assoc(const Obj&, const Obj&, Interpreter&) const;
+  PersistentMap *dissoc(const Obj&, Interpreter&) const;
+  void assoc_in_place(const Obj&, const Obj&, Interpreter&);
+  void dissoc_in_place(const Obj&, Interpreter&);
+  PersistentMap *make_transient(Interpreter&) const;
+  PersistentMap *make_persistent(Interpreter&);
+  std::vector<const HamtNode::Entry*> leaves() const;
+  bool equals(const PersistentMap&) const;
+
+  void push_children(MarkStack&) override;
+};
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <interpreter/types.hpp>
+
+namespace Scheme {
+
+using PromiseStep = Obj (*)(const ArgList&, Interpreter&);
+
+// what a promise will produce. the pending computation is either an
+// expression to evaluate in env (delay and friends) or a native step applied
+// to args (the stream library). a lazy computation yields another promise,
+// to be forced in turn, as with delay-force.
+//
+// forcing a delay-force chain moves each inner promise's state into the
+// outer one and points the inner promise at it, so a chain of any length
+// is forced in constant space
+class PromiseState : public HeapEntity {
+public:
+  bool done;
+  bool lazy;
+  Obj value;
+  Expression *expr;
+  Environment *env;
+  PromiseStep step;
+  ArgList args;
+
+  explicit PromiseState(Obj value):
+    done {true},
+    lazy {false},
+    value {std::move(value)},
+    expr {nullptr},
+    env {nullptr},
+    step {nullptr},
+    args {}
+  {}
+
+  PromiseState(Expression *expr, Environment *env, bool lazy):
+    done {false},
+    lazy {lazy},
+    value {Void {}},
+    expr {expr},
+    env {env},
+    step {nullptr},
+    args {}
+  {}
+
+  PromiseState(PromiseStep step, ArgList args, bool lazy):
+    done {false},
+    lazy {lazy},
+    value {Void {}},
+    expr {nullptr},
+    env {nullptr},
+    step {step},
+    args {std::move(args)}
+  {
+    disown_scanned(this->args);
+  }
+
+  void resolve(Obj);
+  void adopt(const PromiseState&);
+  void push_children(MarkStack&) override;
+};
+
+// a stream is a promise flagged as one. forced, it gives () for the empty
+// stream or a pair of a promise for the first element and the rest stream.
+class Promise : public HeapEntity {
+public:
+  PromiseState *state;
+  const bool stream;
+  Promise(PromiseState *state, bool stream = false): state {state}, stream {stream} {}
+  void push_children(MarkStack&) override;
+};
+
+Obj force(const Obj&, Interpreter&);
+
+}
@@ -5,6 +5,9 @@
 #include <variant>
 #include <stack>
 #include <functional>
+#include <memory>
+#include <cstdint>
+#include <interpreter/buffers.hpp>
 
 namespace Scheme { 
 
@@ -12,8 +15,17 @@ class Symbol;
 class String;
 class Cons;
 class Vector;
+class HashTable;
+class Bytevector;
+class StringPort;
+class PersistentMap;
+class RecordType;
+class Record;
+class Promise;
 class Builtin;
 class Procedure;
+class Parameter;
+class Coroutine;
 class Null {};
 class Void {};
 
@@ -29,14 +41,25 @@ using Obj = std::variant<
   String*,
   Cons*,
   Vector*,
+  HashTable*,
+  Bytevector*,
+  StringPort*,
+  PersistentMap*,
+  RecordType*,
+  Record*,
+  Promise*,
   Builtin*,
   Procedure*,
+  Parameter*,
+  Coroutine*,
   Null,
   Void
 >;
 
 using ParamList = std::vector<Symbol>;
-using ArgList = std::vector<Obj>;
+// argument lists, and any other vector of Objs, in buffers a collection
+// during evaluation can find from the stack
+using ArgList = std::vector<Obj, ScannedAllocator<Obj>>;
 
 class HeapEntity;
 using MarkStack = std::stack<HeapEntity*>;
@@ -44,7 +67,9 @@ using MarkStack = std::stack<HeapEntity*>;
 class HeapEntity {
 public:
   bool marked;
-  HeapEntity(): marked {false} {}
+  // bytes from the object's address that belong to it, set by the allocator
+  uint32_t extent;
+  HeapEntity(): marked {false}, extent {0} {}
   virtual void push_children(MarkStack&) {};
   virtual ~HeapEntity() = default;
 };
@@ -70,6 +95,15 @@ public:
   void push_children(MarkStack&) override;
 };
 
+// output string port, also used as a string builder. appends grow the
+// buffer geometrically, so building a string piece by piece is linear.
+class StringPort : public HeapEntity {
+public:
+  std::string buffer;
+  StringPort(): buffer {} {}
+  void push_children(MarkStack&) override;
+};
+
 class Cons : public HeapEntity {
 public:
   Obj car;
@@ -84,17 +118,133 @@ public:
 
 class Vector : public HeapEntity {
 public:
-  std::vector<Obj> data;
-  Vector(std::vector<Obj> data): data {std::move(data)} {}
+  ArgList data;
+  Vector(ArgList data): data {std::move(data)} {
+    disown_scanned(this->data);
+  }
+  void push_children(MarkStack&) override;
+};
+
+// bytes live in storage shared between a bytevector and the slices taken of
+// it, so slicing never copies. the buffer holds no objects for the collector.
+class Bytevector : public HeapEntity {
+private:
+  std::shared_ptr<uint8_t[]> storage;
+  size_t offset;
+  size_t length;
+public:
+  Bytevector(size_t n, uint8_t fill = 0):
+    storage {std::make_shared<uint8_t[]>(n, fill)},
+    offset {0},
+    length {n}
+  {}
+  Bytevector(const Bytevector& parent, size_t start, size_t end):
+    storage {parent.storage},
+    offset {parent.offset + start},
+    length {end - start}
+  {}
+  uint8_t *data() {return storage.get() + offset;}
+  // the start of the storage, the same for a bytevector and its slices
+  const uint8_t *storage_start() const {return storage.get();}
+  const uint8_t *data() const {return storage.get() + offset;}
+  size_t size() const {return length;}
+  void push_children(MarkStack&) override;
+};
+
+// type descriptor made by define-record-type. every evaluation of the form
+// makes a new, distinct type.
+class RecordType : public HeapEntity {
+public:
+  const Symbol name;
+  const std::vector<Symbol> fields;
+  // the slots the constructor fills, in the order of its arguments
+  std::vector<size_t> constructor_slots;
+  RecordType(Symbol name, std::vector<Symbol> fields, std::vector<size_t> constructor_slots = {}):
+    name {name},
+    fields {std::move(fields)},
+    constructor_slots {std::move(constructor_slots)}
+  {}
+  void push_children(MarkStack&) override;
+};
+
+// record instance: its descriptor and one slot per field. the slots follow
+// the record in the same allocation, at the size the descriptor fixes, so a
+// record is made with new (type) Record(type).
+class Record final : public HeapEntity {
+public:
+  RecordType *const type;
+  Record(RecordType *type):
+    type {type}
+  {
+    std::uninitialized_value_construct_n(slots(), type->fields.size());
+  }
+  Obj *slots() {return reinterpret_cast<Obj*>(this + 1);}
+  const Obj *slots() const {return reinterpret_cast<const Obj*>(this + 1);}
   void push_children(MarkStack&) override;
+
+  static void *operator new(size_t size, RecordType *type) {
+    return ::operator new(size + type->fields.size() * sizeof(Obj));
+  }
+  static void operator delete(void *ptr) {::operator delete(ptr);}
+  static void operator delete(void *ptr, RecordType*) {::operator delete(ptr);}
 };
 
+// slots are never destroyed, as the record's type may be swept first
+static_assert(std::is_trivially_destructible_v<Obj>);
+static_assert(alignof(Record) >= alignof(Obj));
+
+// tags builtins whose call sites may be specialized on observed operand types
+enum class Primitive {
+  NONE,
+  ADD,
+  SUB,
+  MUL,
+  DIV,
+  NUM_EQ,
+  LT,
+  GT,
+  LE,
+  GE,
+  CAR,
+  CDR,
+  EQ,
+  EQV,
+  EQUAL,
+  STRING_EQ,
+  STRING_LT,
+  RECORD_REF
+};
+
+// what a procedure made by define-record-type does, so that it can be made
+// again from its record type and slot
+enum class RecordRole {
+  NONE,
+  CONSTRUCTOR,
+  PREDICATE,
+  ACCESSOR,
+  MODIFIER
+};
+
+// the argument list a builtin is called with is its own to use up: the
+// stream consumers take the stream out of it, so the cells they have walked
+// past can be collected while they run
 class Builtin : public HeapEntity {
 private:
-  std::function<Obj(const ArgList&, Interpreter&)> func;
+  std::function<Obj(ArgList&, Interpreter&)> func;
 public:
-  Builtin(decltype(func) f): func {f} {};
-  Obj operator()(const ArgList& args, Interpreter& interp) const {
+  const Primitive prim;
+  // for record procedures, the record type they accept and the slot they use
+  RecordType *const record_type;
+  const size_t slot;
+  const RecordRole role;
+  Builtin(decltype(func) f, Primitive p = Primitive::NONE, RecordType *t = nullptr, size_t s = 0, RecordRole r = RecordRole::NONE):
+    func {f},
+    prim {p},
+    record_type {t},
+    slot {s},
+    role {r}
+  {};
+  Obj operator()(ArgList& args, Interpreter& interp) const {
     return func(args, interp);
   }
   void push_children(MarkStack&) override;
@@ -115,6 +265,18 @@ public:
   void push_children(MarkStack&) override;
 };
 
+// parameter object. the current value lives in the object itself and
+// parameterize swaps values in and out around its body (shallow binding), so
+// reading a parameter is one load however deeply parameterizations nest.
+class Parameter : public HeapEntity {
+public:
+  Obj value;
+  // applied to values given by parameterize; #f for none
+  Obj converter;
+  Parameter(Obj v, Obj c): value {std::move(v)}, converter {std::move(c)} {}
+  void push_children(MarkStack&) override;
+};
+
 template<class... Ts> 
 struct Overloaded : Ts... { 
   using Ts::operator()...; 
@@ -127,9 +289,18 @@ inline bool is_symbol(const Obj& obj){return std::holds_alternative<Symbol>(obj)
 inline bool is_string(const Obj& obj) {return std::holds_alternative<String*>(obj);}
 inline bool is_pair(const Obj& obj) {return std::holds_alternative<Cons*>(obj);}
 inline bool is_vector(const Obj& obj) {return std::holds_alternative<Vector*>(obj);}
+inline bool is_hash_table(const Obj& obj) {return std::holds_alternative<HashTable*>(obj);}
+inline bool is_bytevector(const Obj& obj) {return std::holds_alternative<Bytevector*>(obj);}
+inline bool is_string_port(const Obj& obj) {return std::holds_alternative<StringPort*>(obj);}
+inline bool is_pmap(const Obj& obj) {return std::holds_alternative<PersistentMap*>(obj);}
+inline bool is_record_type(const Obj& obj) {return std::holds_alternative<RecordType*>(obj);}
+inline bool is_record(const Obj& obj) {return std::holds_alternative<Record*>(obj);}
+inline bool is_promise(const Obj& obj) {return std::holds_alternative<Promise*>(obj);}
 inline bool is_builtin(const Obj& obj) {return std::holds_alternative<Builtin*>(obj);}
 inline bool is_procedure(const Obj& obj) {return std::holds_alternative<Procedure*>(obj);}
-inline bool is_callable(const Obj& obj) {return is_builtin(obj) || is_procedure(obj);}
+inline bool is_parameter(const Obj& obj) {return std::holds_alternative<Parameter*>(obj);}
+inline bool is_coroutine(const Obj& obj) {return std::holds_alternative<Coroutine*>(obj);}
+inline bool is_callable(const Obj& obj) {return is_builtin(obj) || is_procedure(obj) || is_parameter(obj) || is_coroutine(obj);}
 inline bool is_null(const Obj& obj) {return std::holds_alternative<Null>(obj);}
 inline bool is_void(const Obj& obj) {return std::holds_alternative<Void>(obj);}
 
@@ -158,12 +329,39 @@ inline Cons* const& as_pair(const Obj& obj) {return std::get<Cons*>(obj);}
 inline Vector*& as_vector(Obj& obj) {return std::get<Vector*>(obj);}
 inline Vector* const& as_vector(const Obj& obj) {return std::get<Vector*>(obj);}
 
+inline HashTable*& as_hash_table(Obj& obj) {return std::get<HashTable*>(obj);}
+inline HashTable* const& as_hash_table(const Obj& obj) {return std::get<HashTable*>(obj);}
+
+inline Bytevector*& as_bytevector(Obj& obj) {return std::get<Bytevector*>(obj);}
+inline Bytevector* const& as_bytevector(const Obj& obj) {return std::get<Bytevector*>(obj);}
+
+inline StringPort*& as_string_port(Obj& obj) {return std::get<StringPort*>(obj);}
+inline StringPort* const& as_string_port(const Obj& obj) {return std::get<StringPort*>(obj);}
+
+inline PersistentMap*& as_pmap(Obj& obj) {return std::get<PersistentMap*>(obj);}
+inline PersistentMap* const& as_pmap(const Obj& obj) {return std::get<PersistentMap*>(obj);}
+
+inline RecordType*& as_record_type(Obj& obj) {return std::get<RecordType*>(obj);}
+inline RecordType* const& as_record_type(const Obj& obj) {return std::get<RecordType*>(obj);}
+
+inline Record*& as_record(Obj& obj) {return std::get<Record*>(obj);}
+inline Record* const& as_record(const Obj& obj) {return std::get<Record*>(obj);}
+
+inline Promise*& as_promise(Obj& obj) {return std::get<Promise*>(obj);}
+inline Promise* const& as_promise(const Obj& obj) {return std::get<Promise*>(obj);}
+
 inline Builtin*& as_builtin(Obj& obj) {return std::get<Builtin*>(obj);}
 inline Builtin* const& as_builtin(const Obj& obj) {return std::get<Builtin*>(obj);}
 
 inline Procedure*& as_procedure(Obj& obj) {return std::get<Procedure*>(obj);}
 inline Procedure* const& as_procedure(const Obj& obj) {return std::get<Procedure*>(obj);}
 
+inline Parameter*& as_parameter(Obj& obj) {return std::get<Parameter*>(obj);}
+inline Parameter* const& as_parameter(const Obj& obj) {return std::get<Parameter*>(obj);}
+
+inline Coroutine*& as_coroutine(Obj& obj) {return std::get<Coroutine*>(obj);}
+inline Coroutine* const& as_coroutine(const Obj& obj) {return std::get<Coroutine*>(obj);}
+
 inline bool is_true(const Obj& obj) {return (!is_bool(obj) || as_bool(obj) == true);}
 inline bool is_false(const Obj& obj) {return !is_true(obj);}
 
@@ -182,6 +380,11 @@ inline bool is_list(const Obj& obj) {
 
 bool equal(const Obj, const Obj);
 
+size_t eqv_hash(const Obj&);
+size_t string_hash(const std::string&);
+size_t equal_hash(const Obj&);
+
+void stringify_into(std::string&, const Obj);
 std::string stringify(const Obj);
 std::string stringify_type(const Obj);
 
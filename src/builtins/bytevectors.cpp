@@ -0,0 +1,146 @@
+#include <builtins/common.hpp>
+#include <builtins/installer.hpp>
+#include <interpreter/interpreter.hpp>
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+namespace Scheme {
+
+static Bytevector*
+get_bytevector(const Obj& obj) {
+  assert_obj_type<Bytevector*>(obj, "bytevector");
+  return as_bytevector(obj);
+}
+
+static uint8_t
+get_byte(const Obj& obj) {
+  assert_obj_type<double>(obj, "number");
+  const auto n = as_number(obj);
+  if (!(0 <= n && n <= 255) || n != std::trunc(n)) {
+    throw std::runtime_error("expected a byte, got " + stringify(obj));
+  }
+  return n;
+}
+
+void
+BuiltinInstaller::install_bytevector_functions() {
+  install("bytevector?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return is_bytevector(args[0]);
+  });
+
+  install("make-bytevector", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 2);
+    const auto size = get_index(args[0], SIZE_MAX);
+    const uint8_t fill = args.size() == 2 ? get_byte(args[1]) : 0;
+    return interp.spawn<Bytevector>(size, fill);
+  });
+
+  install("bytevector", [](const ArgList& args, Interpreter& interp) {
+    const auto ret = interp.spawn<Bytevector>(args.size());
+    for (size_t i = 0; i < args.size(); i++) {
+      ret->data()[i] = get_byte(args[i]);
+    }
+    return ret;
+  });
+
+  install("bytevector-length", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return (double) get_bytevector(args[0])->size();
+  });
+
+  install("bytevector-u8-ref", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    const auto bv = get_bytevector(args[0]);
+    const auto i = get_index(args[1], bv->size());
+    if (i == bv->size()) {
+      throw std::runtime_error("bytevector index out of range");
+    }
+    return (double) bv->data()[i];
+  });
+
+  install("bytevector-u8-set!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    const auto bv = get_bytevector(args[0]);
+    const auto i = get_index(args[1], bv->size());
+    if (i == bv->size()) {
+      throw std::runtime_error("bytevector index out of range");
+    }
+    bv->data()[i] = get_byte(args[2]);
+    return Void {};
+  });
+
+  install("bytevector-fill!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 4);
+    const auto bv = get_bytevector(args[0]);
+    const auto fill = get_byte(args[1]);
+    const auto [start, end] = get_range(args, 2, bv->size());
+    std::fill(bv->data() + start, bv->data() + end, fill);
+    return Void {};
+  });
+
+  install("bytevector-copy", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 3);
+    const auto bv = get_bytevector(args[0]);
+    const auto [start, end] = get_range(args, 1, bv->size());
+    const auto ret = interp.spawn<Bytevector>(end - start);
+    std::copy(bv->data() + start, bv->data() + end, ret->data());
+    return ret;
+  });
+
+  // a view sharing the parent's storage; writes through either are visible in both
+  install("bytevector-slice", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 3);
+    const auto bv = get_bytevector(args[0]);
+    const auto [start, end] = get_range(args, 1, bv->size());
+    return interp.spawn<Bytevector>(*bv, start, end);
+  });
+
+  install("bytevector-copy!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 5);
+    const auto to = get_bytevector(args[0]);
+    const auto at = get_index(args[1], to->size());
+    const auto from = get_bytevector(args[2]);
+    const auto [start, end] = get_range(args, 3, from->size());
+    if (end - start > to->size() - at) {
+      throw std::runtime_error("bytevector-copy!: destination too small");
+    }
+    // the two may be slices of the same storage, so copy with memmove semantics
+    std::memmove(to->data() + at, from->data() + start, end - start);
+    return Void {};
+  });
+
+  install("bytevector-append", [](const ArgList& args, Interpreter& interp) {
+    size_t size = 0;
+    for (const auto& arg : args) {
+      size += get_bytevector(arg)->size();
+    }
+    const auto ret = interp.spawn<Bytevector>(size);
+    auto out = ret->data();
+    for (const auto& arg : args) {
+      const auto bv = as_bytevector(arg);
+      out = std::copy(bv->data(), bv->data() + bv->size(), out);
+    }
+    return ret;
+  });
+
+  install("utf8->string", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 3);
+    const auto bv = get_bytevector(args[0]);
+    const auto [start, end] = get_range(args, 1, bv->size());
+    return interp.spawn<String>(std::string(reinterpret_cast<const char*>(bv->data()) + start, end - start));
+  });
+
+  install("string->utf8", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 3);
+    assert_obj_type<String*>(args[0], "string");
+    const auto& str = as_string(args[0])->data;
+    const auto [start, end] = get_range(args, 1, str.size());
+    const auto ret = interp.spawn<Bytevector>(end - start);
+    std::copy(str.begin() + start, str.begin() + end, ret->data());
+    return ret;
+  });
+}
+
+}
@@ -0,0 +1,274 @@
+#include <builtins/common.hpp>
+#include <builtins/installer.hpp>
+#include <interpreter/expressions.hpp>
+#include <interpreter/evaluation.hpp>
+#include <interpreter/interpreter.hpp>
+#include <interpreter/exceptions.hpp>
+#include <interpreter/coroutine.hpp>
+#include <algorithm>
+#include <utility>
+#include <vector>
+
+namespace Scheme {
+
+// the nodes of a body looked through for uses of its continuation
+static constexpr size_t ESCAPE_ANALYSIS_NODES = 64;
+
+// whether the continuation passed to proc can only be invoked while its
+// call/cc runs: proc is a lambda that names it only as the operator of
+// calls, never as a value and never inside a closure of its own. a body too
+// large to look through quickly is taken to let it out.
+static bool
+only_escapes(const Obj& proc) {
+  if (!is_procedure(proc)) {
+    return false;
+  }
+  const auto p = as_procedure(proc);
+  if (p->is_variadic || p->parameters.size() != 1) {
+    return false;
+  }
+  const auto& k = p->parameters[0];
+  // each node with whether it is inside a closure
+  std::vector<std::pair<HeapEntity*, bool>> pending {{p->body, false}};
+  std::vector<const Expression*> operators {};
+  size_t seen = 0;
+  while (!pending.empty()) {
+    const auto [node, closed] = pending.back();
+    pending.pop_back();
+    const auto expr = dynamic_cast<Expression*>(node);
+    if (!expr) {
+      continue;
+    }
+    if (++seen > ESCAPE_ANALYSIS_NODES) {
+      return false;
+    }
+    if (const auto var = dynamic_cast<Variable*>(expr); var && var->sym == k) {
+      if (closed || std::find(operators.begin(), operators.end(), var) == operators.end()) {
+        return false;
+      }
+    }
+    if (const auto app = dynamic_cast<Application*>(expr)) {
+      operators.push_back(app->op);
+    }
+    const bool closure = closed || dynamic_cast<Lambda*>(expr) || dynamic_cast<Delay*>(expr) || dynamic_cast<StreamCons*>(expr);
+    MarkStack children;
+    expr->push_children(children);
+    for (; !children.empty(); children.pop()) {
+      pending.emplace_back(children.top(), closure);
+    }
+  }
+  return true;
+}
+
+// an escape, to a call/cc that has not returned, unwinds to it and copies
+// nothing. however the call/cc is left, the stack above it is copied on the
+// way out, so the continuation can be invoked again later, unless nothing
+// but an escape can ever invoke it; an error leaving it waits in the
+// continuation meanwhile. see Continuation.
+static Obj
+call_with_current_continuation(const ArgList& args, Interpreter& interp) {
+  assert_arg_count(args, 1, 1);
+  assert_callable(args[0]);
+  const bool escape_only = only_escapes(args[0]);
+  const auto k = interp.spawn<Continuation>();
+  ContinuationFrame frame {k, interp};
+  Obj result;
+  try {
+    result = as_obj(apply(args[0], {k}, interp));
+  }
+  catch (ContinuationThrow& t) {
+    if (t.k != k) {
+      k->error = std::current_exception();
+    }
+    else if (t.many) {
+      result = interp.return_values(as_vector(t.values)->data);
+    }
+    else {
+      result = std::move(t.values);
+    }
+  }
+  catch (...) {
+    k->error = std::current_exception();
+  }
+  if (!escape_only) {
+    if (auto values = capture(k, interp)) {
+      return std::move(*values);
+    }
+  }
+  if (k->error) {
+    std::rethrow_exception(std::exchange(k->error, nullptr));
+  }
+  return result;
+}
+
+void
+BuiltinInstaller::install_control_functions() {
+  install("call-with-current-continuation", call_with_current_continuation);
+  install("call/cc", call_with_current_continuation);
+
+  // after runs however control leaves thunk: by returning, by a
+  // continuation escaping past it, or by an error. it runs outside the catch,
+  // where it is free to switch coroutines. a coroutine discarded by the
+  // collector is unwound without running Scheme code, and a continuation
+  // put back inside thunk leaves the dynamic-wind in effect.
+  install("dynamic-wind", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    for (const auto& arg : args) {
+      assert_callable(arg);
+    }
+    apply(args[0], {}, interp);
+    Obj result;
+    std::exception_ptr error {};
+    {
+      Winder wind {args[0], args[2], interp};
+      try {
+        result = as_obj(apply(args[1], {}, interp));
+      }
+      catch (const CoroutineAbandoned&) {
+        throw;
+      }
+      catch (const Reinstate& r) {
+        if (r.keeps(wind)) {
+          throw;
+        }
+        error = std::current_exception();
+      }
+      catch (...) {
+        error = std::current_exception();
+      }
+    }
+    // after may return values of its own. this frame holds the error, so
+    // continuations captured in after stay escape-only until it is thrown.
+    ArgList values = interp.is_values(result) ? std::move(interp.values) : ArgList {};
+    {
+      UncopyableFrame uncopyable {interp, error != nullptr};
+      apply(args[2], {}, interp);
+    }
+    if (error) {
+      std::rethrow_exception(error);
+    }
+    interp.values = std::move(values);
+    return result;
+  });
+
+  install("values", [](const ArgList& args, Interpreter& interp) {
+    return interp.return_values(args);
+  });
+
+  install("call-with-values", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    assert_callable(args[0]);
+    assert_callable(args[1]);
+    auto result = as_obj(apply(args[0], {}, interp));
+    if (!interp.is_values(result)) {
+      return as_obj(apply(args[1], {std::move(result)}, interp));
+    }
+    return as_obj(apply(args[1], std::move(interp.values), interp));
+  });
+
+  // the converter, if any, also applies to the initial value
+  install("make-parameter", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 2);
+    Obj converter = false;
+    Obj value = args[0];
+    if (args.size() == 2) {
+      assert_callable(args[1]);
+      converter = args[1];
+      value = call(converter, {value}, interp);
+    }
+    return interp.spawn<Parameter>(std::move(value), std::move(converter));
+  });
+
+  install("make-generator", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    assert_callable(args[0]);
+    return interp.spawn<Coroutine>(args[0]);
+  });
+
+  install("yield", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 0, 1);
+    return yield(args.empty() ? Obj {Void {}} : args[0], interp);
+  });
+
+  install("generator?", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 1, 1);
+    return is_coroutine(args[0]);
+  });
+
+  install("eof-object", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 0, 0);
+    return interp.get_eof_object();
+  });
+
+  install("eof-object?", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 1, 1);
+    return is_record(args[0]) && as_record(args[0]) == interp.get_eof_object();
+  });
+
+  // how many calls deep recursion may go once it has run out of the
+  // thread's own stack and moved to segments of a megabyte; 0 allows no
+  // segments at all. returns the previous setting.
+  install("stack-limit", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 0, 1);
+    const auto previous = (double) interp.call_budget;
+    if (args.size() == 1) {
+      interp.call_budget = get_index(args[0], size_t {1} << 48);
+    }
+    return previous;
+  });
+
+  install("raise", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return raise(args[0], false, interp);
+  });
+
+  install("raise-continuable", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return raise(args[0], true, interp);
+  });
+
+  // installing a handler only links a frame in; nothing is paid unless
+  // something is raised
+  install("with-exception-handler", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    assert_callable(args[0]);
+    assert_callable(args[1]);
+    HandlerFrame frame {args[0], interp.handlers};
+    Obj condition;
+    try {
+      HandlerScope scope {interp, &frame};
+      return as_obj(apply(args[1], {}, interp));
+    }
+    catch (const std::runtime_error& e) {
+      condition = make_error_object(e, interp);
+    }
+    // thrown by a builtin rather than raised, so the stack has already
+    // unwound to here. the handler runs now, as if it had been raised.
+    HandlerScope scope {interp, &frame};
+    return raise(std::move(condition), false, interp);
+  });
+
+  install("error-object?", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 1, 1);
+    return is_error_object(args[0], interp);
+  });
+
+  install("error-object-message", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    if (!is_error_object(args[0], interp)) {
+      throw std::runtime_error("incorrect type for " + stringify(args[0]) + ", expected error object");
+    }
+    return as_record(args[0])->slots()[0];
+  });
+
+  install("error-object-irritants", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    if (!is_error_object(args[0], interp)) {
+      throw std::runtime_error("incorrect type for " + stringify(args[0]) + ", expected error object");
+    }
+    return as_record(args[0])->slots()[1];
+  });
+
+}
+
+}
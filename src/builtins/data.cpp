@@ -1,22 +1,75 @@
 #include <builtins/common.hpp>
 #include <builtins/installer.hpp>
 #include <interpreter/evaluation.hpp>
+#include <interpreter/lexer.hpp>
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cmath>
+#include <string_view>
 
 namespace Scheme {
 
+static ArgList&
+get_vector(const Obj& obj) {
+  assert_obj_type<Vector*>(obj, "vector");
+  return as_vector(obj)->data;
+}
+
+static size_t
+shortest_vector(const ArgList& args, const size_t from) {
+  size_t ret = SIZE_MAX;
+  for (size_t i = from; i < args.size(); i++) {
+    ret = std::min(ret, get_vector(args[i]).size());
+  }
+  return ret;
+}
+
+// the i-th element of each vector argument
+static ArgList
+vector_row(const ArgList& args, const size_t from, const size_t i) {
+  ArgList ret {};
+  ret.reserve(args.size() - from);
+  for (size_t j = from; j < args.size(); j++) {
+    ret.push_back(as_vector(args[j])->data[i]);
+  }
+  return ret;
+}
+
+// the compositions of car and cdr, two to four deep
+static constexpr std::array<std::string_view, 28> cxr_names {
+  "caar", "cadr", "cdar", "cddr",
+  "caaar", "caadr", "cadar", "caddr", "cdaar", "cdadr", "cddar", "cdddr",
+  "caaaar", "caaadr", "caadar", "caaddr", "cadaar", "cadadr", "caddar", "cadddr",
+  "cdaaar", "cdaadr", "cdadar", "cdaddr", "cddaar", "cddadr", "cdddar", "cddddr",
+};
+
 void 
 BuiltinInstaller::install_data_functions() {
   install("car", [](const ArgList& args, Interpreter& interp) {
     assert_arg_count(args, 1, 1);
     assert_obj_type<Cons*>(args[0], "pair");
     return as_pair(args[0])->car;
-  });
+  }, Primitive::CAR);
 
   install("cdr", [](const ArgList& args, Interpreter& interp) {
     assert_arg_count(args, 1, 1);
     assert_obj_type<Cons*>(args[0], "pair");
     return as_pair(args[0])->cdr;
-  });
+  }, Primitive::CDR);
+
+  // the letters between c and r are applied right to left
+  for (const auto name : cxr_names) {
+    install(std::string(name), [name](const ArgList& args, Interpreter& interp) {
+      assert_arg_count(args, 1, 1);
+      Obj curr = args[0];
+      for (size_t i = name.size() - 2; i > 0; i--) {
+        assert_obj_type<Cons*>(curr, "pair");
+        curr = name[i] == 'a' ? as_pair(curr)->car : as_pair(curr)->cdr;
+      }
+      return curr;
+    });
+  }
 
   install("not", [](const ArgList& args, Interpreter& interp) {
     assert_arg_count(args, 1, 1);
@@ -89,13 +142,57 @@ BuiltinInstaller::install_data_functions() {
     return interp.intern_symbol(as_string(args[0])->data);
   });
 
+  install("number->string", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 2);
+    assert_obj_type<double>(args[0], "number");
+    const double n = as_number(args[0]);
+    double radix = 10;
+    if (args.size() == 2) {
+      assert_obj_type<double>(args[1], "number");
+      radix = as_number(args[1]);
+      if (radix != 2 && radix != 8 && radix != 10 && radix != 16) {
+        throw std::runtime_error("radix must be 2, 8, 10 or 16");
+      }
+    }
+    if (radix == 10 || n != std::trunc(n) || std::abs(n) >= 0x1p63) {
+      return interp.spawn<String>(stringify(n));
+    }
+    char buf[72];
+    const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), static_cast<long long>(n), static_cast<int>(radix));
+    return interp.spawn<String>(std::string(buf, end));
+  });
+
+  install("string->number", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 1, 2);
+    assert_obj_type<String*>(args[0], "string");
+    double radix = 10;
+    if (args.size() == 2) {
+      assert_obj_type<double>(args[1], "number");
+      radix = as_number(args[1]);
+      if (radix != 2 && radix != 8 && radix != 10 && radix != 16) {
+        throw std::runtime_error("radix must be 2, 8, 10 or 16");
+      }
+    }
+    if (const auto value = read_number(as_string(args[0])->data, static_cast<int>(radix))) {
+      return *value;
+    }
+    else {
+      return false;
+    }
+  });
+
   install("string-append", [](const ArgList& args, Interpreter& interp) {
     assert_vec_type<String*>(args, "string");
-    std::stringstream ret {};
-    for (auto obj : args) {
-      ret << as_string(obj)->data;
+    size_t size = 0;
+    for (const auto& obj : args) {
+      size += as_string(obj)->data.size();
+    }
+    std::string ret {};
+    ret.reserve(size);
+    for (const auto& obj : args) {
+      ret += as_string(obj)->data;
     }
-    return interp.spawn<String>(ret.str());
+    return interp.spawn<String>(std::move(ret));
   });
 
   install("make-vector", [](const ArgList& args, Interpreter& interp) {
@@ -107,12 +204,12 @@ BuiltinInstaller::install_data_functions() {
     }
     if (args.size() == 2) {
       return interp.spawn<Vector>(
-        std::vector<Obj>(sz, args[1])
+        ArgList(sz, args[1])
       );
     }
     else {
       return interp.spawn<Vector>(
-        std::vector<Obj>(sz, Obj {(double) 0})
+        ArgList(sz, Obj {(double) 0})
       );
     }
   });
@@ -125,7 +222,7 @@ BuiltinInstaller::install_data_functions() {
     if (index < 0) {
       throw std::runtime_error("vector index cannot be negative");
     }
-    std::vector<Obj>& data = as_vector(args[0])->data;
+    ArgList& data = as_vector(args[0])->data;
     if (index >= data.size()) {
       throw std::runtime_error("vector index out of range");
     }
@@ -141,7 +238,7 @@ BuiltinInstaller::install_data_functions() {
     if (index < 0) {
       throw std::runtime_error("vector index cannot be negative");
     }
-    std::vector<Obj>& data = as_vector(args[0])->data;
+    ArgList& data = as_vector(args[0])->data;
     if (index >= data.size()) {
       throw std::runtime_error("vector index out of range");
     }
@@ -154,6 +251,151 @@ BuiltinInstaller::install_data_functions() {
     return (double) as_vector(args[0])->data.size();
   });
 
+  install("vector", [](const ArgList& args, Interpreter& interp) {
+    return interp.spawn<Vector>(args);
+  });
+
+  install("vector-copy", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 3);
+    const auto& data = get_vector(args[0]);
+    const auto [start, end] = get_range(args, 1, data.size());
+    return interp.spawn<Vector>(ArgList(data.begin() + start, data.begin() + end));
+  });
+
+  install("subvector", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    const auto& data = get_vector(args[0]);
+    const auto [start, end] = get_range(args, 1, data.size());
+    return interp.spawn<Vector>(ArgList(data.begin() + start, data.begin() + end));
+  });
+
+  // source and destination may overlap, as with memmove
+  install("vector-copy!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 5);
+    auto& to = get_vector(args[0]);
+    const auto at = get_index(args[1], to.size());
+    const auto& from = get_vector(args[2]);
+    const auto [start, end] = get_range(args, 3, from.size());
+    if (end - start > to.size() - at) {
+      throw std::runtime_error("vector-copy!: destination too small");
+    }
+    if (&from == &to && at > start) {
+      std::copy_backward(from.begin() + start, from.begin() + end, to.begin() + at + (end - start));
+    }
+    else {
+      std::copy(from.begin() + start, from.begin() + end, to.begin() + at);
+    }
+    return Void {};
+  });
+
+  install("vector-fill!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 4);
+    auto& data = get_vector(args[0]);
+    const auto [start, end] = get_range(args, 2, data.size());
+    std::fill(data.begin() + start, data.begin() + end, args[1]);
+    return Void {};
+  });
+
+  install("vector-append", [](const ArgList& args, Interpreter& interp) {
+    size_t size = 0;
+    for (const auto& arg : args) {
+      size += get_vector(arg).size();
+    }
+    ArgList ret {};
+    ret.reserve(size);
+    for (const auto& arg : args) {
+      const auto& data = as_vector(arg)->data;
+      ret.insert(ret.end(), data.begin(), data.end());
+    }
+    return interp.spawn<Vector>(std::move(ret));
+  });
+
+  install("list->vector", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    assert_list(args[0]);
+    ArgList ret {};
+    for (Obj ls = args[0]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      ret.push_back(as_pair(ls)->car);
+    }
+    return interp.spawn<Vector>(std::move(ret));
+  });
+
+  install("vector->list", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 3);
+    const auto& data = get_vector(args[0]);
+    const auto [start, end] = get_range(args, 1, data.size());
+    Obj ret = Null {};
+    for (size_t i = end; i > start; i--) {
+      ret = interp.spawn<Cons>(data[i - 1], ret);
+    }
+    return ret;
+  });
+
+  // a copy of the vector with room for at least k elements; the new slots
+  // hold 0, as with make-vector
+  install("vector-grow", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    const auto& data = get_vector(args[0]);
+    const auto size = get_index(args[1], MAX_ARGS * 1000);
+    if (size < data.size()) {
+      throw std::runtime_error("vector-grow: new size is smaller than the vector");
+    }
+    ArgList ret {};
+    ret.reserve(size);
+    ret.assign(data.begin(), data.end());
+    ret.resize(size, Obj {(double) 0});
+    return interp.spawn<Vector>(std::move(ret));
+  });
+
+  // the procedure may be called with fewer elements than the longest vector
+  // has; the result is as long as the shortest
+  install("vector-map", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, MAX_ARGS);
+    assert_callable(args[0]);
+    const auto size = shortest_vector(args, 1);
+    ArgList ret {};
+    ret.reserve(size);
+    for (size_t i = 0; i < size; i++) {
+      ret.push_back(call(args[0], vector_row(args, 1, i), interp));
+    }
+    return interp.spawn<Vector>(std::move(ret));
+  });
+
+  install("vector-for-each", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, MAX_ARGS);
+    assert_callable(args[0]);
+    const auto size = shortest_vector(args, 1);
+    for (size_t i = 0; i < size; i++) {
+      apply(args[0], vector_row(args, 1, i), interp);
+    }
+    return Void {};
+  });
+
+  // SRFI-133: (vector-binary-search v value cmp [start [end]]) where
+  // (cmp element value) is negative, zero or positive. returns an index of
+  // a matching element, or #f.
+  install("vector-binary-search", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 3, 5);
+    const auto& data = get_vector(args[0]);
+    assert_callable(args[2]);
+    auto [low, high] = get_range(args, 3, data.size());
+    while (low < high) {
+      const auto mid = low + (high - low) / 2;
+      const auto order = call(args[2], {data[mid], args[1]}, interp);
+      assert_obj_type<double>(order, "number");
+      if (as_number(order) < 0) {
+        low = mid + 1;
+      }
+      else if (as_number(order) > 0) {
+        high = mid;
+      }
+      else {
+        return (double) mid;
+      }
+    }
+    return false;
+  });
+
 }
 
 }
@@ -0,0 +1,258 @@
+#include <builtins/common.hpp>
+#include <builtins/installer.hpp>
+#include <interpreter/evaluation.hpp>
+#include <interpreter/hash_table.hpp>
+
+namespace Scheme {
+
+static HashTable::Kind
+kind_of_predicate(const Obj& pred) {
+  if (is_builtin(pred)) {
+    switch (as_builtin(pred)->prim) {
+      case Primitive::EQ:
+        return HashTable::Kind::EQ;
+      case Primitive::EQV:
+        return HashTable::Kind::EQV;
+      case Primitive::EQUAL:
+        return HashTable::Kind::EQUAL;
+      case Primitive::STRING_EQ:
+        return HashTable::Kind::STRING;
+      default:
+        break;
+    }
+  }
+  throw std::runtime_error("unsupported hash table equivalence: " + stringify(pred) + ", expected eq?, eqv?, equal? or string=?");
+}
+
+static HashTable*
+get_table(const ArgList& args) {
+  assert_obj_type<HashTable*>(args[0], "hash table");
+  return as_hash_table(args[0]);
+}
+
+// hashes are reported as non-negative integers that a double holds exactly,
+// reduced modulo the optional bound argument
+static double
+bounded_hash(const size_t h, const ArgList& args) {
+  if (args.size() == 2) {
+    assert_obj_type<double>(args[1], "number");
+    const auto bound = as_number(args[1]);
+    if (bound < 1) {
+      throw std::runtime_error("hash bound must be positive");
+    }
+    return (double) (h % static_cast<size_t>(bound));
+  }
+  return (double) (h >> 11);
+}
+
+void
+BuiltinInstaller::install_hash_table_functions() {
+  install("make-hash-table", [](const ArgList& args, Interpreter& interp) {
+    // a hash function argument is accepted for compatibility; the table
+    // always uses the hash matching its equivalence
+    assert_arg_count(args, 0, 3);
+    const auto kind = args.empty() ? HashTable::Kind::EQUAL : kind_of_predicate(args[0]);
+    return interp.spawn<HashTable>(kind);
+  });
+
+  install("make-eq-hash-table", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 0, 1);
+    return interp.spawn<HashTable>(HashTable::Kind::EQ);
+  });
+
+  install("make-eqv-hash-table", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 0, 1);
+    return interp.spawn<HashTable>(HashTable::Kind::EQV);
+  });
+
+  install("make-equal-hash-table", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 0, 1);
+    return interp.spawn<HashTable>(HashTable::Kind::EQUAL);
+  });
+
+  install("make-string-hash-table", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 0, 1);
+    return interp.spawn<HashTable>(HashTable::Kind::STRING);
+  });
+
+  install("hash-table-ref", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 4);
+    const auto table = get_table(args);
+    if (const auto found = table->find(args[1])) {
+      if (args.size() == 4) {
+        return call(args[3], {*found}, interp);
+      }
+      return *found;
+    }
+    else if (args.size() >= 3) {
+      return call(args[2], {}, interp);
+    }
+    else {
+      throw std::runtime_error("hash-table-ref: no value for key " + stringify(args[1]));
+    }
+  });
+
+  install("hash-table-ref/default", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    const auto found = get_table(args)->find(args[1]);
+    return found ? *found : args[2];
+  });
+
+  install("hash-table-set!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    get_table(args)->set(args[1], args[2]);
+    return Void {};
+  });
+
+  install("hash-table-delete!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    get_table(args)->erase(args[1]);
+    return Void {};
+  });
+
+  install("hash-table-contains?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    return get_table(args)->find(args[1]) != nullptr;
+  });
+
+  install("hash-table-exists?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    return get_table(args)->find(args[1]) != nullptr;
+  });
+
+  // the updater may itself modify the table, so the slot is looked up again
+  // when storing its result
+  install("hash-table-update!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 4);
+    const auto table = get_table(args);
+    Obj current;
+    if (const auto found = table->find(args[1])) {
+      current = *found;
+    }
+    else if (args.size() == 4) {
+      current = call(args[3], {}, interp);
+    }
+    else {
+      throw std::runtime_error("hash-table-update!: no value for key " + stringify(args[1]));
+    }
+    table->set(args[1], call(args[2], {current}, interp));
+    return Void {};
+  });
+
+  install("hash-table-update!/default", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 4, 4);
+    const auto table = get_table(args);
+    const auto found = table->find(args[1]);
+    Obj current = found ? *found : args[3];
+    table->set(args[1], call(args[2], {current}, interp));
+    return Void {};
+  });
+
+  install("hash-table-count", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return (double) get_table(args)->size();
+  });
+
+  install("hash-table-size", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return (double) get_table(args)->size();
+  });
+
+  install("hash-table-keys", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    Obj ret = Null {};
+    for (auto& [key, value] : get_table(args)->entries()) {
+      ret = interp.spawn<Cons>(key, ret);
+    }
+    return ret;
+  });
+
+  install("hash-table-values", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    Obj ret = Null {};
+    for (auto& [key, value] : get_table(args)->entries()) {
+      ret = interp.spawn<Cons>(value, ret);
+    }
+    return ret;
+  });
+
+  install("hash-table->alist", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    Obj ret = Null {};
+    for (auto& [key, value] : get_table(args)->entries()) {
+      ret = interp.spawn<Cons>(interp.spawn<Cons>(key, value), ret);
+    }
+    return ret;
+  });
+
+  install("alist->hash-table", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 3);
+    assert_list(args[0]);
+    const auto kind = args.size() == 1 ? HashTable::Kind::EQUAL : kind_of_predicate(args[1]);
+    const auto table = interp.spawn<HashTable>(kind);
+    // earlier associations take precedence, as with assoc
+    for (Obj ls = args[0]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      const auto entry = as_pair(ls)->car;
+      assert_obj_type<Cons*>(entry, "pair");
+      if (!table->find(as_pair(entry)->car)) {
+        table->set(as_pair(entry)->car, as_pair(entry)->cdr);
+      }
+    }
+    return table;
+  });
+
+  install("hash-table-walk", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    assert_callable(args[1]);
+    for (auto& [key, value] : get_table(args)->entries()) {
+      call(args[1], {key, value}, interp);
+    }
+    return Void {};
+  });
+
+  install("hash-table-fold", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    assert_callable(args[1]);
+    Obj acc = args[2];
+    for (auto& [key, value] : get_table(args)->entries()) {
+      acc = call(args[1], {key, value, acc}, interp);
+    }
+    return acc;
+  });
+
+  install("hash-table-clear!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    get_table(args)->clear();
+    return Void {};
+  });
+
+  install("hash-table-copy", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 2);
+    return interp.spawn<HashTable>(*get_table(args));
+  });
+
+  install("hash", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 2);
+    return bounded_hash(equal_hash(args[0]), args);
+  });
+
+  // agrees with equal?, also on circular structures, which are hashed up to
+  // a fixed number of nodes
+  install("equal-hash", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 2);
+    return bounded_hash(equal_hash(args[0]), args);
+  });
+
+  install("hash-by-identity", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 2);
+    return bounded_hash(eqv_hash(args[0]), args);
+  });
+
+  install("string-hash", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 2);
+    assert_obj_type<String*>(args[0], "string");
+    return bounded_hash(string_hash(as_string(args[0])->data), args);
+  });
+}
+
+}
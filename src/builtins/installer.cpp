@@ -7,8 +7,10 @@
 namespace Scheme {
 
 void
-BuiltinInstaller::install(const std::string& str, const std::function<Obj(const ArgList&, Interpreter&)> func) {
-  env->define(interp.intern_symbol(str), interp.spawn<Builtin>(func));
+BuiltinInstaller::install(const std::string& str, const std::function<Obj(ArgList&, Interpreter&)> func, Primitive prim) {
+  const auto builtin = interp.spawn<Builtin>(func, prim);
+  interp.builtins.push_back(builtin);
+  env->define(interp.intern_symbol(str), builtin);
 }
 
 void
@@ -17,6 +19,14 @@ BuiltinInstaller::install_all_functions() {
   install_data_functions();
   install_predicates();
   install_misc_functions();
+  install_list_functions();
+  install_hash_table_functions();
+  install_bytevector_functions();
+  install_string_functions();
+  install_persistent_map_functions();
+  install_sort_functions();
+  install_lazy_functions();
+  install_control_functions();
 }
 
 }
@@ -0,0 +1,598 @@
+#include <builtins/common.hpp>
+#include <builtins/installer.hpp>
+#include <interpreter/coroutine.hpp>
+#include <interpreter/evaluation.hpp>
+#include <interpreter/promise.hpp>
+#include <utility>
+
+namespace Scheme {
+
+// SRFI-41 streams, with each lazy operation a promise over a native step.
+// a step receives its state in args and returns the next stream, which is
+// itself usually a pair whose tail is a promise over the same step. cells
+// only point forward, so a stream's head is garbage once the caller drops
+// it.
+
+static Promise*
+eager(Obj value, Interpreter& interp, const bool stream = false) {
+  return interp.spawn<Promise>(interp.spawn<PromiseState>(std::move(value)), stream);
+}
+
+static Promise*
+lazy_stream(PromiseStep step, ArgList args, Interpreter& interp) {
+  return interp.spawn<Promise>(interp.spawn<PromiseState>(step, std::move(args), true), true);
+}
+
+static Promise*
+stream_null(Interpreter& interp) {
+  return eager(Null {}, interp, true);
+}
+
+// first is a promise for the element
+static Promise*
+stream_pair(Obj first, Obj rest, Interpreter& interp) {
+  return eager(interp.spawn<Cons>(std::move(first), std::move(rest)), interp, true);
+}
+
+static void
+assert_stream(const Obj& obj) {
+  if (!is_promise(obj) || !as_promise(obj)->stream) {
+    throw std::runtime_error("incorrect type for " + stringify(obj) + ", expected stream");
+  }
+}
+
+// the forced stream: () or a pair of element promise and rest stream
+static Obj
+force_stream(const Obj& stream, Interpreter& interp) {
+  assert_stream(stream);
+  return force(stream, interp);
+}
+
+static Obj
+stream_car(const Obj& cell, Interpreter& interp) {
+  return force(as_pair(cell)->car, interp);
+}
+
+static Obj
+stream_cdr(const Obj& cell) {
+  return as_pair(cell)->cdr;
+}
+
+static size_t
+get_count(const Obj& obj) {
+  return get_index(obj, SIZE_MAX);
+}
+
+static Obj
+apply_step(const ArgList& args, Interpreter& interp) {
+  return call(args[0], ArgList(args.begin() + 1, args.end()), interp);
+}
+
+// a promise for (proc args ...), so elements are computed only when used
+static Promise*
+delayed_call(ArgList args, Interpreter& interp) {
+  return interp.spawn<Promise>(interp.spawn<PromiseState>(apply_step, std::move(args), false));
+}
+
+// args: stream ...
+static Obj
+append_step(const ArgList& args, Interpreter& interp) {
+  for (size_t i = 0; i < args.size(); i++) {
+    const auto cell = force_stream(args[i], interp);
+    if (is_pair(cell)) {
+      ArgList rest(args.begin() + i, args.end());
+      rest[0] = stream_cdr(cell);
+      return stream_pair(as_pair(cell)->car, lazy_stream(append_step, std::move(rest), interp), interp);
+    }
+  }
+  return stream_null(interp);
+}
+
+// args: current stream, stream of remaining streams
+static Obj
+concat_step(const ArgList& args, Interpreter& interp) {
+  Obj current = args[0];
+  Obj streams = args[1];
+  while (true) {
+    const auto cell = force_stream(current, interp);
+    if (is_pair(cell)) {
+      return stream_pair(as_pair(cell)->car, lazy_stream(concat_step, {stream_cdr(cell), streams}, interp), interp);
+    }
+    const auto outer = force_stream(streams, interp);
+    if (!is_pair(outer)) {
+      return stream_null(interp);
+    }
+    current = stream_car(outer, interp);
+    streams = stream_cdr(outer);
+  }
+}
+
+// args: n, stream
+static Obj
+drop_step(const ArgList& args, Interpreter& interp) {
+  Obj stream = args[1];
+  for (size_t n = get_count(args[0]); n > 0; n--) {
+    const auto cell = force_stream(stream, interp);
+    if (!is_pair(cell)) {
+      break;
+    }
+    stream = stream_cdr(cell);
+  }
+  return stream;
+}
+
+// args: pred, stream
+static Obj
+drop_while_step(const ArgList& args, Interpreter& interp) {
+  Obj stream = args[1];
+  while (true) {
+    const auto cell = force_stream(stream, interp);
+    if (!is_pair(cell) || is_false(call(args[0], {stream_car(cell, interp)}, interp))) {
+      return stream;
+    }
+    stream = stream_cdr(cell);
+  }
+}
+
+// args: pred, stream
+static Obj
+filter_step(const ArgList& args, Interpreter& interp) {
+  Obj stream = args[1];
+  while (true) {
+    const auto cell = force_stream(stream, interp);
+    if (!is_pair(cell)) {
+      return stream_null(interp);
+    }
+    if (is_true(call(args[0], {stream_car(cell, interp)}, interp))) {
+      return stream_pair(as_pair(cell)->car, lazy_stream(filter_step, {args[0], stream_cdr(cell)}, interp), interp);
+    }
+    stream = stream_cdr(cell);
+  }
+}
+
+// args: first, step
+static Obj
+from_step(const ArgList& args, Interpreter& interp) {
+  const auto next = as_number(args[0]) + as_number(args[1]);
+  return stream_pair(eager(args[0], interp), lazy_stream(from_step, {next, args[1]}, interp), interp);
+}
+
+// args: proc, x
+static Obj
+iterate_step(const ArgList& args, Interpreter& interp);
+
+static Obj
+iterate_next_step(const ArgList& args, Interpreter& interp) {
+  return iterate_step({args[0], call(args[0], {args[1]}, interp)}, interp);
+}
+
+static Obj
+iterate_step(const ArgList& args, Interpreter& interp) {
+  return stream_pair(eager(args[1], interp), lazy_stream(iterate_next_step, args, interp), interp);
+}
+
+// args: proc, stream ...
+static Obj
+map_step(const ArgList& args, Interpreter& interp) {
+  ArgList call_args {args[0]};
+  ArgList rest {args[0]};
+  for (size_t i = 1; i < args.size(); i++) {
+    const auto cell = force_stream(args[i], interp);
+    if (!is_pair(cell)) {
+      return stream_null(interp);
+    }
+    call_args.push_back(stream_car(cell, interp));
+    rest.push_back(stream_cdr(cell));
+  }
+  return stream_pair(delayed_call(std::move(call_args), interp), lazy_stream(map_step, std::move(rest), interp), interp);
+}
+
+// args: first, past, step
+static Obj
+range_step(const ArgList& args, Interpreter& interp) {
+  const auto first = as_number(args[0]);
+  const auto past = as_number(args[1]);
+  const auto step = as_number(args[2]);
+  if (step > 0 ? first >= past : first <= past) {
+    return stream_null(interp);
+  }
+  return stream_pair(eager(first, interp), lazy_stream(range_step, {first + step, past, step}, interp), interp);
+}
+
+// args: proc, acc, stream
+static Obj
+scan_next_step(const ArgList& args, Interpreter& interp);
+
+static Obj
+scan_step(const ArgList& args, Interpreter& interp) {
+  return stream_pair(eager(args[1], interp), lazy_stream(scan_next_step, args, interp), interp);
+}
+
+static Obj
+scan_next_step(const ArgList& args, Interpreter& interp) {
+  const auto cell = force_stream(args[2], interp);
+  if (!is_pair(cell)) {
+    return stream_null(interp);
+  }
+  const auto acc = call(args[0], {args[1], stream_car(cell, interp)}, interp);
+  return scan_step({args[0], acc, stream_cdr(cell)}, interp);
+}
+
+// args: n, stream
+static Obj
+take_step(const ArgList& args, Interpreter& interp) {
+  const auto n = get_count(args[0]);
+  if (n == 0) {
+    return stream_null(interp);
+  }
+  const auto cell = force_stream(args[1], interp);
+  if (!is_pair(cell)) {
+    return stream_null(interp);
+  }
+  return stream_pair(as_pair(cell)->car, lazy_stream(take_step, {(double) (n - 1), stream_cdr(cell)}, interp), interp);
+}
+
+// args: pred, stream
+static Obj
+take_while_step(const ArgList& args, Interpreter& interp) {
+  const auto cell = force_stream(args[1], interp);
+  if (!is_pair(cell) || is_false(call(args[0], {stream_car(cell, interp)}, interp))) {
+    return stream_null(interp);
+  }
+  return stream_pair(as_pair(cell)->car, lazy_stream(take_while_step, {args[0], stream_cdr(cell)}, interp), interp);
+}
+
+// args: mapper, pred, generator, base
+static Obj
+unfold_step(const ArgList& args, Interpreter& interp) {
+  if (is_false(call(args[1], {args[3]}, interp))) {
+    return stream_null(interp);
+  }
+  const auto next = call(args[2], {args[3]}, interp);
+  return stream_pair(
+    delayed_call({args[0], args[3]}, interp),
+    lazy_stream(unfold_step, {args[0], args[1], args[2], next}, interp),
+    interp
+  );
+}
+
+// args: stream ...
+static Obj
+zip_step(const ArgList& args, Interpreter& interp) {
+  ArgList firsts {};
+  ArgList rest {};
+  for (const auto& stream : args) {
+    const auto cell = force_stream(stream, interp);
+    if (!is_pair(cell)) {
+      return stream_null(interp);
+    }
+    firsts.push_back(stream_car(cell, interp));
+    rest.push_back(stream_cdr(cell));
+  }
+  Obj row = Null {};
+  for (auto x = firsts.rbegin(); x != firsts.rend(); x++) {
+    row = interp.spawn<Cons>(*x, row);
+  }
+  return stream_pair(eager(row, interp), lazy_stream(zip_step, std::move(rest), interp), interp);
+}
+
+static Obj
+list_to_stream(const Obj& ls, Interpreter& interp) {
+  assert_list(ls);
+  ArgList elements {};
+  for (Obj curr = ls; is_pair(curr); curr = as_pair(curr)->cdr) {
+    elements.push_back(as_pair(curr)->car);
+  }
+  Obj ret = stream_null(interp);
+  for (auto x = elements.rbegin(); x != elements.rend(); x++) {
+    ret = stream_pair(eager(*x, interp), ret, interp);
+  }
+  return ret;
+}
+
+// takes a stream out of a consumer's argument list, so that the cells the
+// consumer has walked past are not kept by the list while it runs
+static Obj
+take_stream(ArgList& args, const size_t i) {
+  return std::exchange(args[i], Obj {0.0});
+}
+
+static void
+assert_streams(const ArgList& args, const size_t from) {
+  for (size_t i = from; i < args.size(); i++) {
+    assert_stream(args[i]);
+  }
+}
+
+// a consumer walks a stream on cleared stack, and with the stream taken out
+// of its arguments: a stale copy of the head beneath it would keep alive
+// every cell it walks past
+template<Obj (*walk)(ArgList&, Interpreter&)>
+static Obj
+consuming(ArgList& args, Interpreter& interp) {
+  clear_stack();
+  return walk(args, interp);
+}
+
+// (stream->list [n] s), as in SRFI-41
+[[gnu::noinline]] static Obj
+stream_to_list(ArgList& args, Interpreter& interp) {
+  assert_arg_count(args, 1, 2);
+  size_t n = SIZE_MAX;
+  Obj stream = take_stream(args, args.size() - 1);
+  if (args.size() == 2) {
+    n = get_count(args[0]);
+  }
+  ArgList elements {};
+  for (; n > 0; n--) {
+    const auto cell = force_stream(stream, interp);
+    if (!is_pair(cell)) {
+      break;
+    }
+    elements.push_back(stream_car(cell, interp));
+    stream = stream_cdr(cell);
+  }
+  Obj ret = Null {};
+  for (auto x = elements.rbegin(); x != elements.rend(); x++) {
+    ret = interp.spawn<Cons>(*x, ret);
+  }
+  return ret;
+}
+
+[[gnu::noinline]] static Obj
+stream_fold(ArgList& args, Interpreter& interp) {
+  assert_arg_count(args, 3, 3);
+  assert_callable(args[0]);
+  Obj acc = args[1];
+  Obj stream = take_stream(args, 2);
+  while (true) {
+    const auto cell = force_stream(stream, interp);
+    if (!is_pair(cell)) {
+      return acc;
+    }
+    acc = call(args[0], {acc, stream_car(cell, interp)}, interp);
+    stream = stream_cdr(cell);
+  }
+}
+
+[[gnu::noinline]] static Obj
+stream_for_each(ArgList& args, Interpreter& interp) {
+  assert_arg_count(args, 2, MAX_ARGS);
+  assert_callable(args[0]);
+  ArgList streams(args.begin() + 1, args.end());
+  std::fill(args.begin() + 1, args.end(), Obj {0.0});
+  ArgList firsts {};
+  while (true) {
+    firsts.clear();
+    for (auto& stream : streams) {
+      const auto cell = force_stream(stream, interp);
+      if (!is_pair(cell)) {
+        return Void {};
+      }
+      firsts.push_back(stream_car(cell, interp));
+      stream = stream_cdr(cell);
+    }
+    call(args[0], firsts, interp);
+  }
+}
+
+[[gnu::noinline]] static Obj
+stream_length(ArgList& args, Interpreter& interp) {
+  assert_arg_count(args, 1, 1);
+  size_t length = 0;
+  for (Obj cell = force_stream(take_stream(args, 0), interp); is_pair(cell); cell = force_stream(stream_cdr(cell), interp)) {
+    length++;
+  }
+  return (double) length;
+}
+
+[[gnu::noinline]] static Obj
+stream_ref(ArgList& args, Interpreter& interp) {
+  assert_arg_count(args, 2, 2);
+  Obj stream = take_stream(args, 0);
+  for (size_t n = get_count(args[1]); ; n--) {
+    const auto cell = force_stream(stream, interp);
+    if (!is_pair(cell)) {
+      throw std::runtime_error("stream-ref: index out of range");
+    }
+    if (n == 0) {
+      return stream_car(cell, interp);
+    }
+    stream = stream_cdr(cell);
+  }
+}
+
+void
+BuiltinInstaller::install_lazy_functions() {
+  install("make-promise", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 1, 1);
+    if (is_promise(args[0])) {
+      return args[0];
+    }
+    return eager(args[0], interp);
+  });
+
+  install("force", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return force(args[0], interp);
+  });
+
+  install("promise?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return is_promise(args[0]);
+  });
+
+  env->define(interp.intern_symbol("stream-null"), stream_null(interp));
+
+  install("stream?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return is_promise(args[0]) && as_promise(args[0])->stream;
+  });
+
+  install("stream-null?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return is_promise(args[0]) && as_promise(args[0])->stream && is_null(force(args[0], interp));
+  });
+
+  install("stream-pair?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return is_promise(args[0]) && as_promise(args[0])->stream && is_pair(force(args[0], interp));
+  });
+
+  install("stream-car", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    const auto cell = force_stream(args[0], interp);
+    if (!is_pair(cell)) {
+      throw std::runtime_error("stream-car: empty stream");
+    }
+    return stream_car(cell, interp);
+  });
+
+  install("stream-cdr", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    const auto cell = force_stream(args[0], interp);
+    if (!is_pair(cell)) {
+      throw std::runtime_error("stream-cdr: empty stream");
+    }
+    return stream_cdr(cell);
+  });
+
+  install("list->stream", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return list_to_stream(args[0], interp);
+  });
+
+  install("stream->list", consuming<stream_to_list>);
+
+  install("stream-append", [](const ArgList& args, Interpreter& interp) {
+    assert_streams(args, 0);
+    return lazy_stream(append_step, args, interp);
+  });
+
+  install("stream-concat", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    assert_stream(args[0]);
+    return lazy_stream(concat_step, {stream_null(interp), args[0]}, interp);
+  });
+
+  // a circular stream of the arguments, in constant space
+  install("stream-constant", [](const ArgList& args, Interpreter& interp) -> Obj {
+    if (args.empty()) {
+      return stream_null(interp);
+    }
+    const auto first = stream_pair(eager(args[0], interp), Null {}, interp);
+    auto last = first;
+    for (size_t i = 1; i < args.size(); i++) {
+      const auto next = stream_pair(eager(args[i], interp), Null {}, interp);
+      as_pair(last->state->value)->cdr = next;
+      last = next;
+    }
+    as_pair(last->state->value)->cdr = first;
+    return first;
+  });
+
+  install("stream-drop", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    get_count(args[0]);
+    assert_stream(args[1]);
+    return lazy_stream(drop_step, args, interp);
+  });
+
+  install("stream-drop-while", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    assert_callable(args[0]);
+    assert_stream(args[1]);
+    return lazy_stream(drop_while_step, args, interp);
+  });
+
+  install("stream-filter", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    assert_callable(args[0]);
+    assert_stream(args[1]);
+    return lazy_stream(filter_step, args, interp);
+  });
+
+  install("stream-fold", consuming<stream_fold>);
+
+  install("stream-for-each", consuming<stream_for_each>);
+
+  install("stream-from", [](const ArgList& args, Interpreter& interp) {
+    assert_numbers(args, 1, 2);
+    return lazy_stream(from_step, {args[0], args.size() == 2 ? args[1] : Obj(1.0)}, interp);
+  });
+
+  install("stream-iterate", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    assert_callable(args[0]);
+    return lazy_stream(iterate_step, args, interp);
+  });
+
+  install("stream-length", consuming<stream_length>);
+
+  install("stream-map", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, MAX_ARGS);
+    assert_callable(args[0]);
+    assert_streams(args, 1);
+    return lazy_stream(map_step, args, interp);
+  });
+
+  install("stream-range", [](const ArgList& args, Interpreter& interp) {
+    assert_numbers(args, 2, 3);
+    const double step =
+        args.size() == 3
+      ? as_number(args[2])
+      : (as_number(args[0]) < as_number(args[1]) ? 1 : -1);
+    if (step == 0) {
+      throw std::runtime_error("stream-range: step cannot be zero");
+    }
+    return lazy_stream(range_step, {args[0], args[1], step}, interp);
+  });
+
+  install("stream-ref", consuming<stream_ref>);
+
+  install("stream-reverse", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    Obj ret = stream_null(interp);
+    for (Obj cell = force_stream(args[0], interp); is_pair(cell); cell = force_stream(stream_cdr(cell), interp)) {
+      ret = stream_pair(as_pair(cell)->car, ret, interp);
+    }
+    return ret;
+  });
+
+  install("stream-scan", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    assert_callable(args[0]);
+    assert_stream(args[2]);
+    return lazy_stream(scan_step, args, interp);
+  });
+
+  install("stream-take", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    get_count(args[0]);
+    assert_stream(args[1]);
+    return lazy_stream(take_step, args, interp);
+  });
+
+  install("stream-take-while", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    assert_callable(args[0]);
+    assert_stream(args[1]);
+    return lazy_stream(take_while_step, args, interp);
+  });
+
+  install("stream-unfold", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 4, 4);
+    assert_callable(args[0]);
+    assert_callable(args[1]);
+    assert_callable(args[2]);
+    return lazy_stream(unfold_step, args, interp);
+  });
+
+  install("stream-zip", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, MAX_ARGS);
+    assert_streams(args, 0);
+    return lazy_stream(zip_step, args, interp);
+  });
+}
+
+}
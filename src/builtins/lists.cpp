@@ -0,0 +1,384 @@
+#include <builtins/common.hpp>
+#include <builtins/installer.hpp>
+#include <interpreter/evaluation.hpp>
+
+namespace Scheme {
+
+// appends to the end of a list under construction without walking it
+class ListBuilder {
+private:
+  Obj head;
+  Cons *tail;
+  Interpreter& interp;
+
+public:
+  ListBuilder(Interpreter& interp): head {Null {}}, tail {nullptr}, interp {interp} {}
+
+  void push_back(Obj obj) {
+    const auto cell = interp.spawn<Cons>(std::move(obj), Null {});
+    if (tail) {
+      tail->cdr = cell;
+    }
+    else {
+      head = cell;
+    }
+    tail = cell;
+  }
+
+  // the tail is shared, not copied
+  Obj finish(Obj rest = Null {}) {
+    if (tail) {
+      tail->cdr = std::move(rest);
+      return head;
+    }
+    return rest;
+  }
+};
+
+// advances every list in lists by one, collecting the cars into args;
+// false once any of them has run out
+static bool
+next_cars(ArgList& lists, ArgList& args) {
+  args.clear();
+  for (auto& ls : lists) {
+    if (!is_pair(ls)) {
+      return false;
+    }
+    args.push_back(as_pair(ls)->car);
+    ls = as_pair(ls)->cdr;
+  }
+  return true;
+}
+
+static ArgList
+list_args(const ArgList& args, const size_t from) {
+  return ArgList(args.begin() + from, args.end());
+}
+
+using Equivalence = bool (*)(const Obj&, const Obj&);
+
+static bool eq_equivalence(const Obj& a, const Obj& b) {return a == b;}
+static bool equal_equivalence(const Obj& a, const Obj& b) {return equal(a, b);}
+
+static Obj
+find_member(const Obj& x, Obj ls, Equivalence same) {
+  while (is_pair(ls)) {
+    if (same(x, as_pair(ls)->car)) {
+      return ls;
+    }
+    ls = as_pair(ls)->cdr;
+  }
+  return false;
+}
+
+static Obj
+find_assoc(const Obj& key, Obj alist, Equivalence same) {
+  while (is_pair(alist)) {
+    const auto entry = as_pair(alist)->car;
+    assert_obj_type<Cons*>(entry, "pair");
+    if (same(key, as_pair(entry)->car)) {
+      return entry;
+    }
+    alist = as_pair(alist)->cdr;
+  }
+  return false;
+}
+
+void
+BuiltinInstaller::install_list_functions() {
+  install("map", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, MAX_ARGS);
+    assert_callable(args[0]);
+    auto lists = list_args(args, 1);
+    ArgList cars {};
+    ListBuilder ret(interp);
+    while (next_cars(lists, cars)) {
+      ret.push_back(call(args[0], cars, interp));
+    }
+    return ret.finish();
+  });
+
+  install("for-each", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, MAX_ARGS);
+    assert_callable(args[0]);
+    auto lists = list_args(args, 1);
+    ArgList cars {};
+    while (next_cars(lists, cars)) {
+      call(args[0], cars, interp);
+    }
+    return Void {};
+  });
+
+  install("filter", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    assert_callable(args[0]);
+    ListBuilder ret(interp);
+    for (Obj ls = args[1]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      const auto x = as_pair(ls)->car;
+      if (is_true(call(args[0], {x}, interp))) {
+        ret.push_back(x);
+      }
+    }
+    return ret.finish();
+  });
+
+  install("remove", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    assert_callable(args[0]);
+    ListBuilder ret(interp);
+    for (Obj ls = args[1]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      const auto x = as_pair(ls)->car;
+      if (is_false(call(args[0], {x}, interp))) {
+        ret.push_back(x);
+      }
+    }
+    return ret.finish();
+  });
+
+  // (reduce f init lst) folds from the left as (f acc x)
+  install("reduce", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    assert_callable(args[0]);
+    Obj acc = args[1];
+    for (Obj ls = args[2]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      acc = call(args[0], {acc, as_pair(ls)->car}, interp);
+    }
+    return acc;
+  });
+
+  // SRFI-1: (fold kons knil lst ...) calls (kons x ... acc)
+  install("fold", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, MAX_ARGS);
+    assert_callable(args[0]);
+    auto lists = list_args(args, 2);
+    Obj acc = args[1];
+    ArgList cars {};
+    while (next_cars(lists, cars)) {
+      cars.push_back(acc);
+      acc = call(args[0], cars, interp);
+    }
+    return acc;
+  });
+
+  install("fold-right", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, MAX_ARGS);
+    assert_callable(args[0]);
+    auto lists = list_args(args, 2);
+    const size_t width = lists.size();
+    // the rows of cars, one after another
+    ArgList rows {};
+    ArgList cars {};
+    while (next_cars(lists, cars)) {
+      rows.insert(rows.end(), cars.begin(), cars.end());
+    }
+    Obj acc = args[1];
+    for (size_t end = rows.size(); end > 0; end -= width) {
+      ArgList row(rows.begin() + (end - width), rows.begin() + end);
+      row.push_back(acc);
+      acc = call(args[0], std::move(row), interp);
+    }
+    return acc;
+  });
+
+  install("append", [](const ArgList& args, Interpreter& interp) -> Obj {
+    if (args.empty()) {
+      return Null {};
+    }
+    ListBuilder ret(interp);
+    for (size_t i = 0; i + 1 < args.size(); i++) {
+      assert_list(args[i]);
+      for (Obj ls = args[i]; is_pair(ls); ls = as_pair(ls)->cdr) {
+        ret.push_back(as_pair(ls)->car);
+      }
+    }
+    return ret.finish(args.back());
+  });
+
+  install("append!", [](const ArgList& args, Interpreter& interp) -> Obj {
+    Obj ret = Null {};
+    Cons *last = nullptr;
+    for (size_t i = 0; i < args.size(); i++) {
+      const auto& ls = args[i];
+      if (is_null(ls)) {
+        continue;
+      }
+      if (last) {
+        last->cdr = ls;
+      }
+      else {
+        ret = ls;
+      }
+      if (i + 1 < args.size()) {
+        assert_obj_type<Cons*>(ls, "list");
+        last = as_pair(ls);
+        while (is_pair(last->cdr)) {
+          last = as_pair(last->cdr);
+        }
+      }
+    }
+    return ret;
+  });
+
+  install("reverse", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    assert_list(args[0]);
+    Obj ret = Null {};
+    for (Obj ls = args[0]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      ret = interp.spawn<Cons>(as_pair(ls)->car, ret);
+    }
+    return ret;
+  });
+
+  install("list-copy", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    ListBuilder ret(interp);
+    Obj ls = args[0];
+    for (; is_pair(ls); ls = as_pair(ls)->cdr) {
+      ret.push_back(as_pair(ls)->car);
+    }
+    return ret.finish(ls);
+  });
+
+  install("last-pair", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    assert_obj_type<Cons*>(args[0], "pair");
+    auto ls = as_pair(args[0]);
+    while (is_pair(ls->cdr)) {
+      ls = as_pair(ls->cdr);
+    }
+    return ls;
+  });
+
+  install("list-tail", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    assert_obj_type<double>(args[1], "number");
+    const auto k = as_number(args[1]);
+    if (k < 0) {
+      throw std::runtime_error("list index cannot be negative");
+    }
+    Obj ls = args[0];
+    for (int i = 0; i < k; i++) {
+      if (!is_pair(ls)) {
+        throw std::runtime_error("longer list expected");
+      }
+      ls = as_pair(ls)->cdr;
+    }
+    return ls;
+  });
+
+  install("iota", [](const ArgList& args, Interpreter& interp) {
+    assert_numbers(args, 1, 3);
+    const auto count = as_number(args[0]);
+    if (count < 0) {
+      throw std::runtime_error("iota count cannot be negative");
+    }
+    const double start = args.size() > 1 ? as_number(args[1]) : 0;
+    const double step = args.size() > 2 ? as_number(args[2]) : 1;
+    ListBuilder ret(interp);
+    for (int i = 0; i < count; i++) {
+      ret.push_back(start + i * step);
+    }
+    return ret.finish();
+  });
+
+  install("memq", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    return find_member(args[0], args[1], eq_equivalence);
+  });
+
+  install("memv", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    return find_member(args[0], args[1], eq_equivalence);
+  });
+
+  install("member", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 2, 3);
+    if (args.size() == 2) {
+      return find_member(args[0], args[1], equal_equivalence);
+    }
+    assert_callable(args[2]);
+    for (Obj ls = args[1]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      if (is_true(call(args[2], {args[0], as_pair(ls)->car}, interp))) {
+        return ls;
+      }
+    }
+    return false;
+  });
+
+  install("assq", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    return find_assoc(args[0], args[1], eq_equivalence);
+  });
+
+  install("assv", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    return find_assoc(args[0], args[1], eq_equivalence);
+  });
+
+  install("assoc", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 2, 3);
+    if (args.size() == 2) {
+      return find_assoc(args[0], args[1], equal_equivalence);
+    }
+    assert_callable(args[2]);
+    for (Obj ls = args[1]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      const auto entry = as_pair(ls)->car;
+      assert_obj_type<Cons*>(entry, "pair");
+      if (is_true(call(args[2], {args[0], as_pair(entry)->car}, interp))) {
+        return entry;
+      }
+    }
+    return false;
+  });
+
+  install("delete", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 3);
+    if (args.size() == 3) {
+      assert_callable(args[2]);
+    }
+    ListBuilder ret(interp);
+    for (Obj ls = args[1]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      const auto x = as_pair(ls)->car;
+      const bool same =
+          args.size() == 3
+        ? is_true(call(args[2], {args[0], x}, interp))
+        : equal(args[0], x);
+      if (!same) {
+        ret.push_back(x);
+      }
+    }
+    return ret.finish();
+  });
+
+  // SRFI-1: any returns the first true result, every the last result
+  install("any", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 2, MAX_ARGS);
+    assert_callable(args[0]);
+    auto lists = list_args(args, 1);
+    ArgList cars {};
+    while (next_cars(lists, cars)) {
+      auto res = call(args[0], cars, interp);
+      if (is_true(res)) {
+        return res;
+      }
+    }
+    return false;
+  });
+
+  install("every", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 2, MAX_ARGS);
+    assert_callable(args[0]);
+    auto lists = list_args(args, 1);
+    ArgList cars {};
+    Obj res = true;
+    while (next_cars(lists, cars)) {
+      res = call(args[0], cars, interp);
+      if (is_false(res)) {
+        return false;
+      }
+    }
+    return res;
+  });
+}
+
+}
@@ -2,39 +2,55 @@
 #include <builtins/installer.hpp>
 #include <interpreter/expressions.hpp>
 #include <interpreter/evaluation.hpp>
+#include <interpreter/exceptions.hpp>
+#include <interpreter/image.hpp>
 #include <iostream>
-#include <sstream>
 
 namespace Scheme {
 
 void
 BuiltinInstaller::install_misc_functions() {
   install("newline", [](const ArgList& args, Interpreter& interp) {
-    assert_arg_count(args, 0, 0);
+    assert_arg_count(args, 0, 1);
+    if (args.size() == 1) {
+      assert_obj_type<StringPort*>(args[0], "string port");
+      as_string_port(args[0])->buffer += '\n';
+      return Void {};
+    }
     std::cout << std::endl;
     return Void {};
   });
 
   install("display", [](const ArgList& args, Interpreter& interp) {
-    assert_arg_count(args, 1, 1);
-    std::cout << stringify(args[0]);
+    assert_arg_count(args, 1, 2);
+    if (args.size() == 2) {
+      assert_obj_type<StringPort*>(args[1], "string port");
+      stringify_into(as_string_port(args[1])->buffer, args[0]);
+      return Void {};
+    }
+    static std::string buffer;
+    buffer.clear();
+    stringify_into(buffer, args[0]);
+    std::cout.write(buffer.data(), buffer.size());
     std::cout.flush();
     return Void {};
   });
 
+  // the message and irritants are kept as they are, and only formatted if
+  // the error reaches the top level
   install("error", [](const ArgList& args, Interpreter& interp) -> Obj {
-    std::ostringstream message;
-    message << "ERROR: ";
-    for (auto obj : args) {
-      message << stringify(obj);
-      message << " ";
+    assert_arg_count(args, 1, MAX_ARGS);
+    Obj irritants = Null {};
+    for (size_t i = args.size(); i-- > 1; ) {
+      irritants = interp.spawn<Cons>(args[i], irritants);
     }
-    throw std::runtime_error(message.str());
+    return raise(make_error_object(args[0], irritants, interp), false, interp);
   });
   
   install("eval", [](const ArgList& args, Interpreter& interp) {
     assert_arg_count(args, 1, 1);
     auto ast = build_ast(args[0], interp);
+    EvaluationScope scope {interp, ast};
     return as_obj(ast->eval(interp.get_global_env(), interp));
   });
 
@@ -51,6 +67,14 @@ BuiltinInstaller::install_misc_functions() {
     return as_obj(apply(args[0], std::move(apply_args), interp));
   });
 
+  // the global environment and top-level macros, for ./scheme --image
+  install("save-image", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    assert_obj_type<String*>(args[0], "string");
+    save_image(as_string(args[0])->data, interp);
+    return Void {};
+  });
+
 }
 
 };
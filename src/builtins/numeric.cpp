@@ -1,5 +1,6 @@
 #include <builtins/common.hpp>
 #include <builtins/installer.hpp>
+#include <interpreter/interpreter.hpp>
 #include <cmath>
 
 namespace Scheme {
@@ -25,7 +26,7 @@ BuiltinInstaller::install_numeric_functions() {
       ret += as_number(arg);
     }
     return ret;
-  });
+  }, Primitive::ADD);
   install("-", [](const ArgList& args, Interpreter& interp) {
     assert_numbers(args, 1, MAX_ARGS);
     if (args.size() == 1) {
@@ -38,7 +39,7 @@ BuiltinInstaller::install_numeric_functions() {
       }
       return ret;
     }
-  });
+  }, Primitive::SUB);
   install("*", [](const ArgList& args, Interpreter& interp) {
     assert_numbers(args, 0, MAX_ARGS);
     double ret = 1.0;
@@ -46,7 +47,7 @@ BuiltinInstaller::install_numeric_functions() {
       ret *= as_number(arg);
     }
     return ret;
-  });
+  }, Primitive::MUL);
   install("/", [](const ArgList& args, Interpreter& interp) {
     assert_numbers(args, 1, MAX_ARGS);
     if (args.size() == 1) {
@@ -59,22 +60,22 @@ BuiltinInstaller::install_numeric_functions() {
       }
       return ret;
     }
-  });
+  }, Primitive::DIV);
   install("<", [](const ArgList& args, Interpreter& interp) {
     return check_comp(args, std::less<double>());
-  });
+  }, Primitive::LT);
   install(">", [](const ArgList& args, Interpreter& interp) {
     return check_comp(args, std::greater<double>());
-  });
+  }, Primitive::GT);
   install("=", [](const ArgList& args, Interpreter& interp) {
     return check_comp(args, std::equal_to<double>());
-  });
+  }, Primitive::NUM_EQ);
   install("<=", [](const ArgList& args, Interpreter& interp) {
     return check_comp(args, std::less_equal<double>());
-  });
+  }, Primitive::LE);
   install(">=", [](const ArgList& args, Interpreter& interp) {
     return check_comp(args, std::greater_equal<double>());
-  });
+  }, Primitive::GE);
   install("abs", [](const ArgList& args, Interpreter& interp) {
     return std::abs(get_single_number(args));
   });
@@ -134,6 +135,20 @@ BuiltinInstaller::install_numeric_functions() {
     assert_numbers(args, 2, 2);
     return fmod(as_number(args[0]), as_number(args[1]));
   });
+  // quotient and remainder together, as two values
+  install("truncate/", [](const ArgList& args, Interpreter& interp) {
+    assert_numbers(args, 2, 2);
+    const auto n = as_number(args[0]);
+    const auto d = as_number(args[1]);
+    return interp.return_values({std::trunc(n / d), fmod(n, d)});
+  });
+  install("floor/", [](const ArgList& args, Interpreter& interp) {
+    assert_numbers(args, 2, 2);
+    const auto n = as_number(args[0]);
+    const auto d = as_number(args[1]);
+    const auto q = std::floor(n / d);
+    return interp.return_values({q, n - d * q});
+  });
 }
 
 }
@@ -0,0 +1,263 @@
+#include <builtins/common.hpp>
+#include <builtins/installer.hpp>
+#include <interpreter/evaluation.hpp>
+#include <interpreter/persistent_map.hpp>
+
+namespace Scheme {
+
+static PersistentMap*
+get_map(const Obj& obj) {
+  assert_obj_type<PersistentMap*>(obj, "persistent map");
+  const auto m = as_pmap(obj);
+  if (m->is_set) {
+    throw std::runtime_error("incorrect type for " + stringify(obj) + ", expected persistent map");
+  }
+  return m;
+}
+
+static PersistentMap*
+get_set(const Obj& obj) {
+  assert_obj_type<PersistentMap*>(obj, "persistent set");
+  const auto m = as_pmap(obj);
+  if (!m->is_set) {
+    throw std::runtime_error("incorrect type for " + stringify(obj) + ", expected persistent set");
+  }
+  return m;
+}
+
+static PersistentMap*
+get_transient(const Obj& obj) {
+  assert_obj_type<PersistentMap*>(obj, "transient map");
+  const auto m = as_pmap(obj);
+  if (!m->transient) {
+    throw std::runtime_error("incorrect type for " + stringify(obj) + ", expected transient map");
+  }
+  return m;
+}
+
+// bulk construction goes through a transient so that each node is copied at
+// most once
+static PersistentMap*
+build(const ArgList& args, const size_t from, const bool is_set, Interpreter& interp) {
+  const auto empty = interp.spawn<PersistentMap>(nullptr, 0, is_set);
+  const auto t = empty->make_transient(interp);
+  for (size_t i = from; i < args.size(); i += is_set ? 1 : 2) {
+    t->assoc_in_place(args[i], is_set ? Obj(true) : args[i + 1], interp);
+  }
+  return t->make_persistent(interp);
+}
+
+static Obj
+fold(PersistentMap *m, const Obj& kons, Obj acc, Interpreter& interp) {
+  assert_callable(kons);
+  // the entries are gathered into an argument buffer first, which a
+  // continuation captured in kons can hold on to
+  ArgList entries {};
+  for (const auto e : m->leaves()) {
+    entries.push_back(e->key);
+    if (!m->is_set) {
+      entries.push_back(e->value);
+    }
+  }
+  const size_t width = m->is_set ? 1 : 2;
+  for (size_t i = 0; i < entries.size(); i += width) {
+    if (m->is_set) {
+      acc = call(kons, {entries[i], acc}, interp);
+    }
+    else {
+      acc = call(kons, {entries[i], entries[i + 1], acc}, interp);
+    }
+  }
+  return acc;
+}
+
+void
+BuiltinInstaller::install_persistent_map_functions() {
+  install("pmap", [](const ArgList& args, Interpreter& interp) {
+    if (args.size() % 2 != 0) {
+      throw std::runtime_error("pmap: expected alternating keys and values");
+    }
+    return build(args, 0, false, interp);
+  });
+
+  install("pmap-count", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    assert_obj_type<PersistentMap*>(args[0], "persistent map");
+    return (double) as_pmap(args[0])->count;
+  });
+
+  install("pmap-ref", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 3);
+    if (const auto found = get_map(args[0])->find(args[1])) {
+      return *found;
+    }
+    else if (args.size() == 3) {
+      return args[2];
+    }
+    else {
+      throw std::runtime_error("pmap-ref: no value for key " + stringify(args[1]));
+    }
+  });
+
+  install("pmap-contains?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    return get_map(args[0])->find(args[1]) != nullptr;
+  });
+
+  install("pmap-assoc", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, MAX_ARGS);
+    if (args.size() % 2 != 1) {
+      throw std::runtime_error("pmap-assoc: expected alternating keys and values");
+    }
+    auto m = get_map(args[0]);
+    if (args.size() == 3) {
+      return m->assoc(args[1], args[2], interp);
+    }
+    const auto t = m->make_transient(interp);
+    for (size_t i = 1; i < args.size(); i += 2) {
+      t->assoc_in_place(args[i], args[i + 1], interp);
+    }
+    return t->make_persistent(interp);
+  });
+
+  install("pmap-dissoc", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, MAX_ARGS);
+    auto m = get_map(args[0]);
+    for (size_t i = 1; i < args.size(); i++) {
+      m = m->dissoc(args[i], interp);
+    }
+    return m;
+  });
+
+  // (pmap-fold m kons knil) calls (kons key value acc), in no particular order
+  install("pmap-fold", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    return fold(get_map(args[0]), args[1], args[2], interp);
+  });
+
+  install("pmap-keys", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    Obj ret = Null {};
+    for (const auto e : get_map(args[0])->leaves()) {
+      ret = interp.spawn<Cons>(e->key, ret);
+    }
+    return ret;
+  });
+
+  install("pmap-values", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    Obj ret = Null {};
+    for (const auto e : get_map(args[0])->leaves()) {
+      ret = interp.spawn<Cons>(e->value, ret);
+    }
+    return ret;
+  });
+
+  install("pmap->alist", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    Obj ret = Null {};
+    for (const auto e : get_map(args[0])->leaves()) {
+      ret = interp.spawn<Cons>(interp.spawn<Cons>(e->key, e->value), ret);
+    }
+    return ret;
+  });
+
+  install("alist->pmap", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    assert_list(args[0]);
+    const auto t = interp.spawn<PersistentMap>(nullptr, 0, false)->make_transient(interp);
+    // earlier associations take precedence, as with assoc
+    for (Obj ls = args[0]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      const auto entry = as_pair(ls)->car;
+      assert_obj_type<Cons*>(entry, "pair");
+      if (!t->find(as_pair(entry)->car)) {
+        t->assoc_in_place(as_pair(entry)->car, as_pair(entry)->cdr, interp);
+      }
+    }
+    return t->make_persistent(interp);
+  });
+
+  install("pset", [](const ArgList& args, Interpreter& interp) {
+    return build(args, 0, true, interp);
+  });
+
+  install("pset-count", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return (double) get_set(args[0])->count;
+  });
+
+  install("pset-contains?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    return get_set(args[0])->find(args[1]) != nullptr;
+  });
+
+  install("pset-adjoin", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, MAX_ARGS);
+    auto s = get_set(args[0]);
+    for (size_t i = 1; i < args.size(); i++) {
+      s = s->assoc(args[i], true, interp);
+    }
+    return s;
+  });
+
+  install("pset-delete", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, MAX_ARGS);
+    auto s = get_set(args[0]);
+    for (size_t i = 1; i < args.size(); i++) {
+      s = s->dissoc(args[i], interp);
+    }
+    return s;
+  });
+
+  // (pset-fold s kons knil) calls (kons element acc)
+  install("pset-fold", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    return fold(get_set(args[0]), args[1], args[2], interp);
+  });
+
+  install("pset->list", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    Obj ret = Null {};
+    for (const auto e : get_set(args[0])->leaves()) {
+      ret = interp.spawn<Cons>(e->key, ret);
+    }
+    return ret;
+  });
+
+  // transients work for both maps and sets. the persistent original is left
+  // untouched, and the transient may not be used once made persistent.
+  install("pmap-transient", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    assert_obj_type<PersistentMap*>(args[0], "persistent map");
+    const auto m = as_pmap(args[0]);
+    if (m->transient) {
+      throw std::runtime_error("pmap-transient: map is already transient");
+    }
+    return m->make_transient(interp);
+  });
+
+  install("pmap-assoc!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    get_transient(args[0])->assoc_in_place(args[1], args[2], interp);
+    return Void {};
+  });
+
+  install("pmap-dissoc!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    get_transient(args[0])->dissoc_in_place(args[1], interp);
+    return Void {};
+  });
+
+  install("pset-adjoin!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    get_transient(args[0])->assoc_in_place(args[1], true, interp);
+    return Void {};
+  });
+
+  install("pmap-persistent!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return get_transient(args[0])->make_persistent(interp);
+  });
+}
+
+}
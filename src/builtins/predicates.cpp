@@ -1,5 +1,6 @@
 #include <builtins/common.hpp>
 #include <builtins/installer.hpp>
+#include <interpreter/persistent_map.hpp>
 
 namespace Scheme {
 
@@ -47,7 +48,7 @@ BuiltinInstaller::install_predicates() {
 
   install("procedure?", [](const ArgList& args, Interpreter& interp) {
     assert_arg_count(args, 1, 1);
-    return is_procedure(args[0]) || is_builtin(args[0]);
+    return is_callable(args[0]);
   });
 
   install("list?", [](const ArgList& args, Interpreter& interp) {
@@ -58,17 +59,37 @@ BuiltinInstaller::install_predicates() {
   install("eq?", [](const ArgList& args, Interpreter& interp) {
     assert_arg_count(args, 2, 2);
     return args[0] == args[1];
-  });
+  }, Primitive::EQ);
+
+  install("eqv?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    return args[0] == args[1];
+  }, Primitive::EQV);
 
   install("equal?", [](const ArgList& args, Interpreter& interp) {
     assert_arg_count(args, 2, 2);
     return equal(args[0], args[1]);
-  });
+  }, Primitive::EQUAL);
 
   install("string=?", [](const ArgList& args, Interpreter& interp) { 
     assert_arg_count(args, 2, 2);
     assert_vec_type<String*>(args, "string");
     return as_string(args[0])->data == as_string(args[1])->data;
+  }, Primitive::STRING_EQ);
+
+  install("hash-table?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return is_hash_table(args[0]);
+  });
+
+  install("pmap?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return is_pmap(args[0]) && !as_pmap(args[0])->is_set;
+  });
+
+  install("pset?", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return is_pmap(args[0]) && as_pmap(args[0])->is_set;
   });
 }
 
@@ -0,0 +1,591 @@
+#include <builtins/common.hpp>
+#include <builtins/installer.hpp>
+#include <interpreter/evaluation.hpp>
+#include <algorithm>
+#include <bit>
+#include <iterator>
+#include <thread>
+#include <vector>
+
+namespace Scheme {
+
+// every loop below checks its bounds, so a comparator that is not a strict
+// weak ordering gives a scrambled result but never runs off the array
+
+static constexpr ptrdiff_t INSERTION_THRESHOLD = 24;
+static constexpr ptrdiff_t NINTHER_THRESHOLD = 128;
+static constexpr ptrdiff_t PARTIAL_INSERTION_LIMIT = 8;
+static constexpr ptrdiff_t MERGE_RUN = 16;
+
+template<class T, class Less>
+static void
+insertion_sort(T *begin, T *end, Less& less) {
+  for (T *cur = begin + (begin != end); cur < end; cur++) {
+    if (less(*cur, *(cur - 1))) {
+      T tmp = std::move(*cur);
+      T *sift = cur;
+      do {
+        *sift = std::move(*(sift - 1));
+        sift--;
+      } while (sift != begin && less(tmp, *(sift - 1)));
+      *sift = std::move(tmp);
+    }
+  }
+}
+
+// like insertion_sort, but gives up once it has moved too many elements
+template<class T, class Less>
+static bool
+partial_insertion_sort(T *begin, T *end, Less& less) {
+  ptrdiff_t moved = 0;
+  for (T *cur = begin + (begin != end); cur < end; cur++) {
+    if (moved > PARTIAL_INSERTION_LIMIT) {
+      return false;
+    }
+    if (less(*cur, *(cur - 1))) {
+      T tmp = std::move(*cur);
+      T *sift = cur;
+      do {
+        *sift = std::move(*(sift - 1));
+        sift--;
+      } while (sift != begin && less(tmp, *(sift - 1)));
+      *sift = std::move(tmp);
+      moved += cur - sift;
+    }
+  }
+  return true;
+}
+
+template<class T, class Less>
+static void
+sort2(T *a, T *b, Less& less) {
+  if (less(*b, *a)) {
+    std::iter_swap(a, b);
+  }
+}
+
+template<class T, class Less>
+static void
+sort3(T *a, T *b, T *c, Less& less) {
+  sort2(a, b, less);
+  sort2(b, c, less);
+  sort2(a, b, less);
+}
+
+// partitions around the pivot at *begin into [< pivot] pivot [>= pivot].
+// also reports whether the range was already partitioned.
+template<class T, class Less>
+static std::pair<T*, bool>
+partition_right(T *begin, T *end, Less& less) {
+  T pivot = std::move(*begin);
+  T *first = begin + 1;
+  T *last = end - 1;
+  while (first <= last && less(*first, pivot)) {
+    first++;
+  }
+  while (first <= last && !less(*last, pivot)) {
+    last--;
+  }
+  const bool already_partitioned = first > last;
+  while (first < last) {
+    std::iter_swap(first++, last--);
+    while (first <= last && less(*first, pivot)) {
+      first++;
+    }
+    while (first <= last && !less(*last, pivot)) {
+      last--;
+    }
+  }
+  T *pivot_pos = first - 1;
+  *begin = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+  return {pivot_pos, already_partitioned};
+}
+
+// partitions into [<= pivot] pivot [> pivot]. used when the pivot equals the
+// element before the range, so everything equal to it is already in place.
+template<class T, class Less>
+static T*
+partition_left(T *begin, T *end, Less& less) {
+  T pivot = std::move(*begin);
+  T *first = begin + 1;
+  T *last = end - 1;
+  while (first <= last && !less(pivot, *first)) {
+    first++;
+  }
+  while (first <= last && less(pivot, *last)) {
+    last--;
+  }
+  while (first < last) {
+    std::iter_swap(first++, last--);
+    while (first <= last && !less(pivot, *first)) {
+      first++;
+    }
+    while (first <= last && less(pivot, *last)) {
+      last--;
+    }
+  }
+  T *pivot_pos = first - 1;
+  *begin = std::move(*pivot_pos);
+  *pivot_pos = std::move(pivot);
+  return pivot_pos;
+}
+
+// pattern-defeating quicksort: median-of-3 (ninther for large ranges)
+// pivots, a cheap exit for ranges that turn out sorted, shuffling to break
+// up patterns that give unbalanced partitions, and heapsort once too many
+// partitions have been bad
+template<class T, class Less>
+static void
+pdqsort_loop(T *begin, T *end, Less& less, int bad_allowed, bool leftmost) {
+  while (true) {
+    const auto size = end - begin;
+    if (size < INSERTION_THRESHOLD) {
+      insertion_sort(begin, end, less);
+      return;
+    }
+
+    const auto half = size / 2;
+    if (size > NINTHER_THRESHOLD) {
+      sort3(begin, begin + half, end - 1, less);
+      sort3(begin + 1, begin + (half - 1), end - 2, less);
+      sort3(begin + 2, begin + (half + 1), end - 3, less);
+      sort3(begin + (half - 1), begin + half, begin + (half + 1), less);
+      std::iter_swap(begin, begin + half);
+    }
+    else {
+      sort3(begin + half, begin, end - 1, less);
+    }
+
+    if (!leftmost && !less(*(begin - 1), *begin)) {
+      begin = partition_left(begin, end, less) + 1;
+      continue;
+    }
+
+    const auto [pivot_pos, already_partitioned] = partition_right(begin, end, less);
+    const auto l_size = pivot_pos - begin;
+    const auto r_size = end - (pivot_pos + 1);
+
+    if (l_size < size / 8 || r_size < size / 8) {
+      if (--bad_allowed == 0) {
+        std::make_heap(begin, end, less);
+        std::sort_heap(begin, end, less);
+        return;
+      }
+      if (l_size >= INSERTION_THRESHOLD) {
+        std::iter_swap(begin, begin + l_size / 4);
+        std::iter_swap(pivot_pos - 1, pivot_pos - l_size / 4);
+        if (l_size > NINTHER_THRESHOLD) {
+          std::iter_swap(begin + 1, begin + (l_size / 4 + 1));
+          std::iter_swap(begin + 2, begin + (l_size / 4 + 2));
+          std::iter_swap(pivot_pos - 2, pivot_pos - (l_size / 4 + 1));
+          std::iter_swap(pivot_pos - 3, pivot_pos - (l_size / 4 + 2));
+        }
+      }
+      if (r_size >= INSERTION_THRESHOLD) {
+        std::iter_swap(pivot_pos + 1, pivot_pos + (1 + r_size / 4));
+        std::iter_swap(end - 1, end - r_size / 4);
+        if (r_size > NINTHER_THRESHOLD) {
+          std::iter_swap(pivot_pos + 2, pivot_pos + (2 + r_size / 4));
+          std::iter_swap(pivot_pos + 3, pivot_pos + (3 + r_size / 4));
+          std::iter_swap(end - 2, end - (1 + r_size / 4));
+          std::iter_swap(end - 3, end - (2 + r_size / 4));
+        }
+      }
+    }
+    else if (already_partitioned
+        && partial_insertion_sort(begin, pivot_pos, less)
+        && partial_insertion_sort(pivot_pos + 1, end, less)) {
+      return;
+    }
+
+    pdqsort_loop(begin, pivot_pos, less, bad_allowed, leftmost);
+    begin = pivot_pos + 1;
+    leftmost = false;
+  }
+}
+
+template<class T, class Less>
+static void
+pdqsort(T *begin, T *end, Less& less) {
+  if (end - begin > 1) {
+    pdqsort_loop(begin, end, less, std::bit_width(static_cast<size_t>(end - begin)), true);
+  }
+}
+
+// stable merge of [begin, mid) and [mid, end) into out; ties go left
+template<class T, class Less>
+static void
+merge_into(T *begin, T *mid, T *end, T *out, Less& less) {
+  T *left = begin;
+  T *right = mid;
+  while (left < mid && right < end) {
+    if (less(*right, *left)) {
+      *out++ = std::move(*right++);
+    }
+    else {
+      *out++ = std::move(*left++);
+    }
+  }
+  out = std::move(left, mid, out);
+  std::move(right, end, out);
+}
+
+// stable top-down merge sort; buffer must hold at least end - begin elements
+template<class T, class Less>
+static void
+merge_sort(T *begin, T *end, T *buffer, Less& less) {
+  if (end - begin <= MERGE_RUN) {
+    insertion_sort(begin, end, less);
+    return;
+  }
+  T *mid = begin + (end - begin) / 2;
+  merge_sort(begin, mid, buffer, less);
+  merge_sort(mid, end, buffer, less);
+  if (!less(*mid, *(mid - 1))) {
+    return;
+  }
+  merge_into(begin, mid, end, buffer, less);
+  std::move(buffer, buffer + (end - begin), begin);
+}
+
+template<class Container, class Less>
+static void
+sort_range(Container& data, const bool stable, Less& less) {
+  if (stable) {
+    Container buffer(data.size());
+    merge_sort(data.data(), data.data() + data.size(), buffer.data(), less);
+  }
+  else {
+    pdqsort(data.data(), data.data() + data.size(), less);
+  }
+}
+
+// threads used for large native sorts; 1 keeps sorting on the calling thread
+static unsigned sort_threads = 1;
+static constexpr size_t PARALLEL_THRESHOLD = 1 << 16;
+
+// sorts contiguous chunks on their own threads, then merges neighbouring
+// runs pairwise, again one thread per merge. only for comparators that do
+// not call back into the interpreter.
+template<class Container, class Less>
+static void
+parallel_sort(Container& data, const bool stable, Less less) {
+  using T = typename Container::value_type;
+  const size_t chunks = std::min<size_t>(sort_threads, data.size() / (PARALLEL_THRESHOLD / 4));
+  if (chunks < 2) {
+    sort_range(data, stable, less);
+    return;
+  }
+
+  std::vector<size_t> bounds {};
+  for (size_t i = 0; i <= chunks; i++) {
+    bounds.push_back(data.size() * i / chunks);
+  }
+
+  T *const base = data.data();
+  std::vector<std::thread> workers {};
+  for (size_t i = 0; i < chunks; i++) {
+    workers.emplace_back([=, &less]() {
+      if (stable) {
+        std::vector<T> buffer(bounds[i + 1] - bounds[i]);
+        merge_sort(base + bounds[i], base + bounds[i + 1], buffer.data(), less);
+      }
+      else {
+        pdqsort(base + bounds[i], base + bounds[i + 1], less);
+      }
+    });
+  }
+  for (auto& worker : workers) {
+    worker.join();
+  }
+
+  std::vector<T> buffer(data.size());
+  T *from = base;
+  T *to = buffer.data();
+  while (bounds.size() > 2) {
+    workers.clear();
+    std::vector<size_t> merged {0};
+    for (size_t i = 0; i + 1 < bounds.size(); i += 2) {
+      if (i + 2 < bounds.size()) {
+        workers.emplace_back([=, &less]() {
+          merge_into(from + bounds[i], from + bounds[i + 1], from + bounds[i + 2], to + bounds[i], less);
+        });
+        merged.push_back(bounds[i + 2]);
+      }
+      else {
+        std::move(from + bounds[i], from + bounds[i + 1], to + bounds[i]);
+        merged.push_back(bounds[i + 1]);
+      }
+    }
+    for (auto& worker : workers) {
+      worker.join();
+    }
+    bounds = std::move(merged);
+    std::swap(from, to);
+  }
+  if (from != base) {
+    std::move(from, from + data.size(), base);
+  }
+}
+
+template<class Container, class Less>
+static void
+native_sort(Container& data, const bool stable, Less less) {
+  if (sort_threads > 1 && data.size() >= PARALLEL_THRESHOLD) {
+    parallel_sort(data, stable, less);
+  }
+  else {
+    sort_range(data, stable, less);
+  }
+}
+
+// sorts data with the Scheme comparator proc. numbers under < and strings
+// under string<? are compared natively; anything else calls proc, directly
+// for builtins so that no argument list is built per comparison. the sort
+// runs on a copy so a comparator that raises leaves data untouched.
+static void
+sort_objects(ArgList& data, const Obj& proc, const bool stable, Interpreter& interp) {
+  assert_callable(proc);
+  const auto prim = is_builtin(proc) ? as_builtin(proc)->prim : Primitive::NONE;
+
+  if (prim == Primitive::LT && std::all_of(data.begin(), data.end(), is_number)) {
+    std::vector<double> numbers(data.size());
+    std::transform(data.begin(), data.end(), numbers.begin(), [](const Obj& x) {return as_number(x);});
+    native_sort(numbers, stable, [](double a, double b) {return a < b;});
+    std::copy(numbers.begin(), numbers.end(), data.begin());
+    return;
+  }
+
+  if (prim == Primitive::STRING_LT && std::all_of(data.begin(), data.end(), is_string)) {
+    native_sort(data, stable, [](const Obj& a, const Obj& b) {
+      return as_string(a)->data < as_string(b)->data;
+    });
+    return;
+  }
+
+  ArgList work = data;
+  if (is_builtin(proc)) {
+    const auto& builtin = *as_builtin(proc);
+    ArgList args(2);
+    auto less = [&](const Obj& a, const Obj& b) {
+      args.assign({a, b});
+      return is_true(builtin(args, interp));
+    };
+    sort_range(work, stable, less);
+  }
+  else {
+    auto less = [&](const Obj& a, const Obj& b) {
+      return is_true(call(proc, {a, b}, interp));
+    };
+    sort_range(work, stable, less);
+  }
+  data = std::move(work);
+}
+
+static ArgList
+list_to_vector(const Obj& ls) {
+  assert_list(ls);
+  ArgList ret {};
+  for (Obj curr = ls; is_pair(curr); curr = as_pair(curr)->cdr) {
+    ret.push_back(as_pair(curr)->car);
+  }
+  return ret;
+}
+
+// merge sort on the cells themselves: cells are relinked, never allocated,
+// and the sort is stable. bins[i] holds a sorted run of 2^i cells, as in a
+// binary counter.
+template<class Less>
+static Obj
+merge_lists(Obj a, Obj b, Less& less) {
+  Obj head = Null {};
+  Cons *tail = nullptr;
+  while (is_pair(a) && is_pair(b)) {
+    Obj *from = less(as_pair(b)->car, as_pair(a)->car) ? &b : &a;
+    const auto cell = as_pair(*from);
+    *from = cell->cdr;
+    if (tail) {
+      tail->cdr = cell;
+    }
+    else {
+      head = cell;
+    }
+    tail = cell;
+  }
+  const Obj rest = is_pair(a) ? a : b;
+  if (tail) {
+    tail->cdr = rest;
+    return head;
+  }
+  return rest;
+}
+
+static Obj
+sort_list_in_place(Obj ls, const Obj& proc, Interpreter& interp) {
+  assert_list(ls);
+  assert_callable(proc);
+  const auto prim = is_builtin(proc) ? as_builtin(proc)->prim : Primitive::NONE;
+
+  // the native fast paths want contiguous data, so sort a vector of the
+  // elements and write them back into the cells
+  if (prim == Primitive::LT || prim == Primitive::STRING_LT) {
+    auto data = list_to_vector(ls);
+    const auto native = prim == Primitive::LT ? is_number : is_string;
+    if (std::all_of(data.begin(), data.end(), native)) {
+      sort_objects(data, proc, true, interp);
+      Obj curr = ls;
+      for (auto& x : data) {
+        as_pair(curr)->car = std::move(x);
+        curr = as_pair(curr)->cdr;
+      }
+      return ls;
+    }
+  }
+
+  auto less = [&](const Obj& a, const Obj& b) {
+    return is_true(call(proc, {a, b}, interp));
+  };
+  Obj bins[64];
+  std::fill(std::begin(bins), std::end(bins), Null {});
+  size_t filled = 0;
+  while (is_pair(ls)) {
+    Obj carry = ls;
+    ls = as_pair(ls)->cdr;
+    as_pair(carry)->cdr = Null {};
+    size_t i = 0;
+    while (i < filled && is_pair(bins[i])) {
+      carry = merge_lists(bins[i], carry, less);
+      bins[i] = Null {};
+      i++;
+    }
+    bins[i] = carry;
+    filled = std::max(filled, i + 1);
+  }
+  Obj ret = Null {};
+  for (size_t i = 0; i < filled; i++) {
+    ret = merge_lists(bins[i], ret, less);
+  }
+  return ret;
+}
+
+static Obj
+copy_list(const Obj& ls, Interpreter& interp) {
+  assert_list(ls);
+  const auto data = list_to_vector(ls);
+  Obj ret = Null {};
+  for (auto x = data.rbegin(); x != data.rend(); x++) {
+    ret = interp.spawn<Cons>(*x, ret);
+  }
+  return ret;
+}
+
+// (sort seq less?) and (sort less? seq) are both accepted
+static std::pair<Obj, Obj>
+sequence_and_comparator(const ArgList& args) {
+  assert_arg_count(args, 2, 2);
+  if (is_callable(args[0]) && !is_callable(args[1])) {
+    return {args[1], args[0]};
+  }
+  return {args[0], args[1]};
+}
+
+static Vector*
+get_vector(const Obj& obj) {
+  assert_obj_type<Vector*>(obj, "vector");
+  return as_vector(obj);
+}
+
+void
+BuiltinInstaller::install_sort_functions() {
+  // sort and sort! are stable for both lists and vectors
+  install("sort", [](const ArgList& args, Interpreter& interp) -> Obj {
+    const auto [seq, proc] = sequence_and_comparator(args);
+    if (is_vector(seq)) {
+      auto data = as_vector(seq)->data;
+      sort_objects(data, proc, true, interp);
+      return interp.spawn<Vector>(std::move(data));
+    }
+    return sort_list_in_place(copy_list(seq, interp), proc, interp);
+  });
+
+  // a list is sorted as a vector of its elements, which go back into its
+  // cells only once the sort has finished, so a comparator that raises
+  // leaves the list as it was
+  install("sort!", [](const ArgList& args, Interpreter& interp) -> Obj {
+    const auto [seq, proc] = sequence_and_comparator(args);
+    if (is_vector(seq)) {
+      sort_objects(as_vector(seq)->data, proc, true, interp);
+      return seq;
+    }
+    auto data = list_to_vector(seq);
+    sort_objects(data, proc, true, interp);
+    Obj curr = seq;
+    for (size_t i = 0; i < data.size() && is_pair(curr); i++) {
+      as_pair(curr)->car = std::move(data[i]);
+      curr = as_pair(curr)->cdr;
+    }
+    return seq;
+  });
+
+  // SRFI-132: (list-sort < lis)
+  install("list-sort", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    return sort_list_in_place(copy_list(args[1], interp), args[0], interp);
+  });
+
+  install("merge", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    assert_callable(args[2]);
+    auto less = [&](const Obj& a, const Obj& b) {
+      return is_true(call(args[2], {a, b}, interp));
+    };
+    return merge_lists(copy_list(args[0], interp), copy_list(args[1], interp), less);
+  });
+
+  // SRFI-132: (vector-sort < v [start [end]]) copies the range, while
+  // (vector-sort! v < [start [end]]) sorts it in place with pdqsort, which
+  // is not stable
+  install("vector-sort", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 4);
+    const auto& data = get_vector(args[1])->data;
+    const auto [start, end] = get_range(args, 2, data.size());
+    ArgList ret(data.begin() + start, data.begin() + end);
+    sort_objects(ret, args[0], false, interp);
+    return interp.spawn<Vector>(std::move(ret));
+  });
+
+  install("vector-sort!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 4);
+    auto& data = get_vector(args[0])->data;
+    const auto [start, end] = get_range(args, 2, data.size());
+    ArgList range(data.begin() + start, data.begin() + end);
+    sort_objects(range, args[1], false, interp);
+    std::move(range.begin(), range.end(), data.begin() + start);
+    return Void {};
+  });
+
+  install("vector-stable-sort!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 4);
+    auto& data = get_vector(args[0])->data;
+    const auto [start, end] = get_range(args, 2, data.size());
+    ArgList range(data.begin() + start, data.begin() + end);
+    sort_objects(range, args[1], true, interp);
+    std::move(range.begin(), range.end(), data.begin() + start);
+    return Void {};
+  });
+
+  // opt-in parallelism for large sorts of numbers under < or strings under
+  // string<?. 0 means one thread per core. returns the previous setting.
+  install("sort-threads", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 0, 1);
+    const auto previous = (double) sort_threads;
+    if (args.size() == 1) {
+      const auto n = get_index(args[0], 1024);
+      sort_threads = n == 0 ? std::max(1u, std::thread::hardware_concurrency()) : n;
+    }
+    return previous;
+  });
+}
+
+}
@@ -0,0 +1,280 @@
+#include <builtins/common.hpp>
+#include <builtins/installer.hpp>
+#include <interpreter/evaluation.hpp>
+#include <string>
+#include <string_view>
+
+namespace Scheme {
+
+static std::string&
+get_string(const Obj& obj) {
+  assert_obj_type<String*>(obj, "string");
+  return as_string(obj)->data;
+}
+
+static StringPort*
+get_port(const Obj& obj) {
+  assert_obj_type<StringPort*>(obj, "string port");
+  return as_string_port(obj);
+}
+
+template<class Comp>
+static bool
+compare_strings(const ArgList& args, Comp comp) {
+  assert_arg_count(args, 1, MAX_ARGS);
+  assert_vec_type<String*>(args, "string");
+  for (size_t i = 1; i < args.size(); i++) {
+    if (!comp(as_string(args[i - 1])->data, as_string(args[i])->data)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void
+BuiltinInstaller::install_string_functions() {
+  install("string-length", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return (double) get_string(args[0]).size();
+  });
+
+  install("string-ref", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    const auto& str = get_string(args[0]);
+    const auto i = get_index(args[1], str.size());
+    if (i == str.size()) {
+      throw std::runtime_error("string index out of range");
+    }
+    return str[i];
+  });
+
+  install("string-set!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 3);
+    auto& str = get_string(args[0]);
+    const auto i = get_index(args[1], str.size());
+    if (i == str.size()) {
+      throw std::runtime_error("string index out of range");
+    }
+    assert_obj_type<char>(args[2], "character");
+    str[i] = as_char(args[2]);
+    return Void {};
+  });
+
+  install("make-string", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 2);
+    const auto size = get_index(args[0], SIZE_MAX);
+    char fill = ' ';
+    if (args.size() == 2) {
+      assert_obj_type<char>(args[1], "character");
+      fill = as_char(args[1]);
+    }
+    return interp.spawn<String>(std::string(size, fill));
+  });
+
+  install("string", [](const ArgList& args, Interpreter& interp) {
+    assert_vec_type<char>(args, "character");
+    std::string ret(args.size(), ' ');
+    for (size_t i = 0; i < args.size(); i++) {
+      ret[i] = as_char(args[i]);
+    }
+    return interp.spawn<String>(std::move(ret));
+  });
+
+  install("substring", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 3);
+    const auto& str = get_string(args[0]);
+    const auto [start, end] = get_range(args, 1, str.size());
+    return interp.spawn<String>(str.substr(start, end - start));
+  });
+
+  install("string-copy", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 3);
+    const auto& str = get_string(args[0]);
+    const auto [start, end] = get_range(args, 1, str.size());
+    return interp.spawn<String>(str.substr(start, end - start));
+  });
+
+  install("string-copy!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 3, 5);
+    auto& to = get_string(args[0]);
+    const auto at = get_index(args[1], to.size());
+    const auto& from = get_string(args[2]);
+    const auto [start, end] = get_range(args, 3, from.size());
+    if (end - start > to.size() - at) {
+      throw std::runtime_error("string-copy!: destination too small");
+    }
+    // source and destination may be the same string
+    to.replace(at, end - start, std::string_view(from).substr(start, end - start));
+    return Void {};
+  });
+
+  install("string->list", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 3);
+    const auto& str = get_string(args[0]);
+    const auto [start, end] = get_range(args, 1, str.size());
+    Obj ret = Null {};
+    for (size_t i = end; i > start; i--) {
+      ret = interp.spawn<Cons>(str[i - 1], ret);
+    }
+    return ret;
+  });
+
+  install("list->string", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    assert_list(args[0]);
+    std::string ret {};
+    for (Obj ls = args[0]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      assert_obj_type<char>(as_pair(ls)->car, "character");
+      ret += as_char(as_pair(ls)->car);
+    }
+    return interp.spawn<String>(std::move(ret));
+  });
+
+  install("string-join", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 2);
+    assert_list(args[0]);
+    const std::string delimiter = args.size() == 2 ? get_string(args[1]) : " ";
+    size_t size = 0;
+    for (Obj ls = args[0]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      size += get_string(as_pair(ls)->car).size() + delimiter.size();
+    }
+    std::string ret {};
+    ret.reserve(size);
+    for (Obj ls = args[0]; is_pair(ls); ls = as_pair(ls)->cdr) {
+      if (ls != args[0]) {
+        ret += delimiter;
+      }
+      ret += as_string(as_pair(ls)->car)->data;
+    }
+    return interp.spawn<String>(std::move(ret));
+  });
+
+  // splits on every occurrence of a character or string delimiter, keeping
+  // empty fields
+  install("string-split", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    const std::string_view str = get_string(args[0]);
+    std::string delimiter {};
+    if (is_char(args[1])) {
+      delimiter = as_char(args[1]);
+    }
+    else {
+      delimiter = get_string(args[1]);
+    }
+    if (delimiter.empty()) {
+      throw std::runtime_error("string-split: empty delimiter");
+    }
+    std::vector<std::string_view> fields {};
+    size_t start = 0;
+    while (true) {
+      const auto found = str.find(delimiter, start);
+      fields.push_back(str.substr(start, found - start));
+      if (found == std::string_view::npos) {
+        break;
+      }
+      start = found + delimiter.size();
+    }
+    Obj ret = Null {};
+    for (auto field = fields.rbegin(); field != fields.rend(); field++) {
+      ret = interp.spawn<Cons>(interp.spawn<String>(std::string(*field)), ret);
+    }
+    return ret;
+  });
+
+  // index of the first character that is equal to a character argument or
+  // satisfies a predicate argument, or #f
+  install("string-index", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 2, 4);
+    const auto& str = get_string(args[0]);
+    const auto [start, end] = get_range(args, 2, str.size());
+    if (is_char(args[1])) {
+      const auto found = std::string_view(str).substr(0, end).find(as_char(args[1]), start);
+      return found == std::string_view::npos ? Obj(false) : Obj((double) found);
+    }
+    assert_callable(args[1]);
+    for (size_t i = start; i < end; i++) {
+      if (is_true(call(args[1], {str[i]}, interp))) {
+        return (double) i;
+      }
+    }
+    return false;
+  });
+
+  install("string-contains", [](const ArgList& args, Interpreter& interp) -> Obj {
+    assert_arg_count(args, 2, 2);
+    const auto found = get_string(args[0]).find(get_string(args[1]));
+    return found == std::string::npos ? Obj(false) : Obj((double) found);
+  });
+
+  install("string<?", [](const ArgList& args, Interpreter& interp) {
+    return compare_strings(args, std::less<std::string>());
+  }, Primitive::STRING_LT);
+
+  install("string>?", [](const ArgList& args, Interpreter& interp) {
+    return compare_strings(args, std::greater<std::string>());
+  });
+
+  install("string<=?", [](const ArgList& args, Interpreter& interp) {
+    return compare_strings(args, std::less_equal<std::string>());
+  });
+
+  install("string>=?", [](const ArgList& args, Interpreter& interp) {
+    return compare_strings(args, std::greater_equal<std::string>());
+  });
+
+  install("open-output-string", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 0, 0);
+    return interp.spawn<StringPort>();
+  });
+
+  install("get-output-string", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return interp.spawn<String>(get_port(args[0])->buffer);
+  });
+
+  install("write-string", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 4);
+    const auto& str = get_string(args[0]);
+    const auto [start, end] = get_range(args, 2, str.size());
+    get_port(args[1])->buffer.append(str, start, end - start);
+    return Void {};
+  });
+
+  install("write-char", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 2, 2);
+    assert_obj_type<char>(args[0], "character");
+    get_port(args[1])->buffer += as_char(args[0]);
+    return Void {};
+  });
+
+  install("make-string-builder", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 0, 0);
+    return interp.spawn<StringPort>();
+  });
+
+  install("string-builder-append!", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, MAX_ARGS);
+    auto& buffer = get_port(args[0])->buffer;
+    for (size_t i = 1; i < args.size(); i++) {
+      if (is_char(args[i])) {
+        buffer += as_char(args[i]);
+      }
+      else {
+        buffer += get_string(args[i]);
+      }
+    }
+    return Void {};
+  });
+
+  install("string-builder-length", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return (double) get_port(args[0])->buffer.size();
+  });
+
+  install("string-builder->string", [](const ArgList& args, Interpreter& interp) {
+    assert_arg_count(args, 1, 1);
+    return interp.spawn<String>(get_port(args[0])->buffer);
+  });
+}
+
+}
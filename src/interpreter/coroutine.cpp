@@ -0,0 +1,996 @@
+#include <interpreter/types.hpp>
+#include <interpreter/expressions.hpp>
+#include <interpreter/evaluation.hpp>
+#include <interpreter/interpreter.hpp>
+#include <interpreter/exceptions.hpp>
+#include <interpreter/parameters.hpp>
+#include <interpreter/coroutine.hpp>
+#include <sys/mman.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <format>
+#include <utility>
+#include <vector>
+
+namespace Scheme {
+
+// usable stack per coroutine, below a guard page. pages are only committed
+// as they are touched.
+static constexpr size_t COROUTINE_STACK_SIZE = size_t {1} << 20;
+static constexpr size_t SPARE_STACKS = 16;
+// how much of each stack is kept free for the native code that runs between
+// two stack checks: builtins, printing, the evaluation of arguments
+static constexpr size_t STACK_RED_ZONE = size_t {128} << 10;
+// how much of the stack clear_stack zeroes, well inside the red zone
+static constexpr size_t CLEARED_STACK = size_t {16} << 10;
+
+}
+
+#if defined(__x86_64__) && defined(__ELF__)
+
+// saves the callee-saved registers and the floating point control words on
+// the current stack, stores the stack pointer in *save_sp, and restores the
+// same from load_sp. returning then resumes whatever was switched out there.
+extern "C" void scheme_switch_context(void **save_sp, void *load_sp);
+
+// where a new stack first returns to: calls r13 with r12 as its argument
+extern "C" void scheme_fiber_start();
+
+asm(R"(
+  .text
+  .globl scheme_switch_context
+  .hidden scheme_switch_context
+  .type scheme_switch_context, @function
+scheme_switch_context:
+  pushq %rbp
+  pushq %rbx
+  pushq %r12
+  pushq %r13
+  pushq %r14
+  pushq %r15
+  subq $8, %rsp
+  stmxcsr (%rsp)
+  fnstcw 4(%rsp)
+  movq %rsp, (%rdi)
+  movq %rsi, %rsp
+  ldmxcsr (%rsp)
+  fldcw 4(%rsp)
+  addq $8, %rsp
+  popq %r15
+  popq %r14
+  popq %r13
+  popq %r12
+  popq %rbx
+  popq %rbp
+  ret
+  .size scheme_switch_context, .-scheme_switch_context
+
+  .globl scheme_fiber_start
+  .hidden scheme_fiber_start
+  .type scheme_fiber_start, @function
+scheme_fiber_start:
+  movq %r12, %rdi
+  callq *%r13
+  ud2
+  .size scheme_fiber_start, .-scheme_fiber_start
+)");
+
+namespace Scheme {
+
+struct Context {
+  void *sp = nullptr;
+};
+
+// lays out a frame for scheme_switch_context to pop: default control words,
+// the entry and its argument in r13 and r12, and scheme_fiber_start as the
+// return address, placed so that the entry is called on an aligned stack
+static void
+prepare_context(Context& ctx, char *stack_top, void (*entry)(void*), void *arg) {
+  const auto words = reinterpret_cast<uint64_t*>(stack_top - 80);
+  words[0] = (uint64_t {0x037f} << 32) | 0x1f80;
+  words[1] = 0;
+  words[2] = 0;
+  words[3] = reinterpret_cast<uint64_t>(entry);
+  words[4] = reinterpret_cast<uint64_t>(arg);
+  words[5] = 0;
+  words[6] = 0;
+  words[7] = reinterpret_cast<uint64_t>(&scheme_fiber_start);
+  words[8] = 0;
+  ctx.sp = words;
+}
+
+static void
+switch_context(Context& from, Context& to) {
+  scheme_switch_context(&from.sp, to.sp);
+}
+
+// a switched-out stack, from its saved pointer up to its top. the registers
+// were pushed there with the rest.
+static void
+scan_switched_out(const Context& ctx, const char *top, Interpreter& interp, std::vector<HeapEntity*>& roots) {
+  interp.alloc.scan(ctx.sp, top, roots);
+}
+
+// everything a switched-out context needs is on its stack, so a copy of the
+// stack put back at the same place can be switched to again
+static constexpr bool COPYABLE_STACKS = true;
+
+[[gnu::always_inline]] static inline char*
+stack_pointer() {
+  char *sp;
+  asm volatile ("movq %%rsp, %0" : "=r" (sp));
+  return sp;
+}
+
+}
+
+#else
+
+#include <ucontext.h>
+
+namespace Scheme {
+
+struct Context {
+  ucontext_t uc;
+  // about where the stack was left, for scans
+  void *sp;
+};
+
+// makecontext only passes ints, so the entry and its argument go through
+// here; the new context reads them as soon as it first runs
+static void (*pending_entry)(void*);
+static void *pending_arg;
+
+static void
+context_start() {
+  pending_entry(pending_arg);
+}
+
+static void
+prepare_context(Context& ctx, char *stack_top, void (*entry)(void*), void *arg) {
+  getcontext(&ctx.uc);
+  ctx.uc.uc_stack.ss_sp = stack_top - COROUTINE_STACK_SIZE;
+  ctx.uc.uc_stack.ss_size = COROUTINE_STACK_SIZE;
+  ctx.uc.uc_link = nullptr;
+  makecontext(&ctx.uc, context_start, 0);
+  pending_entry = entry;
+  pending_arg = arg;
+}
+
+static void
+switch_context(Context& from, Context& to) {
+  char probe;
+  from.sp = &probe;
+  swapcontext(&from.uc, &to.uc);
+}
+
+// the registers were saved in the context, off the stack
+static void
+scan_switched_out(const Context& ctx, const char *top, Interpreter& interp, std::vector<HeapEntity*>& roots) {
+  interp.alloc.scan(ctx.sp, top, roots);
+  interp.alloc.scan(&ctx.uc, &ctx.uc + 1, roots);
+}
+
+// the registers of a context are kept off its stack, so continuations stay
+// escape-only
+static constexpr bool COPYABLE_STACKS = false;
+
+static char*
+stack_pointer() {
+  return nullptr;
+}
+
+}
+
+#endif
+
+namespace Scheme {
+
+// stacks of finished coroutines, kept for the next ones
+static std::vector<char*> spare_stacks {};
+
+static size_t
+page_size() {
+  static const size_t size = sysconf(_SC_PAGESIZE);
+  return size;
+}
+
+static char*
+allocate_stack() {
+  if (!spare_stacks.empty()) {
+    const auto ret = spare_stacks.back();
+    spare_stacks.pop_back();
+    return ret;
+  }
+  const auto length = COROUTINE_STACK_SIZE + page_size();
+  const auto mem = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mem == MAP_FAILED) {
+    throw std::runtime_error("cannot allocate a coroutine stack");
+  }
+  mprotect(mem, page_size(), PROT_NONE);
+  return static_cast<char*>(mem);
+}
+
+static void
+release_stack(char *mem) {
+  if (spare_stacks.size() < SPARE_STACKS) {
+    spare_stacks.push_back(mem);
+  }
+  else {
+    munmap(mem, COROUTINE_STACK_SIZE + page_size());
+  }
+}
+
+struct Fiber {
+  char *const memory;
+  Interpreter& interp;
+  // the coroutine's registers while it is switched out, and its resumer's
+  // while it runs
+  Context context;
+  Context resumer;
+
+  Fiber(Coroutine *co, Interpreter& interp, void (*entry)(void*)):
+    memory {allocate_stack()},
+    interp {interp},
+    context {},
+    resumer {}
+  {
+    prepare_context(context, top(), entry, co);
+  }
+
+  char *top() const {
+    return memory + page_size() + COROUTINE_STACK_SIZE;
+  }
+
+  ~Fiber() {
+    release_stack(memory);
+  }
+};
+
+Coroutine::Coroutine(Obj thunk):
+  thunk {std::move(thunk)},
+  status {Status::READY},
+  transfer {Void {}},
+  fiber {},
+  resumer {nullptr},
+  handlers {nullptr},
+  parameterizations {nullptr},
+  winders {nullptr},
+  continuation_frames {nullptr},
+  error {},
+  abandoned {false},
+  stack_limit {nullptr},
+  segments {nullptr},
+  call_depth {0},
+  scanned {false}
+{}
+
+Coroutine::~Coroutine() = default;
+
+// nothing may unwind past here: there is no frame above it on this stack
+static void
+coroutine_main(void *arg) {
+  const auto co = static_cast<Coroutine*>(arg);
+  try {
+    co->transfer = as_obj(apply(co->thunk, {}, co->fiber->interp));
+  }
+  catch (...) {
+    co->error = std::current_exception();
+  }
+  co->status = Coroutine::Status::DONE;
+  switch_context(co->fiber->context, co->fiber->resumer);
+  std::abort();
+}
+
+// the parameterizations of a coroutine are switched out innermost first and
+// back in outermost first
+static void
+swap_out_parameterizations(ParameterSwap *swap) {
+  for (; swap; swap = swap->outer) {
+    swap->swap_out();
+  }
+}
+
+static void
+swap_in_parameterizations(ParameterSwap *swap) {
+  if (swap) {
+    swap_in_parameterizations(swap->outer);
+    swap->swap_in();
+  }
+}
+
+// the coroutine runs with its own handlers, parameterizations, dynamic-winds
+// and call/cc frames, over the parameter values its resumer sees. an error
+// it does not handle is raised again to the resumer's handlers.
+Obj
+resume(Coroutine *co, const ArgList& args, Interpreter& interp) {
+  if (args.size() > 1) {
+    throw std::runtime_error("wrong number of arguments: expected 0 or 1");
+  }
+  switch (co->status) {
+    case Coroutine::Status::DONE:
+      return interp.get_eof_object();
+    case Coroutine::Status::RUNNING:
+      throw std::runtime_error("generator resumed while it is running");
+    case Coroutine::Status::READY:
+      co->fiber = std::make_unique<Fiber>(co, interp, coroutine_main);
+      co->stack_limit = co->fiber->memory + page_size() + STACK_RED_ZONE;
+      interp.live_coroutines.insert(co);
+      break;
+    case Coroutine::Status::SUSPENDED:
+      break;
+  }
+
+  co->transfer = args.empty() ? Obj {Void {}} : args[0];
+  co->status = Coroutine::Status::RUNNING;
+  co->resumer = interp.current_coroutine;
+  interp.current_coroutine = co;
+  const auto handlers = interp.handlers;
+  const auto parameterizations = interp.parameterizations;
+  const auto winders = interp.winders;
+  const auto continuation_frames = interp.continuation_frames;
+  const auto stack_limit = interp.stack_limit;
+  interp.handlers = co->handlers;
+  interp.parameterizations = co->parameterizations;
+  interp.winders = co->winders;
+  interp.continuation_frames = co->continuation_frames;
+  interp.stack_limit = co->stack_limit;
+  std::swap(interp.segments, co->segments);
+  std::swap(interp.call_depth, co->call_depth);
+  swap_in_parameterizations(co->parameterizations);
+
+  switch_context(co->fiber->resumer, co->fiber->context);
+
+  swap_out_parameterizations(interp.parameterizations);
+  std::swap(interp.segments, co->segments);
+  std::swap(interp.call_depth, co->call_depth);
+  co->handlers = interp.handlers;
+  co->parameterizations = interp.parameterizations;
+  co->winders = interp.winders;
+  co->continuation_frames = interp.continuation_frames;
+  co->stack_limit = interp.stack_limit;
+  interp.handlers = handlers;
+  interp.parameterizations = parameterizations;
+  interp.winders = winders;
+  interp.continuation_frames = continuation_frames;
+  interp.stack_limit = stack_limit;
+  interp.current_coroutine = co->resumer;
+
+  if (co->status != Coroutine::Status::DONE) {
+    return co->transfer;
+  }
+  co->fiber.reset();
+  co->thunk = Void {};
+  co->transfer = Void {};
+  interp.live_coroutines.erase(co);
+  if (!co->error || co->abandoned) {
+    return interp.get_eof_object();
+  }
+
+  Obj payload;
+  try {
+    std::rethrow_exception(std::exchange(co->error, nullptr));
+  }
+  catch (SchemeError& e) {
+    payload = std::move(e.payload);
+  }
+  return raise(std::move(payload), false, interp);
+}
+
+Obj
+yield(Obj value, Interpreter& interp) {
+  const auto co = interp.current_coroutine;
+  if (!co) {
+    throw std::runtime_error("yield used outside of a generator");
+  }
+  co->transfer = std::move(value);
+  co->status = Coroutine::Status::SUSPENDED;
+  switch_context(co->fiber->context, co->fiber->resumer);
+  if (co->abandoned) {
+    throw CoroutineAbandoned {};
+  }
+  return co->transfer;
+}
+
+// the lowest address of the thread's own stack and its size, or null
+static std::pair<char*, size_t>
+thread_stack() {
+  pthread_attr_t attr;
+  void *base = nullptr;
+  size_t size = 0;
+  if (pthread_getattr_np(pthread_self(), &attr) == 0) {
+    pthread_attr_getstack(&attr, &base, &size);
+    pthread_attr_destroy(&attr);
+  }
+  return {static_cast<char*>(base), size};
+}
+
+char*
+main_stack_limit() {
+  const auto [base, size] = thread_stack();
+  if (!base || size < 2 * STACK_RED_ZONE) {
+    return nullptr;
+  }
+  return base + STACK_RED_ZONE;
+}
+
+// where the thread's own stack starts, the first frame being just below
+static char*
+main_stack_top() {
+  static char *const top = [] {
+    const auto [base, size] = thread_stack();
+    return base ? base + size : nullptr;
+  }();
+  return top;
+}
+
+// a call running on a segment of its own. the segment returns to its caller
+// only once the call is done, so unlike a coroutine it never needs to be
+// resumed from anywhere else. the segments in use link outward, to the one
+// the caller runs on, so a scan can find the stacks they switched out.
+struct Segment {
+  char *const memory;
+  Interpreter& interp;
+  Context context;
+  Context caller;
+  Segment *const outer;
+  // the top of the stack the caller runs on
+  char *const caller_top;
+  Obj proc;
+  ArgList args;
+  Obj result;
+  std::exception_ptr error;
+
+  Segment(Obj proc, ArgList args, char *caller_top, Interpreter& interp):
+    memory {allocate_stack()},
+    interp {interp},
+    context {},
+    caller {},
+    outer {interp.segments},
+    caller_top {caller_top},
+    proc {std::move(proc)},
+    args {std::move(args)},
+    result {Void {}},
+    error {}
+  {}
+
+  ~Segment() {
+    release_stack(memory);
+  }
+
+  char *top() const {
+    return memory + page_size() + COROUTINE_STACK_SIZE;
+  }
+};
+
+// the top of the stack the coroutine co runs on, or the main program when
+// co is null, given the innermost segment it uses
+static char*
+running_top(const Coroutine *co, const Segment *segments) {
+  if (segments) {
+    return segments->top();
+  }
+  return co ? co->fiber->top() : main_stack_top();
+}
+
+// like coroutine_main, nothing may unwind past here. an error is carried
+// back to the caller's stack and thrown again there.
+static void
+segment_main(void *arg) {
+  const auto segment = static_cast<Segment*>(arg);
+  try {
+    segment->result = as_obj(apply(std::move(segment->proc), std::move(segment->args), segment->interp));
+  }
+  catch (...) {
+    segment->error = std::current_exception();
+  }
+  switch_context(segment->context, segment->caller);
+  std::abort();
+}
+
+Obj
+apply_on_new_segment(Obj proc, ArgList args, Interpreter& interp) {
+  Segment segment {std::move(proc), std::move(args), running_top(interp.current_coroutine, interp.segments), interp};
+  prepare_context(segment.context, segment.top(), segment_main, &segment);
+
+  const auto stack_limit = interp.stack_limit;
+  interp.stack_limit = segment.memory + page_size() + STACK_RED_ZONE;
+  interp.segments = &segment;
+  switch_context(segment.caller, segment.context);
+  interp.segments = segment.outer;
+  interp.stack_limit = stack_limit;
+
+  if (segment.error) {
+    std::rethrow_exception(segment.error);
+  }
+  return std::move(segment.result);
+}
+
+// unwinds a suspended coroutine that can never be resumed, so the C++
+// objects on its stack are destroyed and its stack can be reused
+void
+abandon(Coroutine *co, Interpreter& interp) {
+  if (co->status == Coroutine::Status::SUSPENDED) {
+    co->abandoned = true;
+    resume(co, {}, interp);
+  }
+}
+
+// the stacks a program switched out for the segments it runs on
+static void
+scan_segments(const Segment *segments, Interpreter& interp, std::vector<HeapEntity*>& roots) {
+  for (; segments; segments = segments->outer) {
+    scan_switched_out(segments->caller, segments->caller_top, interp, roots);
+  }
+}
+
+// the stack the coroutine was switched out on and those its segments
+// switched out beneath it
+void
+Coroutine::scan(Allocator&, std::vector<HeapEntity*>& roots) const {
+  if (status == Status::SUSPENDED) {
+    scan_switched_out(fiber->context, running_top(this, segments), fiber->interp, roots);
+    scan_segments(segments, fiber->interp, roots);
+  }
+}
+
+[[gnu::noinline]] static void
+scan_running_stacks(Interpreter& interp, std::vector<HeapEntity*>& roots) {
+  char here;
+  interp.alloc.scan(&here, running_top(interp.current_coroutine, interp.segments), roots);
+  scan_segments(interp.segments, interp, roots);
+  for (auto co = interp.current_coroutine; co; co = co->resumer) {
+    scan_switched_out(co->fiber->resumer, running_top(co->resumer, co->segments), interp, roots);
+    scan_segments(co->segments, interp, roots);
+  }
+}
+
+// the callee-saved registers are spilled into this frame first, so the scan
+// from a frame below it sees what they hold
+[[gnu::noinline]] bool
+scan_stacks(Interpreter& interp, std::vector<HeapEntity*>& roots) {
+  if (!main_stack_top()) {
+    return false;
+  }
+  __builtin_unwind_init();
+  scan_running_stacks(interp, roots);
+  asm volatile ("" ::: "memory");
+  return true;
+}
+
+[[gnu::noinline]] void
+clear_stack() {
+  char stack[CLEARED_STACK];
+  std::memset(stack, 0, sizeof(stack));
+  asm volatile ("" : : "r" (stack) : "memory");
+}
+
+Winder::Winder(Obj before, Obj after, Interpreter& interp):
+  interp {interp},
+  before {std::move(before)},
+  after {std::move(after)},
+  serial {++serials},
+  outer {interp.winders}
+{
+  interp.winders = this;
+}
+
+Winder::~Winder() {
+  interp.winders = outer;
+}
+
+ContinuationFrame::ContinuationFrame(Continuation *k, Interpreter& interp):
+  interp {interp},
+  k {k},
+  outer {interp.continuation_frames}
+{
+  k->active++;
+  interp.continuation_frames = this;
+}
+
+ContinuationFrame::~ContinuationFrame() {
+  k->active--;
+  interp.continuation_frames = outer;
+}
+
+UncopyableFrame::UncopyableFrame(Interpreter& interp, const bool counted): interp {interp}, counted {counted} {
+  if (counted) {
+    interp.uncopyable_frames++;
+  }
+}
+
+UncopyableFrame::~UncopyableFrame() {
+  if (counted) {
+    interp.uncopyable_frames--;
+  }
+}
+
+Continuation::Continuation():
+  Builtin([this](const ArgList& args, Interpreter& interp) -> Obj {
+    invoke(this, args, interp);
+  }),
+  active {0},
+  low {nullptr},
+  top {nullptr},
+  image {},
+  buffers {},
+  handlers {nullptr},
+  parameterizations {nullptr},
+  winders {nullptr},
+  frames {nullptr},
+  call_depth {0},
+  parameters {},
+  winds {},
+  calls {},
+  evaluating {},
+  error {},
+  scanned {false}
+{}
+
+Continuation::~Continuation() {
+  for (const auto& [block, contents] : buffers) {
+    drop_scanned(block);
+  }
+}
+
+void
+Continuation::push_children(MarkStack& worklist) {
+  for (auto& [param, value] : parameters) {
+    worklist.push(param);
+    if (auto ent = try_get_heap_entity(value)) {
+      worklist.push(ent);
+    }
+  }
+  for (auto& [serial, before] : winds) {
+    if (auto ent = try_get_heap_entity(before)) {
+      worklist.push(ent);
+    }
+  }
+  for (auto k : calls) {
+    worklist.push(k);
+  }
+  for (auto expr : evaluating) {
+    worklist.push(expr);
+  }
+}
+
+size_t
+Continuation::bytes() const {
+  size_t ret = image ? top - low : 0;
+  for (const auto& [block, contents] : buffers) {
+    ret += block->bytes;
+  }
+  return ret;
+}
+
+void
+Continuation::scan(Allocator& alloc, std::vector<HeapEntity*>& roots) const {
+  if (image) {
+    alloc.scan(image.get(), image.get() + (top - low), roots);
+  }
+  for (const auto& [block, contents] : buffers) {
+    alloc.scan(contents.get(), contents.get() + block->bytes, roots);
+  }
+}
+
+// the top-level form being evaluated. run_delimited switches to it on the
+// thread's own stack, just below its frame, so that the frames it makes
+// there always run from the same top, and a continuation's copy of them can
+// be put back in place under any later form. copying and putting back run
+// on a helper stack, as the frames being copied cannot be running then.
+struct Prompt {
+  Interpreter& interp;
+  Prompt *const outer;
+  Expression *const expr;
+  char *const top;
+  Context caller;
+  Context form;
+  Context helper;
+  char *helper_memory;
+  // the continuation the helper copies the stack for or puts it back from
+  Continuation *job;
+  bool restoring;
+  // the dynamic state at the top of the form
+  ParameterSwap *const parameterizations;
+  Winder *const winders;
+  ContinuationFrame *const frames;
+  const size_t evaluating;
+  const size_t call_depth;
+  // a continuation to put back once the form has unwound, the values it
+  // was invoked with and how many of its dynamic-winds are still in effect
+  Continuation *reinstating;
+  Obj values;
+  bool many;
+  size_t common;
+  // set while a call/cc returns from a copy put back
+  bool resumed;
+  Obj result;
+  std::exception_ptr error;
+
+  Prompt(Expression *expr, char *top, Interpreter& interp):
+    interp {interp},
+    outer {interp.prompt},
+    expr {expr},
+    top {top},
+    caller {},
+    form {},
+    helper {},
+    helper_memory {nullptr},
+    job {nullptr},
+    restoring {false},
+    parameterizations {interp.parameterizations},
+    winders {interp.winders},
+    frames {interp.continuation_frames},
+    evaluating {interp.evaluating.size()},
+    call_depth {interp.call_depth},
+    reinstating {nullptr},
+    values {Void {}},
+    many {false},
+    common {0},
+    resumed {false},
+    result {Void {}},
+    error {}
+  {}
+
+  ~Prompt() {
+    if (helper_memory) {
+      release_stack(helper_memory);
+    }
+  }
+};
+
+// how far below the frame of run_delimited the form's stack starts
+static constexpr size_t PROMPT_GAP = 512;
+
+// the buffers of the ring that the words in [lo, hi) point into
+static std::vector<ScannedBlock*>
+buffers_referenced(const char *lo, const char *hi) {
+  std::vector<ScannedBlock*> ring {};
+  for (auto block = scanned_blocks.next; block != &scanned_blocks; block = block->next) {
+    ring.push_back(block);
+  }
+  std::sort(ring.begin(), ring.end());
+  std::vector<ScannedBlock*> found {};
+  for (auto word = reinterpret_cast<const uintptr_t*>(lo); word < reinterpret_cast<const uintptr_t*>(hi); word++) {
+    auto itr = std::upper_bound(ring.begin(), ring.end(), *word, [](uintptr_t a, ScannedBlock *block) {
+      return a < reinterpret_cast<uintptr_t>(block + 1);
+    });
+    if (itr == ring.begin()) {
+      continue;
+    }
+    const auto block = *--itr;
+    if (*word <= reinterpret_cast<uintptr_t>(block + 1) + block->bytes) {
+      found.push_back(block);
+    }
+  }
+  std::sort(found.begin(), found.end());
+  found.erase(std::unique(found.begin(), found.end()), found.end());
+  return found;
+}
+
+// copies the form's stack from where it was switched out, with the
+// buffers its frames own, which are held so they outlive those frames
+static void
+copy_stack(Prompt& prompt, Continuation *k) {
+  k->low = static_cast<char*>(prompt.form.sp);
+  k->top = prompt.top;
+  k->image = std::make_unique_for_overwrite<char[]>(k->top - k->low);
+  std::memcpy(k->image.get(), k->low, k->top - k->low);
+  for (const auto block : buffers_referenced(k->image.get(), k->image.get() + (k->top - k->low))) {
+    auto contents = std::make_unique_for_overwrite<char[]>(block->bytes);
+    std::memcpy(contents.get(), block + 1, block->bytes);
+    hold_scanned(block);
+    k->buffers.emplace_back(block, std::move(contents));
+  }
+}
+
+// puts a copy back. a buffer released since comes back to life where it
+// was; one its frame still owns, under a later form running the same
+// frames again, cannot be shared, so the copy gets a new one and every word
+// of the stack pointing into the old one is moved to it.
+static void
+put_back_stack(Continuation *k) {
+  std::memcpy(k->low, k->image.get(), k->top - k->low);
+  for (const auto& [block, contents] : k->buffers) {
+    const auto data = reinterpret_cast<char*>(block + 1);
+    if (block->released) {
+      block->released = false;
+      link_scanned(block);
+      std::memcpy(data, contents.get(), block->bytes);
+      continue;
+    }
+    const auto fresh = static_cast<char*>(allocate_scanned(block->bytes));
+    std::memcpy(fresh, contents.get(), block->bytes);
+    for (auto word = reinterpret_cast<uintptr_t*>(k->low); word < reinterpret_cast<uintptr_t*>(k->top); word++) {
+      const auto addr = reinterpret_cast<char*>(*word);
+      if (addr >= data && addr <= data + block->bytes) {
+        *word = reinterpret_cast<uintptr_t>(fresh + (addr - data));
+      }
+    }
+  }
+}
+
+// the helper stack. it returns to the form by switching to the context the
+// stack it copied or put back was left in.
+static void
+helper_main(void *arg) {
+  const auto prompt = static_cast<Prompt*>(arg);
+  while (true) {
+    const auto k = prompt->job;
+    if (prompt->restoring) {
+      put_back_stack(k);
+    }
+    else {
+      copy_stack(*prompt, k);
+    }
+    Context copied {};
+    copied.sp = k->low;
+    switch_context(prompt->helper, copied);
+  }
+}
+
+static void
+switch_to_helper(Prompt& prompt, Continuation *k, const bool restoring) {
+  if (!prompt.helper_memory) {
+    prompt.helper_memory = allocate_stack();
+    prepare_context(prompt.helper, prompt.helper_memory + page_size() + COROUTINE_STACK_SIZE, helper_main, &prompt);
+  }
+  prompt.job = k;
+  prompt.restoring = restoring;
+  switch_context(prompt.form, prompt.helper);
+}
+
+// runs once the form has unwound, with the dynamic state it had at the top.
+// the dynamic-winds entered again run their before thunks, outermost first,
+// before the copy is put back with the rest of the state it was captured in.
+// the call/cc it was captured at then returns again, inside capture.
+[[noreturn]] static void
+reinstate(Interpreter& interp) {
+  const auto k = std::exchange(interp.prompt->reinstating, nullptr);
+  for (size_t i = interp.prompt->common; i < k->winds.size(); i++) {
+    apply(k->winds[i].second, {}, interp);
+  }
+  const auto prompt = interp.prompt;
+  interp.handlers = k->handlers;
+  interp.parameterizations = k->parameterizations;
+  interp.winders = k->winders;
+  interp.continuation_frames = k->frames;
+  for (const auto& [param, value] : k->parameters) {
+    param->value = value;
+  }
+  interp.evaluating.resize(prompt->evaluating);
+  interp.evaluating.insert(interp.evaluating.end(), k->evaluating.begin(), k->evaluating.end());
+  interp.call_depth = prompt->call_depth + k->call_depth;
+  for (const auto c : k->calls) {
+    c->active++;
+  }
+  prompt->resumed = true;
+  switch_to_helper(*prompt, k, true);
+  std::abort();
+}
+
+// evaluates one step of the form, leaving what it returns or throws in the
+// prompt. a continuation invoked in the step is left to be put back.
+template<typename F>
+static void
+run_step(Interpreter& interp, F step) {
+  try {
+    step();
+  }
+  catch (const Reinstate& r) {
+    const auto prompt = interp.prompt;
+    prompt->reinstating = r.target();
+    prompt->values = r.values;
+    prompt->many = r.many;
+    prompt->common = r.common;
+  }
+  catch (const ContinuationThrow&) {
+    interp.prompt->error = std::make_exception_ptr(std::runtime_error("continuation invoked outside the generator its call/cc ran in"));
+  }
+  catch (...) {
+    interp.prompt->error = std::current_exception();
+  }
+}
+
+// like coroutine_main, nothing may unwind past here. the prompt is looked up
+// afresh each time, as this frame may be a copy put back under a later form.
+static void
+prompt_main(void *arg) {
+  auto& interp = *static_cast<Interpreter*>(arg);
+  run_step(interp, [&] {
+    interp.prompt->result = as_obj(interp.prompt->expr->eval(interp.get_global_env(), interp));
+  });
+  while (interp.prompt->reinstating) {
+    run_step(interp, [&] {
+      reinstate(interp);
+    });
+  }
+  switch_context(interp.prompt->form, interp.prompt->caller);
+  std::abort();
+}
+
+Obj
+run_delimited(Expression *expr, Interpreter& interp) {
+  if (!COPYABLE_STACKS || interp.current_coroutine || interp.segments) {
+    return as_obj(expr->eval(interp.get_global_env(), interp));
+  }
+  const auto top = reinterpret_cast<char*>(reinterpret_cast<uintptr_t>(stack_pointer() - PROMPT_GAP) & ~uintptr_t {63});
+  Prompt prompt {expr, top, interp};
+  interp.prompt = &prompt;
+  prepare_context(prompt.form, top, prompt_main, &interp);
+  switch_context(prompt.caller, prompt.form);
+  interp.prompt = prompt.outer;
+  if (prompt.error) {
+    std::rethrow_exception(prompt.error);
+  }
+  return prompt.result;
+}
+
+std::optional<Obj>
+capture(Continuation *k, Interpreter& interp) {
+  const auto prompt = interp.prompt;
+  if (!COPYABLE_STACKS || !prompt || interp.current_coroutine || interp.segments || interp.uncopyable_frames) {
+    return std::nullopt;
+  }
+  k->handlers = interp.handlers;
+  k->parameterizations = interp.parameterizations;
+  k->winders = interp.winders;
+  k->frames = interp.continuation_frames;
+  for (auto swap = interp.parameterizations; swap != prompt->parameterizations; swap = swap->outer) {
+    swap->save(k->parameters);
+  }
+  for (auto wind = interp.winders; wind != prompt->winders; wind = wind->outer) {
+    k->winds.emplace_back(wind->serial, wind->before);
+  }
+  std::reverse(k->winds.begin(), k->winds.end());
+  for (auto frame = interp.continuation_frames; frame != prompt->frames; frame = frame->outer) {
+    k->calls.push_back(frame->k);
+  }
+  k->evaluating.assign(interp.evaluating.begin() + prompt->evaluating, interp.evaluating.end());
+  k->call_depth = interp.call_depth - prompt->call_depth;
+
+  switch_to_helper(*prompt, k, false);
+
+  const auto current = interp.prompt;
+  if (!std::exchange(current->resumed, false)) {
+    interp.alloc.hold(k->bytes());
+    return std::nullopt;
+  }
+  auto values = std::exchange(current->values, Void {});
+  if (current->many) {
+    return interp.return_values(as_vector(values)->data);
+  }
+  return values;
+}
+
+void
+invoke(Continuation *k, const ArgList& args, Interpreter& interp) {
+  const bool many = args.size() != 1;
+  Obj values = many ? Obj {interp.spawn<Vector>(ArgList(args))} : args[0];
+  if (k->active) {
+    throw ContinuationThrow {k, std::move(values), many};
+  }
+  if (!k->image) {
+    throw std::runtime_error("continuation invoked after its call/cc returned, but it was captured where it is escape-only: in a generator, in deep recursion or in the after thunk of a dynamic-wind left by an error");
+  }
+  if (!interp.prompt || interp.prompt->top != k->top) {
+    throw std::runtime_error("continuation invoked where its stack cannot be put back");
+  }
+  // the dynamic-winds in effect now that it was captured under as well
+  std::vector<uint64_t> serials {};
+  for (auto wind = interp.winders; wind; wind = wind->outer) {
+    serials.push_back(wind->serial);
+  }
+  std::reverse(serials.begin(), serials.end());
+  size_t common = 0;
+  while (common < serials.size() && common < k->winds.size() && serials[common] == k->winds[common].first) {
+    common++;
+  }
+  throw Reinstate {k, std::move(values), many, common};
+}
+
+}
@@ -1,7 +1,14 @@
 #include <interpreter/types.hpp>
 #include <interpreter/environment.hpp>
 #include <interpreter/expressions.hpp>
+#include <interpreter/evaluation.hpp>
 #include <interpreter/interpreter.hpp>
+#include <interpreter/promise.hpp>
+#include <interpreter/exceptions.hpp>
+#include <interpreter/parameters.hpp>
+#include <interpreter/coroutine.hpp>
+#include <builtins/common.hpp>
+#include <array>
 
 namespace Scheme {
 
@@ -24,13 +31,23 @@ to_variadic_args(ArgList args, const size_t size, Interpreter& interp) {
 
 EvalResult 
 apply(Obj p, ArgList args, Interpreter& interp) {
+  CallDepth depth {interp};
   while (true) {
     if (is_builtin(p)) {
-      const auto func = *as_builtin(p);
-      return func(args, interp);
+      return (*as_builtin(p))(args, interp);
     }
 
     else if (is_procedure(p)) {
+      interp.safe_point();
+      if (interp.calls_exhausted()) {
+        throw std::runtime_error(std::format(
+          "stack overflow: recursion goes deeper than the stack limit of {} calls",
+          interp.call_budget
+        ));
+      }
+      if (interp.stack_exhausted()) {
+        return apply_on_new_segment(std::move(p), std::move(args), interp);
+      }
       auto func = as_procedure(p);
 
       if (func->is_variadic) {
@@ -62,6 +79,17 @@ apply(Obj p, ArgList args, Interpreter& interp) {
         args = std::move(as_tailcall(res).args);
       }
     }
+    else if (is_parameter(p)) {
+      if (!args.empty()) {
+        throw std::runtime_error("wrong number of arguments: expected 0");
+      }
+      return as_parameter(p)->value;
+    }
+
+    else if (is_coroutine(p)) {
+      return resume(as_coroutine(p), args, interp);
+    }
+
     else {
       throw std::runtime_error("tried to apply an object that is not a procedure");
     }
@@ -89,6 +117,11 @@ Variable::eval(Environment *env, Interpreter& interp) {
   }
 }
 
+EvalResult
+GlobalVariable::eval(Environment *env, Interpreter& interp) {
+  return interp.get_global_env()->get(sym);
+}
+
 EvalResult
 Quoted::eval(Environment *env, Interpreter& interp) {
   return text;
@@ -100,11 +133,11 @@ Quasiquoted::eval(Environment *env, Interpreter& interp) {
     return get<Obj>(text);
   }
   else {
-    auto exprs = get<std::vector<Expression*>>(text);
+    const auto& exprs = get<std::vector<Expression*>>(text);
     Obj ret = Null {};
     for (auto itr = exprs.rbegin(); itr != exprs.rend(); itr++) {
       auto res = (*itr)->eval(env, interp);
-      ret = interp.spawn<Cons>(as_obj(res), ret);
+      ret = interp.spawn<Cons>(interp.one_value(as_obj(res)), ret);
     }
     return ret;
   }
@@ -112,14 +145,14 @@ Quasiquoted::eval(Environment *env, Interpreter& interp) {
 
 EvalResult
 Set::eval(Environment *env, Interpreter& interp) {
-  auto eval_value = as_obj(value->eval(env, interp));
+  auto eval_value = interp.one_value(as_obj(value->eval(env, interp)));
   env->set(variable, eval_value);
   return Void {};
 }
 
 EvalResult
 If::eval(Environment *env, Interpreter& interp) {
-  if (is_true(as_obj(predicate->eval(env, interp)))) {
+  if (is_true(interp.one_value(as_obj(predicate->eval(env, interp))))) {
     return consequent->eval(env, interp);
   }
   else {
@@ -148,14 +181,94 @@ Lambda::eval(Environment *env, Interpreter& interp) {
 
 EvalResult
 Define::eval(Environment *env, Interpreter& interp) {
-  env->define(variable, as_obj(value->eval(env, interp)));
+  env->define(variable, interp.one_value(as_obj(value->eval(env, interp))));
+  return Void {};
+}
+
+EvalResult
+Delay::eval(Environment *env, Interpreter& interp) {
+  return interp.spawn<Promise>(interp.spawn<PromiseState>(expr, env, lazy), stream);
+}
+
+// a stream that is already a pair, of a promise for head and a lazy promise
+// for the tail stream
+EvalResult
+StreamCons::eval(Environment *env, Interpreter& interp) {
+  const auto first = interp.spawn<Promise>(interp.spawn<PromiseState>(head, env, false));
+  const auto rest = interp.spawn<Promise>(interp.spawn<PromiseState>(tail, env, true), true);
+  const auto pair = interp.spawn<Cons>(first, rest);
+  return interp.spawn<Promise>(interp.spawn<PromiseState>(pair), true);
+}
+
+static Record*
+get_record(const Obj& obj, RecordType *const type) {
+  if (!is_record(obj) || as_record(obj)->type != type) {
+    throw std::runtime_error("incorrect type for " + stringify(obj) + ", expected " + type->name.get_name());
+  }
+  return as_record(obj);
+}
+
+// the constructor takes the type's constructor slots; the other roles use
+// slot, where they have one
+Builtin*
+make_record_procedure(RecordType *type, const RecordRole role, const size_t slot, Interpreter& interp) {
+  switch (role) {
+    case RecordRole::CONSTRUCTOR:
+      return interp.spawn<Builtin>([type](const ArgList& args, Interpreter& interp) {
+        const auto& slots = type->constructor_slots;
+        assert_arg_count(args, slots.size(), slots.size());
+        const auto record = interp.spawn<Record>(type);
+        for (size_t i = 0; i < slots.size(); i++) {
+          record->slots()[slots[i]] = args[i];
+        }
+        return record;
+      }, Primitive::NONE, type, 0, role);
+    case RecordRole::PREDICATE:
+      return interp.spawn<Builtin>([type](const ArgList& args, Interpreter&) {
+        assert_arg_count(args, 1, 1);
+        return is_record(args[0]) && as_record(args[0])->type == type;
+      }, Primitive::NONE, type, 0, role);
+    case RecordRole::ACCESSOR:
+      return interp.spawn<Builtin>([type, slot](const ArgList& args, Interpreter&) {
+        assert_arg_count(args, 1, 1);
+        return get_record(args[0], type)->slots()[slot];
+      }, Primitive::RECORD_REF, type, slot, role);
+    case RecordRole::MODIFIER:
+      return interp.spawn<Builtin>([type, slot](const ArgList& args, Interpreter&) {
+        assert_arg_count(args, 2, 2);
+        get_record(args[0], type)->slots()[slot] = args[1];
+        return Void {};
+      }, Primitive::NONE, type, slot, role);
+    default:
+      throw std::runtime_error("not a record procedure role");
+  }
+}
+
+EvalResult
+DefineRecord::eval(Environment *env, Interpreter& interp) {
+  const auto type = interp.spawn<RecordType>(type_name, fields, constructor_slots);
+  env->define(type_name, type);
+
+  if (constructor) {
+    env->define(*constructor, make_record_procedure(type, RecordRole::CONSTRUCTOR, 0, interp));
+  }
+
+  env->define(predicate, make_record_procedure(type, RecordRole::PREDICATE, 0, interp));
+
+  for (const auto& proc : procedures) {
+    env->define(proc.accessor, make_record_procedure(type, RecordRole::ACCESSOR, proc.slot, interp));
+    if (proc.modifier) {
+      env->define(*proc.modifier, make_record_procedure(type, RecordRole::MODIFIER, proc.slot, interp));
+    }
+  }
+
   return Void {};
 }
 
 static void
 make_let_frame(LetBindings& bindings, Environment *branch, Environment *base, Interpreter& interp) {
   for (auto& p : bindings) {
-    branch->define(p.first, as_obj(p.second->eval(base, interp)));
+    branch->define(p.first, interp.one_value(as_obj(p.second->eval(base, interp))));
   }
 }
 
@@ -173,6 +286,43 @@ LetSeq::eval(Environment *env, Interpreter& interp) {
   return body->eval(branch, interp);
 }
 
+// binds the formals to the values result stands for
+static void
+bind_values(const ValuesBinding& binding, const Obj& result, Environment *frame, Interpreter& interp) {
+  const bool many = interp.is_values(result);
+  const Obj *const values = many ? interp.values.data() : &result;
+  const size_t count = many ? interp.values.size() : 1;
+  const size_t required = binding.formals.size() - binding.is_variadic;
+  if (binding.is_variadic ? count < required : count != required) {
+    throw std::runtime_error(std::format(
+      "wrong number of values: expected {}{}, got {}",
+      required,
+      binding.is_variadic ? "+" : "",
+      count
+    ));
+  }
+  for (size_t i = 0; i < required; i++) {
+    frame->define(binding.formals[i], values[i]);
+  }
+  if (binding.is_variadic) {
+    Obj rest = Null {};
+    for (size_t i = count; i > required; i--) {
+      rest = interp.spawn<Cons>(values[i - 1], rest);
+    }
+    frame->define(binding.formals.back(), rest);
+  }
+}
+
+EvalResult
+LetValues::eval(Environment *env, Interpreter& interp) {
+  const auto branch = env->extend(interp);
+  for (const auto& binding : bindings) {
+    const auto result = as_obj(binding.expr->eval(sequential ? branch : env, interp));
+    bind_values(binding, result, branch, interp);
+  }
+  return body->eval(branch, interp);
+}
+
 EvalResult
 Cond::eval(Environment *env, Interpreter& interp) {
   for (const Clause& clause : clauses) {
@@ -180,7 +330,7 @@ Cond::eval(Environment *env, Interpreter& interp) {
       return clause.actions->eval(env, interp);
     }
     else {
-      auto pred_output = as_obj(clause.predicate->eval(env, interp));
+      auto pred_output = interp.one_value(as_obj(clause.predicate->eval(env, interp)));
       if (is_true(pred_output)) {
         if (clause.actions != nullptr) {
           return clause.actions->eval(env, interp);
@@ -194,13 +344,289 @@ Cond::eval(Environment *env, Interpreter& interp) {
   return Void {}; 
 }
 
+EvalResult
+Loop::eval(Environment *env, Interpreter& interp) {
+  const auto frame = env->extend(interp);
+  for (size_t i = 0; i < variables.size(); i++) {
+    frame->define(variables[i], interp.one_value(as_obj(inits[i]->eval(env, interp))));
+  }
+  while (true) {
+    interp.safe_point();
+    auto res = body->eval(frame, interp);
+    if (!is_next_iteration(res)) {
+      return res;
+    }
+  }
+}
+
+// loops rarely carry more variables than this, and their new values are
+// then held on the C++ stack rather than in an allocated list
+static constexpr size_t INLINE_LOOP_VARIABLES = 8;
+
+template<typename Values>
+static void
+rebind_loop_variables(Environment *env, const ParamList& variables, Values& values, const int depth) {
+  for (int i = 0; i < depth; i++) {
+    env = env->super;
+  }
+  for (size_t i = 0; i < variables.size(); i++) {
+    env->define(variables[i], std::move(values[i]));
+  }
+}
+
+// all the new values are computed before any variable changes. the loop's
+// frame is found the way variables are, by a depth resolved on first use.
+EvalResult
+Recur::eval(Environment *env, Interpreter& interp) {
+  if (variables.empty()) {
+    return NextIteration {};
+  }
+  if (!resolved) {
+    depth = env->get_with_depth(variables[0]).second;
+    resolved = true;
+  }
+  if (args.size() <= INLINE_LOOP_VARIABLES) {
+    std::array<Obj, INLINE_LOOP_VARIABLES> values {};
+    for (size_t i = 0; i < args.size(); i++) {
+      values[i] = interp.one_value(as_obj(args[i]->eval(env, interp)));
+    }
+    rebind_loop_variables(env, variables, values, depth);
+  }
+  else {
+    ArgList values {};
+    values.reserve(args.size());
+    for (const auto arg : args) {
+      values.push_back(interp.one_value(as_obj(arg->eval(env, interp))));
+    }
+    rebind_loop_variables(env, variables, values, depth);
+  }
+  return NextIteration {};
+}
+
+EvalResult
+Repeat::eval(Environment *env, Interpreter& interp) {
+  while (true) {
+    interp.safe_point();
+    auto res = body->eval(env, interp);
+    if (!is_next_iteration(res)) {
+      return res;
+    }
+  }
+}
+
+EvalResult
+SelfCall::eval(Environment *env, Interpreter& interp) {
+  auto frame = env;
+  for (int i = 0; i < recur->depth; i++) {
+    frame = frame->super;
+  }
+  const auto op = as_obj(call->op->eval(env, interp));
+  if (is_procedure(op) && as_procedure(op)->body == body && as_procedure(op)->env == frame->super) {
+    return recur->eval(env, interp);
+  }
+  return call->eval(env, interp);
+}
+
+// every value is computed and converted before any is swapped in. the old
+// ones go back however the body is left, by an escape or an error included.
+EvalResult
+Parameterize::eval(Environment *env, Interpreter& interp) {
+  ParameterBindings values {};
+  values.reserve(bindings.size());
+  for (auto& [param_expr, value_expr] : bindings) {
+    const auto param = interp.one_value(as_obj(param_expr->eval(env, interp)));
+    if (!is_parameter(param)) {
+      throw std::runtime_error("parameterize: " + stringify(param) + " is not a parameter");
+    }
+    auto value = interp.one_value(as_obj(value_expr->eval(env, interp)));
+    const auto parameter = as_parameter(param);
+    if (is_true(parameter->converter)) {
+      value = call(parameter->converter, {std::move(value)}, interp);
+    }
+    values.emplace_back(parameter, std::move(value));
+  }
+  ParameterSwap swap {interp, values};
+  return as_obj(body->eval(env, interp));
+}
+
+// errors thrown by builtins are caught here too, as error objects. the body
+// is never in tail position, so the handler stays installed until it is done.
+EvalResult
+Guard::eval(Environment *env, Interpreter& interp) {
+  HandlerFrame frame {Void {}, interp.handlers};
+  Obj condition;
+  try {
+    HandlerScope scope {interp, &frame};
+    return as_obj(body->eval(env, interp));
+  }
+  catch (SchemeError& e) {
+    if (e.target != &frame) {
+      throw;
+    }
+    condition = std::move(e.payload);
+  }
+  catch (const std::runtime_error& e) {
+    condition = make_error_object(e, interp);
+  }
+
+  const auto branch = env->extend(interp);
+  branch->define(variable, condition);
+  for (const Clause& clause : clauses) {
+    if (clause.is_else) {
+      return clause.actions->eval(branch, interp);
+    }
+    auto pred_output = interp.one_value(as_obj(clause.predicate->eval(branch, interp)));
+    if (is_true(pred_output)) {
+      return clause.actions ? clause.actions->eval(branch, interp) : pred_output;
+    }
+  }
+  return raise(std::move(condition), true, interp);
+}
+
+static Obj
+binary_numeric(const Primitive prim, const double lhs, const double rhs) {
+  switch (prim) {
+    case Primitive::ADD:
+      return lhs + rhs;
+    case Primitive::SUB:
+      return lhs - rhs;
+    case Primitive::MUL:
+      return lhs * rhs;
+    case Primitive::DIV:
+      return lhs / rhs;
+    case Primitive::NUM_EQ:
+      return lhs == rhs;
+    case Primitive::LT:
+      return lhs < rhs;
+    case Primitive::GT:
+      return lhs > rhs;
+    case Primitive::LE:
+      return lhs <= rhs;
+    case Primitive::GE:
+      return lhs >= rhs;
+    default:
+      throw std::runtime_error("not a binary numeric primitive");
+  }
+}
+
+static Obj
+unary_pair(const Primitive prim, Cons *const cons) {
+  switch (prim) {
+    case Primitive::CAR:
+      return cons->car;
+    case Primitive::CDR:
+      return cons->cdr;
+    default:
+      throw std::runtime_error("not a unary pair primitive");
+  }
+}
+
+static bool
+is_binary_numeric(const Primitive prim) {
+  switch (prim) {
+    case Primitive::ADD: case Primitive::SUB:
+    case Primitive::MUL: case Primitive::DIV:
+    case Primitive::NUM_EQ: case Primitive::LT: case Primitive::GT:
+    case Primitive::LE: case Primitive::GE:
+      return true;
+    default:
+      return false;
+  }
+}
+
+static bool
+is_unary_pair(const Primitive prim) {
+  return prim == Primitive::CAR || prim == Primitive::CDR;
+}
+
+void
+Application::record_feedback(const Obj& proc, const ArgList& args) {
+  shape = CallShape::GENERIC;
+  if (!is_builtin(proc)) {
+    return;
+  }
+  const auto builtin = as_builtin(proc);
+  if (is_binary_numeric(builtin->prim) && args.size() == 2 && is_number(args[0]) && is_number(args[1])) {
+    shape = CallShape::BINARY_NUMERIC;
+    feedback_target = builtin;
+  }
+  else if (is_unary_pair(builtin->prim) && args.size() == 1 && is_pair(args[0])) {
+    shape = CallShape::UNARY_PAIR;
+    feedback_target = builtin;
+  }
+  else if (builtin->prim == Primitive::RECORD_REF && args.size() == 1 && is_record(args[0])) {
+    shape = CallShape::UNARY_RECORD;
+    feedback_target = builtin;
+  }
+}
+
+void
+Application::deoptimize() {
+  shape = CallShape::GENERIC;
+  feedback_target = nullptr;
+}
+
+// the value goes straight into the list, and the result it came in dies
+// with this frame rather than staying in the caller's, where a scan of the
+// stack would find it for as long as the call runs
+[[gnu::noinline]] static void
+push_argument(ArgList& args, Expression *param, Environment *env, Interpreter& interp) {
+  auto res = param->eval(env, interp);
+  args.push_back(interp.one_value(as_obj(res)));
+  res = Obj {0.0};
+  asm volatile ("" : : "r" (&res) : "memory");
+}
+
 EvalResult
 Application::eval(Environment *env, Interpreter& interp) {
-  auto proc = as_obj(op->eval(env, interp));
+  auto proc = interp.one_value(as_obj(op->eval(env, interp)));
   ArgList args {};
-  for (const auto& param : params) {
-    args.push_back(as_obj(param->eval(env, interp)));
+
+  if (shape != CallShape::UNSEEN && shape != CallShape::GENERIC) {
+    if (is_builtin(proc) && as_builtin(proc) == feedback_target) {
+      const auto prim = feedback_target->prim;
+      if (shape == CallShape::BINARY_NUMERIC) {
+        auto lhs = interp.one_value(as_obj(params[0]->eval(env, interp)));
+        auto rhs = interp.one_value(as_obj(params[1]->eval(env, interp)));
+        if (is_number(lhs) && is_number(rhs)) {
+          return binary_numeric(prim, as_number(lhs), as_number(rhs));
+        }
+        args = {std::move(lhs), std::move(rhs)};
+      }
+      else if (shape == CallShape::UNARY_PAIR) {
+        auto arg = interp.one_value(as_obj(params[0]->eval(env, interp)));
+        if (is_pair(arg)) {
+          return unary_pair(prim, as_pair(arg));
+        }
+        args = {std::move(arg)};
+      }
+      else {
+        // the accessor's own type check, done inline
+        auto arg = interp.one_value(as_obj(params[0]->eval(env, interp)));
+        if (is_record(arg) && as_record(arg)->type == feedback_target->record_type) {
+          return as_record(arg)->slots()[feedback_target->slot];
+        }
+        args = {std::move(arg)};
+      }
+    }
+    deoptimize();
+  }
+
+  // reading a parameter: no call at all
+  if (params.empty() && is_parameter(proc)) {
+    return as_parameter(proc)->value;
   }
+
+  if (args.empty()) {
+    for (const auto param : params) {
+      push_argument(args, param, env, interp);
+    }
+  }
+
+  if (shape == CallShape::UNSEEN) {
+    record_feedback(proc, args);
+  }
+
   if (at_tail) {
     return TailCall(proc, std::move(args));
   }
@@ -211,22 +637,29 @@ Application::eval(Environment *env, Interpreter& interp) {
 
 EvalResult
 And::eval(Environment *env, Interpreter& interp) {
-  for (const auto& exp : exprs) {
-    if (is_false(as_obj(exp->eval(env, interp)))) {
+  if (exprs.empty()) {
+    return true;
+  }
+  for (size_t i = 0; i + 1 < exprs.size(); i++) {
+    if (is_false(interp.one_value(as_obj(exprs[i]->eval(env, interp))))) {
       return false;
     }
   }
-  return true;
+  return exprs.back()->eval(env, interp);
 }
 
 EvalResult
 Or::eval(Environment *env, Interpreter& interp) {
-  for (const auto& exp : exprs) {
-    if (is_true(as_obj(exp->eval(env, interp)))) {
-      return true;
+  if (exprs.empty()) {
+    return false;
+  }
+  for (size_t i = 0; i + 1 < exprs.size(); i++) {
+    auto value = interp.one_value(as_obj(exprs[i]->eval(env, interp)));
+    if (is_true(value)) {
+      return value;
     }
   }
-  return false;
+  return exprs.back()->eval(env, interp);
 }
 
 }
@@ -0,0 +1,77 @@
+#include <interpreter/types.hpp>
+#include <interpreter/expressions.hpp>
+#include <interpreter/evaluation.hpp>
+#include <interpreter/interpreter.hpp>
+#include <interpreter/exceptions.hpp>
+
+namespace Scheme {
+
+Obj
+make_error_object(Obj message, Obj irritants, Interpreter& interp) {
+  const auto ret = interp.spawn<Record>(interp.get_error_type());
+  ret->slots()[0] = std::move(message);
+  ret->slots()[1] = std::move(irritants);
+  return ret;
+}
+
+// errors thrown by builtins already carry their formatted message
+Obj
+make_error_object(const std::exception& e, Interpreter& interp) {
+  return make_error_object(interp.spawn<String>(e.what()), Null {}, interp);
+}
+
+bool
+is_error_object(const Obj& obj, const Interpreter& interp) {
+  return is_record(obj) && as_record(obj)->type == interp.get_error_type();
+}
+
+const char*
+SchemeError::what() const noexcept {
+  if (message.empty()) {
+    if (is_record(payload) && as_record(payload)->type == error_type) {
+      const auto r = as_record(payload);
+      stringify_into(message, r->slots()[0]);
+      for (Obj ls = r->slots()[1]; is_pair(ls); ls = as_pair(ls)->cdr) {
+        message += ' ';
+        stringify_into(message, as_pair(ls)->car);
+      }
+    }
+    else {
+      message = "uncaught exception: " + stringify(payload);
+    }
+  }
+  return message.c_str();
+}
+
+// hands obj to the innermost handler, which runs with the handlers outside
+// it in effect. no C++ frames are unwound to get there; only a guard, which
+// has to take control back, is reached by throwing. for raise, a handler
+// that returns is itself an error, raised to the outer handlers.
+Obj
+raise(Obj obj, const bool continuable, Interpreter& interp) {
+  const auto frame = interp.handlers;
+  if (!frame || frame->is_guard()) {
+    throw SchemeError(std::move(obj), frame, interp);
+  }
+
+  HandlerScope scope {interp, frame->outer};
+  Obj result;
+  bool failed = false;
+  try {
+    result = as_obj(apply(frame->handler, {obj}, interp));
+  }
+  catch (const std::runtime_error& e) {
+    result = make_error_object(e, interp);
+    failed = true;
+  }
+  if (failed) {
+    return raise(std::move(result), false, interp);
+  }
+  if (continuable) {
+    return result;
+  }
+  const auto irritants = interp.spawn<Cons>(obj, Null {});
+  return raise(make_error_object(interp.spawn<String>("handler returned from non-continuable raise:"), irritants, interp), false, interp);
+}
+
+}
@@ -1,6 +1,8 @@
 #include <interpreter/types.hpp>
 #include <interpreter/expressions.hpp>
+#include <interpreter/macros.hpp>
 #include <format>
+#include <algorithm>
 
 namespace Scheme {
 
@@ -17,10 +19,56 @@ Begin::tco() {
   }
 }
 
+// a clause without actions gives its predicate's value, which is not a call
 void 
 Cond::tco() {
   for (auto& clause : clauses) {
-    clause.actions->tco();
+    if (clause.actions) {
+      clause.actions->tco();
+    }
+  }
+}
+
+void 
+Let::tco() {
+  body->tco();
+}
+
+void 
+LetSeq::tco() {
+  body->tco();
+}
+
+void 
+LetValues::tco() {
+  body->tco();
+}
+
+void 
+And::tco() {
+  if (!exprs.empty()) {
+    exprs.back()->tco();
+  }
+}
+
+void 
+Or::tco() {
+  if (!exprs.empty()) {
+    exprs.back()->tco();
+  }
+}
+
+void 
+Loop::tco() {
+  body->tco();
+}
+
+void 
+Guard::tco() {
+  for (auto& clause : clauses) {
+    if (clause.actions) {
+      clause.actions->tco();
+    }
   }
 }
 
@@ -84,7 +132,7 @@ cons2exprs(const Obj& ls, Interpreter& interp) {
 static Expression*
 make_quoted(Cons *cons, Interpreter& interp) {
   assert_size(cons, 2, 2, "quoted");
-  return interp.spawn<Quoted>(cons->at("cadr"));
+  return interp.spawn<Quoted>(interp.syntax.strip(cons->at("cadr"), interp));
 }
 
 static Expression*
@@ -92,16 +140,17 @@ make_quasiquoted_impl(Obj obj, Interpreter& interp) {
   if (is_pair(obj)) {
     auto car = as_pair(obj)->car;
     if (is_symbol(car)) {
-      if (as_symbol(car) == interp.intern_symbol("unquote")) {
+      const auto keyword = interp.syntax.strip(as_symbol(car));
+      if (keyword == interp.intern_symbol("unquote")) {
         assert_size(as_pair(obj), 2, 2, "unquoted");
         return build_ast(as_pair(obj)->at("cadr"), interp);
       }
-      else if (as_symbol(car) == interp.intern_symbol("unquote-splicing")) {
+      else if (keyword == interp.intern_symbol("unquote-splicing")) {
         throw std::runtime_error("unquote-splicing not supported yet");
       }
-      else if (as_symbol(car) == interp.intern_symbol("quasiquote")) {
+      else if (keyword == interp.intern_symbol("quasiquote")) {
         assert_size(as_pair(obj), 2, 2, "quasiquoted");
-        return interp.spawn<Quasiquoted>(obj);
+        return interp.spawn<Quasiquoted>(interp.syntax.strip(obj, interp));
       }
     }
     std::vector<Expression*> exprs {};
@@ -116,7 +165,7 @@ make_quasiquoted_impl(Obj obj, Interpreter& interp) {
     return interp.spawn<Quasiquoted>(std::move(exprs));
   }
   else {
-    return interp.spawn<Quasiquoted>(obj);
+    return interp.spawn<Quasiquoted>(interp.syntax.strip(obj, interp));
   }
 }
 
@@ -144,7 +193,7 @@ make_set(Cons *cons, Interpreter& interp) {
   if (!is_symbol(cdr->car)) {
     throw std::runtime_error("tried to assign something to a non-variable");
   }
-  const auto variable = as_symbol(cdr->car);
+  const auto variable = interp.syntax.resolve(as_symbol(cdr->car));
   auto value = build_ast(cddr->car, interp);
   return interp.spawn<Set>(variable, value);
 }
@@ -163,9 +212,33 @@ make_if(Cons *cons, Interpreter& interp) {
   );
 }
 
+// (when test body ...) and (unless test body ...), as one-armed ifs
+static Expression*
+make_when(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 3, MAXARGS, "when");
+  const auto cdr = as_pair(cons->cdr);
+  return interp.spawn<If>(
+    build_ast(cdr->car, interp),
+    combine_expr(cdr->cdr, interp),
+    interp.spawn<Literal>(Void {})
+  );
+}
+
+static Expression*
+make_unless(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 3, MAXARGS, "unless");
+  const auto cdr = as_pair(cons->cdr);
+  return interp.spawn<If>(
+    build_ast(cdr->car, interp),
+    interp.spawn<Literal>(Void {}),
+    combine_expr(cdr->cdr, interp)
+  );
+}
+
 static Expression*
 make_lambda(const Obj& params_cons, const Obj& body_cons, Interpreter& interp) {
   auto [params, is_variadic] = cons2paramlist(params_cons);
+  SyntaxScope scope {interp, params};
   auto body = combine_expr(body_cons, interp);
   auto ret = interp.spawn<Lambda>(
     std::move(params),
@@ -182,9 +255,11 @@ make_lambda(Cons *cons, Interpreter& interp) {
   return make_lambda(cdr->car, cdr->cdr, interp);
 }
 
+static Expression* make_procedure_define(Symbol, Expression*, Interpreter&);
+
 static Expression*
 make_var_define(Cons *cons, Cons *cdr, Interpreter& interp) {
-  const auto name = as_symbol(cdr->car);
+  const auto name = interp.syntax.bind(as_symbol(cdr->car));
   if (is_null(cdr->cdr)) {
     return interp.spawn<Define>(name, interp.spawn<Literal>(Void {}));
   }
@@ -197,23 +272,23 @@ make_var_define(Cons *cons, Cons *cdr, Interpreter& interp) {
         list_length(cons)
       ));
     }
-    return interp.spawn<Define>(name, build_ast(cddr->car, interp));
+    return make_procedure_define(name, build_ast(cddr->car, interp), interp);
   }
 }
 
 static Expression*
 make_proc_define(Cons *cons, Cons *cdr, Interpreter& interp) {
   const auto cadr = as_pair(cdr->car);
-  const auto name = as_symbol(cadr->car);
   const auto parameters = cadr->cdr;
   const auto body = cdr->cdr; 
-  if (!is_symbol(name)) {
+  if (!is_symbol(cadr->car)) {
     throw std::runtime_error(std::format(
       "in define expression {}, procedure name must be a symbol",
       stringify(cons)
     ));
   }
-  return interp.spawn<Define>(name, make_lambda(parameters, body, interp));
+  const auto name = interp.syntax.bind(as_symbol(cadr->car));
+  return make_procedure_define(name, make_lambda(parameters, body, interp), interp);
 }
 
 static Expression*
@@ -234,8 +309,148 @@ make_define(Cons *cons, Interpreter& interp) {
   }
 }
 
+static Symbol
+record_symbol(const Obj& obj, const std::string& what) {
+  if (!is_symbol(obj)) {
+    throw std::runtime_error(std::format("define-record-type: {} must be a symbol: {}", what, stringify(obj)));
+  }
+  return as_symbol(obj);
+}
+
+static Symbol
+record_binding(const Obj& obj, const std::string& what, Interpreter& interp) {
+  return interp.syntax.bind(record_symbol(obj, what));
+}
+
+// (define-record-type <name> (constructor field ...) predicate
+//   (field accessor [modifier]) ...)
+// a bare constructor name takes every field in order
+static Expression*
+make_define_record(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 4, MAXARGS, "define-record-type");
+  const auto cdr = as_pair(cons->cdr);
+  const auto cddr = as_pair(cdr->cdr);
+  const auto cdddr = as_pair(cddr->cdr);
+
+  const auto type_name = record_binding(cdr->car, "type name", interp);
+  const auto predicate = record_binding(cdddr->car, "predicate name", interp);
+
+  std::vector<Symbol> fields {};
+  std::vector<RecordField> procedures {};
+  for (Obj ls = cdddr->cdr; is_pair(ls); ls = as_pair(ls)->cdr) {
+    const auto spec = as_pair(ls)->car;
+    const auto [length, proper] = list_profile(spec);
+    if (!is_pair(spec) || !proper || length < 2 || length > 3) {
+      throw std::runtime_error(std::format("define-record-type: bad field spec {}", stringify(spec)));
+    }
+    const auto field = record_symbol(as_pair(spec)->car, "field name");
+    if (std::find(fields.begin(), fields.end(), field) != fields.end()) {
+      throw std::runtime_error(std::format("define-record-type: duplicate field {}", field.get_name()));
+    }
+    RecordField proc {fields.size(), record_binding(as_pair(spec)->at("cadr"), "accessor name", interp), std::nullopt};
+    if (length == 3) {
+      proc.modifier = record_binding(as_pair(spec)->at("caddr"), "modifier name", interp);
+    }
+    fields.push_back(field);
+    procedures.push_back(proc);
+  }
+
+  std::optional<Symbol> constructor {};
+  std::vector<size_t> constructor_slots {};
+  const auto ctor_spec = cddr->car;
+  if (is_symbol(ctor_spec)) {
+    constructor = interp.syntax.bind(as_symbol(ctor_spec));
+    for (size_t i = 0; i < fields.size(); i++) {
+      constructor_slots.push_back(i);
+    }
+  }
+  else if (is_pair(ctor_spec)) {
+    constructor = record_binding(as_pair(ctor_spec)->car, "constructor name", interp);
+    for (Obj ls = as_pair(ctor_spec)->cdr; is_pair(ls); ls = as_pair(ls)->cdr) {
+      const auto field = record_symbol(as_pair(ls)->car, "constructor field");
+      const auto found = std::find(fields.begin(), fields.end(), field);
+      if (found == fields.end()) {
+        throw std::runtime_error(std::format("define-record-type: constructor field {} is not a field", field.get_name()));
+      }
+      constructor_slots.push_back(found - fields.begin());
+    }
+  }
+  else if (!is_false(ctor_spec)) {
+    throw std::runtime_error(std::format("define-record-type: bad constructor spec {}", stringify(ctor_spec)));
+  }
+
+  return interp.spawn<DefineRecord>(
+    type_name,
+    std::move(fields),
+    constructor,
+    std::move(constructor_slots),
+    predicate,
+    std::move(procedures)
+  );
+}
+
+static Expression*
+make_delay(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 2, 2, "delay");
+  return interp.spawn<Delay>(build_ast(cons->at("cadr"), interp), false);
+}
+
+static Expression*
+make_delay_force(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 2, 2, "delay-force");
+  return interp.spawn<Delay>(build_ast(cons->at("cadr"), interp), true);
+}
+
+static Expression*
+make_stream_cons(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 3, 3, "stream-cons");
+  return interp.spawn<StreamCons>(build_ast(cons->at("cadr"), interp), build_ast(cons->at("caddr"), interp));
+}
+
+// (stream a b ...) is (stream-cons a (stream b ...))
+static Expression*
+make_stream(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 1, MAXARGS, "stream");
+  ExprList elements = cons2exprs(cons->cdr, interp);
+  Expression *ret = interp.spawn<Variable>(interp.intern_symbol("stream-null"));
+  for (auto element = elements.rbegin(); element != elements.rend(); element++) {
+    ret = interp.spawn<StreamCons>(*element, ret);
+  }
+  return ret;
+}
+
+// a procedure whose body is evaluated lazily, as a stream, when its result
+// is first looked at
+static Expression*
+make_stream_lambda(const Obj& params_cons, const Obj& body_cons, Interpreter& interp) {
+  auto [params, is_variadic] = cons2paramlist(params_cons);
+  SyntaxScope scope {interp, params};
+  const auto body = interp.spawn<Delay>(combine_expr(body_cons, interp), true, true);
+  return interp.spawn<Lambda>(std::move(params), body, is_variadic);
+}
+
+static Expression*
+make_stream_lambda(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 2, MAXARGS, "stream-lambda");
+  const auto cdr = as_pair(cons->cdr);
+  return make_stream_lambda(cdr->car, cdr->cdr, interp);
+}
+
+static Expression*
+make_define_stream(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 3, MAXARGS, "define-stream");
+  const auto cdr = as_pair(cons->cdr);
+  if (!is_pair(cdr->car) || !is_symbol(as_pair(cdr->car)->car)) {
+    throw std::runtime_error(std::format("bad define-stream header: {}", stringify(cdr->car)));
+  }
+  const auto header = as_pair(cdr->car);
+  const auto name = interp.syntax.bind(as_symbol(header->car));
+  return interp.spawn<Define>(name, make_stream_lambda(header->cdr, cdr->cdr, interp));
+}
+
+// for let*, each name is added to scope once its init is built
 static LetBindings
-get_bindings(const Obj& obj, Interpreter& interp) {
+get_bindings(const Obj& obj, Interpreter& interp, SyntaxScope *scope = nullptr) {
   LetBindings ret {};
   auto ls = obj;
 
@@ -267,6 +482,9 @@ get_bindings(const Obj& obj, Interpreter& interp) {
     const auto expr = cdar->car;
 
     ret.emplace_back(name, build_ast(expr, interp));
+    if (scope) {
+      scope->add({name});
+    }
     ls = cons->cdr;
   }
   if (!is_null(ls)) {
@@ -275,24 +493,534 @@ get_bindings(const Obj& obj, Interpreter& interp) {
   return ret;
 }
 
+// what a named let's body may do with its loop name and variables for it to
+// become a Loop. name is unset inside forms that rebind it. locals are the
+// body's internal definitions, which share the loop's frame.
+struct LoopScan {
+  std::optional<Symbol> name;
+  const ParamList& variables;
+  const ParamList& locals;
+  bool ok = true;
+
+  bool is_loop_variable(const Symbol& s) const {
+    return std::find(variables.begin(), variables.end(), s) != variables.end();
+  }
+  bool is_local(const Symbol& s) const {
+    return std::find(locals.begin(), locals.end(), s) != locals.end();
+  }
+  bool is_name(const Symbol& s) const {
+    return name && *name == s;
+  }
+};
+
+static std::vector<Expression*>
+sub_expressions(Expression *expr) {
+  MarkStack children {};
+  expr->push_children(children);
+  std::vector<Expression*> ret {};
+  while (!children.empty()) {
+    if (const auto sub = dynamic_cast<Expression*>(children.top())) {
+      ret.push_back(sub);
+    }
+    children.pop();
+  }
+  return ret;
+}
+
+// every name defined anywhere in expr. the frame a definition lands in is
+// not worked out, so this may name more than the body's own locals.
+static void
+collect_definitions(Expression *expr, ParamList& out) {
+  if (const auto d = dynamic_cast<Define*>(expr)) {
+    out.push_back(d->variable);
+  }
+  for (const auto sub : sub_expressions(expr)) {
+    collect_definitions(sub, out);
+  }
+}
+
+// whether a closure made from expr could see the loop name, a variable, or
+// a local: a closure made in one iteration must not see the next one's
+static bool
+mentions_loop(Expression *expr, const LoopScan& scan) {
+  const auto in_frame = [&](const Symbol& s) {
+    return scan.is_name(s) || scan.is_loop_variable(s) || scan.is_local(s);
+  };
+  if (const auto v = dynamic_cast<Variable*>(expr)) {
+    return in_frame(v->sym);
+  }
+  if (const auto s = dynamic_cast<Set*>(expr)) {
+    if (in_frame(s->variable)) {
+      return true;
+    }
+  }
+  for (const auto sub : sub_expressions(expr)) {
+    if (mentions_loop(sub, scan)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+static void scan_loop_body(Expression*, bool, LoopScan&);
+
+static void
+scan_loop_bindings(const LetBindings& bindings, Expression *body, const bool tail, LoopScan& scan) {
+  bool rebinds_name = false;
+  bool rebinds_variable = false;
+  for (const auto& [sym, init] : bindings) {
+    scan_loop_body(init, false, scan);
+    rebinds_name |= scan.is_name(sym);
+    rebinds_variable |= scan.is_loop_variable(sym);
+  }
+  if (rebinds_name) {
+    LoopScan inner {std::nullopt, scan.variables, scan.locals};
+    scan_loop_body(body, false, inner);
+    scan.ok &= inner.ok;
+  }
+  else {
+    // a recur under a rebound variable could not find the loop's frame
+    scan_loop_body(body, tail && !rebinds_variable, scan);
+  }
+}
+
+// the name must only be called, with one argument per variable, from tail
+// positions of the body; closures must not capture the name or a variable
+static void
+scan_loop_body(Expression *expr, const bool tail, LoopScan& scan) {
+  if (!scan.ok) {
+    return;
+  }
+  if (const auto v = dynamic_cast<Variable*>(expr)) {
+    scan.ok = !scan.is_name(v->sym);
+  }
+  else if (const auto a = dynamic_cast<Application*>(expr)) {
+    const auto op = dynamic_cast<Variable*>(a->op);
+    if (op && scan.is_name(op->sym)) {
+      scan.ok = tail && a->params.size() == scan.variables.size();
+    }
+    else {
+      scan_loop_body(a->op, false, scan);
+    }
+    for (const auto param : a->params) {
+      scan_loop_body(param, false, scan);
+    }
+  }
+  else if (dynamic_cast<Lambda*>(expr) || dynamic_cast<Delay*>(expr) || dynamic_cast<StreamCons*>(expr)) {
+    scan.ok = !mentions_loop(expr, scan);
+  }
+  else if (const auto s = dynamic_cast<Set*>(expr)) {
+    scan.ok = !scan.is_name(s->variable);
+    scan_loop_body(s->value, false, scan);
+  }
+  else if (const auto d = dynamic_cast<Define*>(expr)) {
+    scan.ok = !scan.is_name(d->variable) && !scan.is_loop_variable(d->variable);
+    scan_loop_body(d->value, false, scan);
+  }
+  else if (const auto i = dynamic_cast<If*>(expr)) {
+    scan_loop_body(i->predicate, false, scan);
+    scan_loop_body(i->consequent, tail, scan);
+    scan_loop_body(i->alternative, tail, scan);
+  }
+  else if (const auto b = dynamic_cast<Begin*>(expr)) {
+    for (size_t k = 0; k < b->actions.size(); k++) {
+      scan_loop_body(b->actions[k], tail && k + 1 == b->actions.size(), scan);
+    }
+  }
+  else if (const auto c = dynamic_cast<Cond*>(expr)) {
+    for (const auto& clause : c->clauses) {
+      if (clause.predicate) {
+        scan_loop_body(clause.predicate, false, scan);
+      }
+      if (clause.actions) {
+        scan_loop_body(clause.actions, tail, scan);
+      }
+    }
+  }
+  else if (const auto a = dynamic_cast<And*>(expr)) {
+    for (size_t k = 0; k < a->exprs.size(); k++) {
+      scan_loop_body(a->exprs[k], tail && k + 1 == a->exprs.size(), scan);
+    }
+  }
+  else if (const auto o = dynamic_cast<Or*>(expr)) {
+    for (size_t k = 0; k < o->exprs.size(); k++) {
+      scan_loop_body(o->exprs[k], tail && k + 1 == o->exprs.size(), scan);
+    }
+  }
+  else if (const auto l = dynamic_cast<Let*>(expr)) {
+    scan_loop_bindings(l->bindings, l->body, tail, scan);
+  }
+  else if (const auto l = dynamic_cast<LetSeq*>(expr)) {
+    scan_loop_bindings(l->bindings, l->body, tail, scan);
+  }
+  else if (const auto l = dynamic_cast<LetValues*>(expr)) {
+    bool rebinds_name = false;
+    bool rebinds_variable = false;
+    for (const auto& binding : l->bindings) {
+      scan_loop_body(binding.expr, false, scan);
+      for (const auto& formal : binding.formals) {
+        rebinds_name |= scan.is_name(formal);
+        rebinds_variable |= scan.is_loop_variable(formal);
+      }
+    }
+    if (rebinds_name) {
+      LoopScan inner {std::nullopt, scan.variables, scan.locals};
+      scan_loop_body(l->body, false, inner);
+      scan.ok &= inner.ok;
+    }
+    else {
+      scan_loop_body(l->body, tail && !rebinds_variable, scan);
+    }
+  }
+  else if (const auto g = dynamic_cast<Guard*>(expr)) {
+    scan_loop_body(g->body, false, scan);
+    const bool rebinds = scan.is_name(g->variable) || scan.is_loop_variable(g->variable);
+    LoopScan inner {scan.is_name(g->variable) ? std::nullopt : scan.name, scan.variables, scan.locals};
+    for (const auto& clause : g->clauses) {
+      if (clause.predicate) {
+        scan_loop_body(clause.predicate, false, inner);
+      }
+      if (clause.actions) {
+        scan_loop_body(clause.actions, tail && !rebinds, inner);
+      }
+    }
+    scan.ok &= inner.ok;
+  }
+  else if (const auto l = dynamic_cast<Loop*>(expr)) {
+    // an inner loop takes every NextIteration in its body for its own
+    for (const auto init : l->inits) {
+      scan_loop_body(init, false, scan);
+    }
+    LoopScan inner {scan.is_name(l->name) ? std::nullopt : scan.name, scan.variables, scan.locals};
+    scan_loop_body(l->body, false, inner);
+    scan.ok &= inner.ok;
+  }
+  else {
+    for (const auto sub : sub_expressions(expr)) {
+      scan_loop_body(sub, false, scan);
+    }
+  }
+}
+
+static bool
+binds(const LetBindings& bindings, const Symbol& name) {
+  return std::any_of(bindings.begin(), bindings.end(), [&](const auto& binding) {
+    return binding.first == name;
+  });
+}
+
+// turns the tail calls of the loop name, which the scan found to be the
+// only uses of it, into Recurs. forms that rebind the name are left alone.
+static void
+place_recurs(Expression *&expr, const Symbol name, const ParamList& variables, Interpreter& interp) {
+  if (const auto a = dynamic_cast<Application*>(expr)) {
+    const auto op = dynamic_cast<Variable*>(a->op);
+    if (op && op->sym == name) {
+      expr = interp.spawn<Recur>(variables, a->params);
+    }
+  }
+  else if (const auto i = dynamic_cast<If*>(expr)) {
+    place_recurs(i->consequent, name, variables, interp);
+    place_recurs(i->alternative, name, variables, interp);
+  }
+  else if (const auto b = dynamic_cast<Begin*>(expr)) {
+    if (!b->actions.empty()) {
+      place_recurs(b->actions.back(), name, variables, interp);
+    }
+  }
+  else if (const auto c = dynamic_cast<Cond*>(expr)) {
+    for (auto& clause : c->clauses) {
+      if (clause.actions) {
+        place_recurs(clause.actions, name, variables, interp);
+      }
+    }
+  }
+  else if (const auto a = dynamic_cast<And*>(expr)) {
+    if (!a->exprs.empty()) {
+      place_recurs(a->exprs.back(), name, variables, interp);
+    }
+  }
+  else if (const auto o = dynamic_cast<Or*>(expr)) {
+    if (!o->exprs.empty()) {
+      place_recurs(o->exprs.back(), name, variables, interp);
+    }
+  }
+  else if (const auto l = dynamic_cast<Let*>(expr)) {
+    if (!binds(l->bindings, name)) {
+      place_recurs(l->body, name, variables, interp);
+    }
+  }
+  else if (const auto l = dynamic_cast<LetSeq*>(expr)) {
+    if (!binds(l->bindings, name)) {
+      place_recurs(l->body, name, variables, interp);
+    }
+  }
+  else if (const auto l = dynamic_cast<LetValues*>(expr)) {
+    const bool rebinds = std::any_of(l->bindings.begin(), l->bindings.end(), [&](const ValuesBinding& b) {
+      return std::find(b.formals.begin(), b.formals.end(), name) != b.formals.end();
+    });
+    if (!rebinds) {
+      place_recurs(l->body, name, variables, interp);
+    }
+  }
+  else if (const auto g = dynamic_cast<Guard*>(expr)) {
+    if (g->variable == name) {
+      return;
+    }
+    for (auto& clause : g->clauses) {
+      if (clause.actions) {
+        place_recurs(clause.actions, name, variables, interp);
+      }
+    }
+  }
+}
+
+// a Loop if the body allows it, otherwise the named let's usual meaning:
+// ((letrec ((name (lambda variables body))) name) inits ...)
+static Expression*
+make_loop(Symbol name, ParamList variables, ExprList inits, Expression *body, Interpreter& interp) {
+  ParamList locals {};
+  collect_definitions(body, locals);
+  LoopScan scan {name, variables, locals};
+  scan_loop_body(body, true, scan);
+  if (scan.ok) {
+    place_recurs(body, name, variables, interp);
+    return interp.spawn<Loop>(name, std::move(variables), std::move(inits), body);
+  }
+  const auto proc = interp.spawn<Lambda>(std::move(variables), body, false);
+  const auto binding = interp.spawn<LetSeq>(LetBindings {{name, proc}}, interp.spawn<Variable>(name));
+  return interp.spawn<Application>(binding, std::move(inits));
+}
+
+// turns the calls of name in tail positions of a procedure's body into
+// SelfCalls, counting the frames between each and the procedure's own.
+// returns whether there were any.
+static bool
+place_self_calls(Expression *&expr, const Symbol name, const ParamList& parameters, Repeat *body, const int depth, Interpreter& interp) {
+  if (const auto a = dynamic_cast<Application*>(expr)) {
+    const auto op = dynamic_cast<Variable*>(a->op);
+    if (op && op->sym == name && a->params.size() == parameters.size()) {
+      expr = interp.spawn<SelfCall>(interp.spawn<Recur>(parameters, a->params, depth), a, body);
+      return true;
+    }
+    return false;
+  }
+  bool placed = false;
+  if (const auto i = dynamic_cast<If*>(expr)) {
+    placed |= place_self_calls(i->consequent, name, parameters, body, depth, interp);
+    placed |= place_self_calls(i->alternative, name, parameters, body, depth, interp);
+  }
+  else if (const auto b = dynamic_cast<Begin*>(expr)) {
+    if (!b->actions.empty()) {
+      placed |= place_self_calls(b->actions.back(), name, parameters, body, depth, interp);
+    }
+  }
+  else if (const auto c = dynamic_cast<Cond*>(expr)) {
+    for (auto& clause : c->clauses) {
+      if (clause.actions) {
+        placed |= place_self_calls(clause.actions, name, parameters, body, depth, interp);
+      }
+    }
+  }
+  else if (const auto a = dynamic_cast<And*>(expr)) {
+    if (!a->exprs.empty()) {
+      placed |= place_self_calls(a->exprs.back(), name, parameters, body, depth, interp);
+    }
+  }
+  else if (const auto o = dynamic_cast<Or*>(expr)) {
+    if (!o->exprs.empty()) {
+      placed |= place_self_calls(o->exprs.back(), name, parameters, body, depth, interp);
+    }
+  }
+  else if (const auto l = dynamic_cast<Let*>(expr)) {
+    placed |= place_self_calls(l->body, name, parameters, body, depth + 1, interp);
+  }
+  else if (const auto l = dynamic_cast<LetSeq*>(expr)) {
+    placed |= place_self_calls(l->body, name, parameters, body, depth + 1, interp);
+  }
+  else if (const auto l = dynamic_cast<LetValues*>(expr)) {
+    placed |= place_self_calls(l->body, name, parameters, body, depth + 1, interp);
+  }
+  else if (const auto g = dynamic_cast<Guard*>(expr)) {
+    for (auto& clause : g->clauses) {
+      if (clause.actions) {
+        placed |= place_self_calls(clause.actions, name, parameters, body, depth + 1, interp);
+      }
+    }
+  }
+  return placed;
+}
+
+// (define (name parameter ...) body ...) where no closure can see the
+// procedure's frame: its self tail calls overwrite the frame and repeat the
+// body rather than go through the trampoline to a new frame
+static Expression*
+make_procedure_define(Symbol name, Expression *value, Interpreter& interp) {
+  const auto lambda = dynamic_cast<Lambda*>(value);
+  if (lambda && !lambda->is_variadic) {
+    ParamList locals {};
+    collect_definitions(lambda->body, locals);
+    LoopScan scan {std::nullopt, lambda->parameters, locals};
+    scan_loop_body(lambda->body, false, scan);
+    if (scan.ok) {
+      const auto repeat = interp.spawn<Repeat>(lambda->body);
+      if (place_self_calls(repeat->body, name, lambda->parameters, repeat, 0, interp)) {
+        lambda->body = repeat;
+      }
+    }
+  }
+  return interp.spawn<Define>(name, value);
+}
+
+// (let name ((var init) ...) body ...)
+static Expression*
+make_named_let(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 4, MAXARGS, "named let");
+  const auto cdr = as_pair(cons->cdr);
+  const auto cddr = as_pair(cdr->cdr);
+  ParamList variables {};
+  ExprList inits {};
+  for (auto& [sym, init] : get_bindings(cddr->car, interp)) {
+    variables.push_back(sym);
+    inits.push_back(init);
+  }
+  const auto name = as_symbol(cdr->car);
+  SyntaxScope scope {interp, {name}};
+  scope.add(variables);
+  return make_loop(name, std::move(variables), std::move(inits), combine_expr(cddr->cdr, interp), interp);
+}
+
+// (do ((var init step) ...) (test expr ...) command ...), as the named let
+// (let loop ((var init) ...) (if test (begin expr ...) (begin command ... (loop step ...))))
+// where a variable without a step is passed on unchanged
+static Expression*
+make_do(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 3, MAXARGS, "do");
+  const auto cdr = as_pair(cons->cdr);
+  const auto cddr = as_pair(cdr->cdr);
+  ParamList variables {};
+  ExprList inits {};
+  Obj ls = cdr->car;
+  while (is_pair(ls)) {
+    const auto spec = as_pair(ls)->car;
+    const auto length = is_pair(spec) ? list_length(spec) : 0;
+    if ((length != 2 && length != 3) || !is_symbol(as_pair(spec)->car)) {
+      throw std::runtime_error("do bindings must be (variable init) or (variable init step)");
+    }
+    variables.push_back(as_symbol(as_pair(spec)->car));
+    inits.push_back(build_ast(as_pair(spec)->at("cadr"), interp));
+    ls = as_pair(ls)->cdr;
+  }
+  if (!is_null(ls)) {
+    throw std::runtime_error("do bindings must be a proper list");
+  }
+  SyntaxScope scope {interp, variables};
+  ExprList steps {};
+  size_t i = 0;
+  for (ls = cdr->car; is_pair(ls); ls = as_pair(ls)->cdr, i++) {
+    const auto spec = as_pair(ls)->car;
+    steps.push_back(is_pair(as_pair(as_pair(spec)->cdr)->cdr) ? build_ast(as_pair(spec)->at("caddr"), interp) : interp.spawn<Variable>(variables[i]));
+  }
+  if (!is_pair(cddr->car) || !is_list(cddr->car)) {
+    throw std::runtime_error("do expects a test clause");
+  }
+  const auto exit = as_pair(cddr->car);
+
+  // not a symbol the reader can produce, so the body cannot refer to it
+  const auto name = interp.intern_symbol("do loop");
+  auto commands = cons2exprs(cddr->cdr, interp);
+  commands.push_back(interp.spawn<Application>(interp.spawn<Variable>(name), std::move(steps)));
+  const auto body = interp.spawn<If>(
+    build_ast(exit->car, interp),
+    combine_expr(exit->cdr, interp),
+    interp.spawn<Begin>(std::move(commands))
+  );
+  return make_loop(name, std::move(variables), std::move(inits), body, interp);
+}
+
 static Expression*
 make_let(Cons *cons, Interpreter& interp) {
   assert_size(cons, 2, MAXARGS, "let");
   const auto cdr = as_pair(cons->cdr);
-  return interp.spawn<Let>(
-    get_bindings(cdr->car, interp),
-    combine_expr(cdr->cdr, interp)
-  );
+  if (is_symbol(cdr->car)) {
+    return make_named_let(cons, interp);
+  }
+  auto bindings = get_bindings(cdr->car, interp);
+  SyntaxScope scope {interp};
+  for (const auto& [sym, init] : bindings) {
+    scope.add({sym});
+  }
+  return interp.spawn<Let>(std::move(bindings), combine_expr(cdr->cdr, interp));
 }
 
 static Expression*
 make_let_seq(Cons *cons, Interpreter& interp) {
   assert_size(cons, 2, MAXARGS, "let*");
   const auto cdr = as_pair(cons->cdr);
-  return interp.spawn<LetSeq>(
-    get_bindings(cdr->car, interp),
-    combine_expr(cdr->cdr, interp)
-  );
+  SyntaxScope scope {interp};
+  auto bindings = get_bindings(cdr->car, interp, &scope);
+  return interp.spawn<LetSeq>(std::move(bindings), combine_expr(cdr->cdr, interp));
+}
+
+// each clause's formals are added to scope once it is built, for
+// let*-values, or after all of them are, for let-values
+static std::vector<ValuesBinding>
+get_values_bindings(const Obj& obj, Interpreter& interp, SyntaxScope& scope, const bool sequential) {
+  std::vector<ValuesBinding> ret {};
+  Obj ls = obj;
+  while (is_pair(ls)) {
+    const auto binding = as_pair(ls)->car;
+    if (!is_pair(binding) || list_length(binding) != 2) {
+      throw std::runtime_error("let-values bindings must be represented as 2-element lists");
+    }
+    auto [formals, is_variadic] = cons2paramlist(as_pair(binding)->car);
+    ret.push_back({std::move(formals), is_variadic, build_ast(as_pair(as_pair(binding)->cdr)->car, interp)});
+    if (sequential) {
+      scope.add(ret.back().formals);
+    }
+    ls = as_pair(ls)->cdr;
+  }
+  if (!is_null(ls)) {
+    throw std::runtime_error("let-values bindings must be a proper list");
+  }
+  if (!sequential) {
+    for (const auto& binding : ret) {
+      scope.add(binding.formals);
+    }
+  }
+  return ret;
+}
+
+// (let-values ((formals expr) ...) body ...)
+static Expression*
+make_let_values(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 2, MAXARGS, "let-values");
+  const auto cdr = as_pair(cons->cdr);
+  SyntaxScope scope {interp};
+  auto bindings = get_values_bindings(cdr->car, interp, scope, false);
+  return interp.spawn<LetValues>(std::move(bindings), false, combine_expr(cdr->cdr, interp));
+}
+
+static Expression*
+make_let_values_seq(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 2, MAXARGS, "let*-values");
+  const auto cdr = as_pair(cons->cdr);
+  SyntaxScope scope {interp};
+  auto bindings = get_values_bindings(cdr->car, interp, scope, true);
+  return interp.spawn<LetValues>(std::move(bindings), true, combine_expr(cdr->cdr, interp));
+}
+
+// (receive formals expr body ...), as in SRFI 8
+static Expression*
+make_receive(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 3, MAXARGS, "receive");
+  const auto cdr = as_pair(cons->cdr);
+  const auto cddr = as_pair(cdr->cdr);
+  auto [formals, is_variadic] = cons2paramlist(cdr->car);
+  std::vector<ValuesBinding> bindings {};
+  bindings.push_back({std::move(formals), is_variadic, build_ast(cddr->car, interp)});
+  SyntaxScope scope {interp, bindings.back().formals};
+  return interp.spawn<LetValues>(std::move(bindings), false, combine_expr(cddr->cdr, interp));
 }
 
 static Expression*
@@ -357,6 +1085,60 @@ make_cond(Cons *cons, Interpreter& interp) {
   return interp.spawn<Cond>(std::move(clauses));
 }
 
+// (parameterize ((param value) ...) body ...)
+static Expression*
+make_parameterize(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 3, MAXARGS, "parameterize");
+  const auto cdr = as_pair(cons->cdr);
+  std::vector<std::pair<Expression*, Expression*>> bindings {};
+  Obj ls = cdr->car;
+  while (is_pair(ls)) {
+    const auto binding = as_pair(ls)->car;
+    if (!is_pair(binding) || list_length(binding) != 2) {
+      throw std::runtime_error("parameterize bindings must be represented as 2-element lists");
+    }
+    bindings.emplace_back(
+      build_ast(as_pair(binding)->car, interp),
+      build_ast(as_pair(as_pair(binding)->cdr)->car, interp)
+    );
+    ls = as_pair(ls)->cdr;
+  }
+  if (!is_null(ls)) {
+    throw std::runtime_error("parameterize bindings must be a proper list");
+  }
+  return interp.spawn<Parameterize>(std::move(bindings), combine_expr(cdr->cdr, interp));
+}
+
+// (guard (var clause ...) body ...), with cond clauses
+static Expression*
+make_guard(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 3, MAXARGS, "guard");
+  const auto cdr = as_pair(cons->cdr);
+  if (!is_pair(cdr->car) || !is_symbol(as_pair(cdr->car)->car)) {
+    throw std::runtime_error("guard expects a variable and clauses");
+  }
+  const auto spec = as_pair(cdr->car);
+  const auto body = combine_expr(cdr->cdr, interp);
+  SyntaxScope scope {interp, {as_symbol(spec->car)}};
+  std::vector<Clause> clauses {};
+  Obj obj = spec->cdr;
+  while (is_pair(obj)) {
+    const auto cons = as_pair(obj);
+    if (!is_pair(cons->car)) {
+      throw std::runtime_error("bad form for guard clause");
+    }
+    clauses.push_back(make_clause(as_pair(cons->car), interp));
+    if (clauses.back().is_else && !is_null(cons->cdr)) {
+      throw std::runtime_error("no clauses allowed after else clause");
+    }
+    obj = cons->cdr;
+  }
+  if (!is_null(obj)) {
+    throw std::runtime_error("guard clauses are an improper list");
+  }
+  return interp.spawn<Guard>(as_symbol(spec->car), std::move(clauses), body);
+}
+
 static Expression*
 make_application(Cons *cons, Interpreter& interp) {
   assert_size(cons, 1, MAXARGS, std::format("{} application", stringify(cons->car)));
@@ -378,6 +1160,90 @@ make_or(Cons *cons, Interpreter& interp) {
   return interp.spawn<Or>(cons2exprs(cons->cdr, interp));
 }
 
+// (define-syntax keyword (syntax-rules ...))
+static Expression*
+make_define_syntax(Cons *cons, Interpreter& interp) {
+  assert_size(cons, 3, 3, "define-syntax");
+  const auto cdr = as_pair(cons->cdr);
+  if (!is_symbol(cdr->car)) {
+    throw std::runtime_error(std::format("define-syntax: keyword must be a symbol: {}", stringify(cdr->car)));
+  }
+  const auto macro = make_macro(cons->at("caddr"), interp.syntax.at_top_level(), interp);
+  interp.syntax.define_macro(as_symbol(cdr->car), macro);
+  return interp.spawn<Literal>(Void {});
+}
+
+// (let-syntax ((keyword (syntax-rules ...)) ...) body ...). the body is
+// spliced into the surrounding one, so its definitions are not local to it.
+// letrec-syntax transformers may use each other's keywords.
+static Expression*
+make_syntax_binding(Cons *cons, const bool recursive, Interpreter& interp) {
+  assert_size(cons, 2, MAXARGS, recursive ? "letrec-syntax" : "let-syntax");
+  const auto cdr = as_pair(cons->cdr);
+  std::vector<std::pair<Symbol, Obj>> specs {};
+  Obj ls = cdr->car;
+  for (; is_pair(ls); ls = as_pair(ls)->cdr) {
+    const auto binding = as_pair(ls)->car;
+    if (!is_pair(binding) || list_length(binding) != 2 || !is_symbol(as_pair(binding)->car)) {
+      throw std::runtime_error("syntax bindings must be (keyword transformer)");
+    }
+    specs.emplace_back(as_symbol(as_pair(binding)->car), as_pair(binding)->at("cadr"));
+  }
+  if (!is_null(ls)) {
+    throw std::runtime_error("syntax bindings must be a proper list");
+  }
+  std::vector<Macro*> macros {};
+  SyntaxScope scope {interp, {}, false};
+  for (const auto& [keyword, spec] : specs) {
+    macros.push_back(make_macro(spec, false, interp));
+    if (recursive) {
+      scope.add_macro(keyword, macros.back());
+    }
+  }
+  for (size_t i = 0; i < specs.size(); i++) {
+    scope.add_macro(specs[i].first, macros[i]);
+  }
+  return combine_expr(cdr->cdr, interp);
+}
+
+static Expression*
+make_let_syntax(Cons *cons, Interpreter& interp) {
+  return make_syntax_binding(cons, false, interp);
+}
+
+static Expression*
+make_letrec_syntax(Cons *cons, Interpreter& interp) {
+  return make_syntax_binding(cons, true, interp);
+}
+
+static Expression*
+report_syntax_rules(Cons*, Interpreter&) {
+  throw std::runtime_error("misplaced syntax-rules: it may only appear as a transformer");
+}
+
+// the names a body defines are its variables from its start, so forms
+// before a definition already see it shadow any macro or outer variable
+static void
+declare_definitions(const Obj& seq, Interpreter& interp) {
+  for (Obj ls = seq; is_pair(ls); ls = as_pair(ls)->cdr) {
+    const auto form = as_pair(ls)->car;
+    if (!is_pair(form) || !is_symbol(as_pair(form)->car) || !is_pair(as_pair(form)->cdr)) {
+      continue;
+    }
+    const auto keyword = interp.syntax.get_keyword(as_symbol(as_pair(form)->car));
+    if (!keyword || keyword->get_name() != "define" || interp.syntax.get_macro(as_symbol(as_pair(form)->car))) {
+      continue;
+    }
+    auto target = as_pair(as_pair(form)->cdr)->car;
+    if (is_pair(target)) {
+      target = as_pair(target)->car;
+    }
+    if (is_symbol(target)) {
+      interp.syntax.bind(as_symbol(target));
+    }
+  }
+}
+
 Expression*
 combine_expr(const Obj& seq, Interpreter& interp) {
   if (is_null(seq)) {
@@ -387,6 +1253,9 @@ combine_expr(const Obj& seq, Interpreter& interp) {
     return build_ast(as_pair(seq)->car, interp);
   }
   else {
+    if (!interp.syntax.at_top_level()) {
+      declare_definitions(seq, interp);
+    }
     return interp.spawn<Begin>(cons2exprs(seq, interp));
   }
 }
@@ -399,16 +1268,35 @@ special_forms = {
   {"unquote-splicing", report_unquote_splicing},
   {"set!", make_set},
   {"define", make_define},
+  {"define-record-type", make_define_record},
+  {"delay", make_delay},
+  {"delay-force", make_delay_force},
+  {"stream-cons", make_stream_cons},
+  {"stream", make_stream},
+  {"stream-lambda", make_stream_lambda},
+  {"define-stream", make_define_stream},
   {"if", make_if},
+  {"when", make_when},
+  {"unless", make_unless},
   {"lambda", make_lambda},
   {"let", make_let},
   {"let*", make_let_seq},
   {"letrec", make_let}, // they're the same in this implementation
   {"letrec*", make_let_seq}, 
+  {"let-values", make_let_values},
+  {"let*-values", make_let_values_seq},
+  {"receive", make_receive},
   {"begin", make_begin},
+  {"do", make_do},
   {"cond", make_cond},
+  {"guard", make_guard},
+  {"parameterize", make_parameterize},
   {"and", make_and},
   {"or", make_or},
+  {"define-syntax", make_define_syntax},
+  {"let-syntax", make_let_syntax},
+  {"letrec-syntax", make_letrec_syntax},
+  {"syntax-rules", report_syntax_rules},
 };
 
 Expression*
@@ -417,16 +1305,21 @@ build_ast(const Obj& obj, Interpreter& interp) {
     const auto p = as_pair(obj);
     if (is_symbol(p->car)) {
       const auto tag = as_symbol(p->car);
-      const auto found = special_forms.find(tag.get_name());
-      if (found != special_forms.end()) {
-        const auto func = found->second;
-        return func(p, interp);
+      if (const auto macro = interp.syntax.get_macro(tag)) {
+        return build_ast(interp.syntax.expand(macro, obj, interp), interp);
+      }
+      if (const auto keyword = interp.syntax.get_keyword(tag)) {
+        const auto found = special_forms.find(keyword->get_name());
+        if (found != special_forms.end()) {
+          const auto func = found->second;
+          return func(p, interp);
+        }
       }
     }
     return make_application(p, interp);
   }
   else if (is_symbol(obj))
-    return interp.spawn<Variable>(as_symbol(obj));
+    return interp.syntax.make_reference(as_symbol(obj), interp);
   else
     return interp.spawn<Literal>(obj);
 }
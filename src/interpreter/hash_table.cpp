@@ -0,0 +1,150 @@
+#include <interpreter/types.hpp>
+#include <interpreter/hash_table.hpp>
+
+namespace Scheme {
+
+static constexpr size_t MIN_CAPACITY = 8;
+
+HashTable::HashTable(Kind kind):
+  slots {},
+  count {0},
+  kind {kind}
+{}
+
+size_t
+HashTable::hash_key(const Obj& key) const {
+  switch (kind) {
+    case Kind::EQ:
+    case Kind::EQV:
+      return eqv_hash(key);
+    case Kind::EQUAL:
+      return equal_hash(key);
+    case Kind::STRING:
+      if (!is_string(key)) {
+        throw std::runtime_error("string hash table key must be a string, got " + stringify(key));
+      }
+      return string_hash(as_string(key)->data);
+  }
+  return 0;
+}
+
+bool
+HashTable::same_key(const Obj& a, const Obj& b) const {
+  switch (kind) {
+    case Kind::EQ:
+    case Kind::EQV:
+      return a == b;
+    case Kind::EQUAL:
+      return equal(a, b);
+    case Kind::STRING:
+      return as_string(a)->data == as_string(b)->data;
+  }
+  return false;
+}
+
+// index of the slot holding key, or of the empty slot ending its probe run
+size_t
+HashTable::find_slot(const Obj& key, const size_t hash) const {
+  const size_t mask = slots.size() - 1;
+  size_t i = hash & mask;
+  while (slots[i].full) {
+    if (slots[i].hash == hash && same_key(slots[i].key, key)) {
+      return i;
+    }
+    i = (i + 1) & mask;
+  }
+  return i;
+}
+
+void
+HashTable::grow() {
+  const size_t capacity = slots.empty() ? MIN_CAPACITY : 2 * slots.size();
+  std::vector<Slot> old(capacity, Slot {Void {}, Void {}, 0, false});
+  old.swap(slots);
+  const size_t mask = capacity - 1;
+  for (auto& slot : old) {
+    if (slot.full) {
+      size_t i = slot.hash & mask;
+      while (slots[i].full) {
+        i = (i + 1) & mask;
+      }
+      slots[i] = std::move(slot);
+    }
+  }
+}
+
+Obj*
+HashTable::find(const Obj& key) {
+  if (count == 0) {
+    return nullptr;
+  }
+  const auto i = find_slot(key, hash_key(key));
+  return slots[i].full ? &slots[i].value : nullptr;
+}
+
+void
+HashTable::set(const Obj& key, Obj value) {
+  const auto hash = hash_key(key);
+  // keep the load factor at or below 3/4
+  if (4 * (count + 1) > 3 * slots.size()) {
+    grow();
+  }
+  auto& slot = slots[find_slot(key, hash)];
+  if (!slot.full) {
+    slot = Slot {key, std::move(value), hash, true};
+    count++;
+  }
+  else {
+    slot.value = std::move(value);
+  }
+}
+
+bool
+HashTable::erase(const Obj& key) {
+  if (count == 0) {
+    return false;
+  }
+  const size_t mask = slots.size() - 1;
+  size_t i = find_slot(key, hash_key(key));
+  if (!slots[i].full) {
+    return false;
+  }
+  // backward-shift every entry of the run that would otherwise become
+  // unreachable from its home slot
+  size_t j = i;
+  while (true) {
+    j = (j + 1) & mask;
+    if (!slots[j].full) {
+      break;
+    }
+    const size_t home = slots[j].hash & mask;
+    const bool reachable = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+    if (!reachable) {
+      slots[i] = std::move(slots[j]);
+      i = j;
+    }
+  }
+  slots[i] = Slot {Void {}, Void {}, 0, false};
+  count--;
+  return true;
+}
+
+void
+HashTable::clear() {
+  slots.clear();
+  count = 0;
+}
+
+std::vector<std::pair<Obj, Obj>, ScannedAllocator<std::pair<Obj, Obj>>>
+HashTable::entries() const {
+  decltype(entries()) ret {};
+  ret.reserve(count);
+  for (const auto& slot : slots) {
+    if (slot.full) {
+      ret.emplace_back(slot.key, slot.value);
+    }
+  }
+  return ret;
+}
+
+}
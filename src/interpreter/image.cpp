@@ -0,0 +1,1395 @@
+#include <interpreter/types.hpp>
+#include <interpreter/environment.hpp>
+#include <interpreter/evaluation.hpp>
+#include <interpreter/expressions.hpp>
+#include <interpreter/image.hpp>
+#include <interpreter/interpreter.hpp>
+#include <interpreter/macros.hpp>
+#include <interpreter/memory.hpp>
+#include <algorithm>
+#include <bit>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iterator>
+#include <list>
+#include <format>
+#include <type_traits>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Scheme {
+
+// an image is a header, then its symbols, bytevector storage, records, the
+// global bindings and the top-level macros, all little-endian
+static constexpr char IMAGE_MAGIC[8] = {'S', 'C', 'M', 'I', 'M', 'A', 'G', 'E'};
+static constexpr uint32_t IMAGE_VERSION = 1;
+static constexpr uint32_t NO_OBJECT = UINT32_MAX;
+
+// the objects every interpreter makes for itself, numbered before the
+// builtins. an image refers to these rather than holding them.
+static std::vector<HeapEntity*>
+known_objects(Interpreter& interp) {
+  std::vector<HeapEntity*> ret {
+    interp.get_global_env(),
+    interp.get_error_type(),
+    interp.get_eof_object(),
+    interp.get_eof_object()->type,
+    interp.get_values_marker(),
+    interp.get_values_marker()->type
+  };
+  ret.insert(ret.end(), interp.builtins.begin(), interp.builtins.end());
+  return ret;
+}
+
+ImageWriter::ImageWriter(Interpreter& interp):
+  interp {interp},
+  ids {},
+  written {},
+  pending {},
+  symbol_ids {},
+  symbols {},
+  symbol_count {0},
+  storages {},
+  objects {},
+  object_count {0},
+  out {}
+{
+  for (const auto ent : known_objects(interp)) {
+    ids.emplace(ent, ids.size());
+    written.insert(ent);
+  }
+}
+
+void
+ImageWriter::put_kind(const ImageKind kind) {
+  put_u8(static_cast<uint8_t>(kind));
+}
+
+void
+ImageWriter::put_u8(const uint8_t n) {
+  out.push_back(static_cast<char>(n));
+}
+
+void
+ImageWriter::put_u32(const uint32_t n) {
+  for (int i = 0; i < 4; i++) {
+    put_u8(n >> (8 * i));
+  }
+}
+
+void
+ImageWriter::put_u64(const uint64_t n) {
+  for (int i = 0; i < 8; i++) {
+    put_u8(n >> (8 * i));
+  }
+}
+
+void
+ImageWriter::put_string(const std::string& str) {
+  put_u64(str.size());
+  out.append(str);
+}
+
+// a symbol is numbered the first time it is written. an alias is written
+// after the symbol it was renamed from, so it can be made again from it.
+void
+ImageWriter::put_symbol(const Symbol& sym) {
+  auto found = symbol_ids.find(sym);
+  if (found == symbol_ids.end()) {
+    std::string entry {};
+    if (const auto alias = interp.syntax.get_alias(sym)) {
+      std::swap(entry, out);
+      put_u8(1);
+      put_symbol(alias->original);
+      put_u8(alias->top_level);
+      std::swap(entry, out);
+    }
+    else {
+      std::swap(entry, out);
+      put_u8(0);
+      put_string(sym.get_name());
+      std::swap(entry, out);
+    }
+    symbols.append(entry);
+    found = symbol_ids.emplace(sym, symbol_count++).first;
+  }
+  put_u32(found->second);
+}
+
+void
+ImageWriter::put_symbols(const std::vector<Symbol>& syms) {
+  put_u32(syms.size());
+  for (const auto& sym : syms) {
+    put_symbol(sym);
+  }
+}
+
+uint32_t
+ImageWriter::id_of(const HeapEntity *ent, const Entity& entity) {
+  auto found = ids.find(ent);
+  if (found == ids.end()) {
+    found = ids.emplace(ent, ids.size()).first;
+    pending.push_back(entity);
+  }
+  return found->second;
+}
+
+uint32_t
+ImageWriter::dep(const HeapEntity *ent, const Entity& entity) {
+  const auto id = id_of(ent, entity);
+  if (!written.contains(ent)) {
+    write_record(entity);
+  }
+  return id;
+}
+
+void
+ImageWriter::put_obj(const Obj& obj) {
+  put_u8(obj.index());
+  std::visit(Overloaded {
+    [&](const bool b) {put_u8(b);},
+    [&](const double d) {put_u64(std::bit_cast<uint64_t>(d));},
+    [&](const char c) {put_u8(c);},
+    [&](const Symbol& sym) {put_symbol(sym);},
+    [&](const Null) {},
+    [&](const Void) {},
+    [&](Coroutine*) {
+      throw std::runtime_error("save-image: generators cannot be saved");
+    },
+    [&](Builtin *b) {
+      if (!ids.contains(b) && b->role == RecordRole::NONE) {
+        throw std::runtime_error("save-image: continuations cannot be saved");
+      }
+      put_u32(id_of(b, obj));
+    },
+    [&](const auto *p) {put_u32(id_of(p, obj));},
+  }, obj);
+}
+
+void
+ImageWriter::put_expr(Expression *expr) {
+  put_u32(expr ? dep(expr, expr) : NO_OBJECT);
+}
+
+void
+ImageWriter::put_exprs(const std::vector<Expression*>& exprs) {
+  put_u32(exprs.size());
+  for (const auto expr : exprs) {
+    put_expr(expr);
+  }
+}
+
+void
+ImageWriter::put_expr_ref(Expression *expr) {
+  put_u32(id_of(expr, expr));
+}
+
+// each record is its number and kind, then what makes it. the records it
+// depends on are written out first, while it is built up on the side.
+void
+ImageWriter::write_record(const Entity& entity) {
+  std::string outer {};
+  std::swap(outer, out);
+  std::visit(Overloaded {
+    [&](const Obj& obj) {
+      auto copy = obj;
+      const auto ent = try_get_heap_entity(copy);
+      written.insert(ent);
+      put_u32(ids.at(ent));
+      write_heap_obj(obj);
+    },
+    [&](const auto *ent) {
+      written.insert(ent);
+      put_u32(ids.at(ent));
+      write_entity(entity);
+    }
+  }, entity);
+  std::swap(outer, out);
+  objects.append(outer);
+  object_count++;
+}
+
+void
+ImageWriter::write_heap_obj(const Obj& obj) {
+  std::visit(Overloaded {
+    [&](String *s) {
+      put_kind(ImageKind::STRING);
+      put_string(s->data);
+    },
+    [&](StringPort *p) {
+      put_kind(ImageKind::STRING_PORT);
+      put_string(p->buffer);
+    },
+    [&](Cons *c) {
+      put_kind(ImageKind::CONS);
+      put_obj(c->car);
+      put_obj(c->cdr);
+    },
+    [&](Vector *v) {
+      put_kind(ImageKind::VECTOR);
+      put_u64(v->data.size());
+      for (const auto& item : v->data) {
+        put_obj(item);
+      }
+    },
+    // the storage shared by bytevectors and their slices is written once,
+    // as far as they reach into it
+    [&](Bytevector *b) {
+      const auto start = static_cast<size_t>(b->data() - b->storage_start());
+      auto& storage = storages.try_emplace(b->storage_start(), Storage {static_cast<uint32_t>(storages.size()), start, start + b->size()}).first->second;
+      storage.start = std::min(storage.start, start);
+      storage.end = std::max(storage.end, start + b->size());
+      put_kind(ImageKind::BYTEVECTOR);
+      put_u32(storage.id);
+      put_u64(start);
+      put_u64(b->size());
+    },
+    [&](HashTable *t) {
+      put_kind(ImageKind::HASH_TABLE);
+      put_u8(static_cast<uint8_t>(t->kind));
+      const auto entries = t->entries();
+      put_u64(entries.size());
+      for (const auto& [key, value] : entries) {
+        put_obj(key);
+        put_obj(value);
+      }
+    },
+    // the trie is built again on loading, as hashes need not survive
+    [&](PersistentMap *m) {
+      put_kind(ImageKind::PMAP);
+      put_u8(m->is_set);
+      put_u8(m->transient);
+      const auto leaves = m->leaves();
+      put_u64(leaves.size());
+      for (const auto leaf : leaves) {
+        put_obj(leaf->key);
+        put_obj(leaf->value);
+      }
+    },
+    [&](RecordType *t) {
+      put_kind(ImageKind::RECORD_TYPE);
+      put_symbol(t->name);
+      put_symbols(t->fields);
+      put_u64(t->constructor_slots.size());
+      for (const auto slot : t->constructor_slots) {
+        put_u64(slot);
+      }
+    },
+    [&](Record *r) {
+      put_kind(ImageKind::RECORD);
+      put_u32(dep(r->type, r->type));
+      for (size_t i = 0; i < r->type->fields.size(); i++) {
+        put_obj(r->slots()[i]);
+      }
+    },
+    [&](Promise *p) {
+      put_kind(ImageKind::PROMISE);
+      put_u8(p->stream);
+      put_u32(id_of(p->state, p->state));
+    },
+    [&](Builtin *b) {
+      put_kind(ImageKind::RECORD_PROCEDURE);
+      put_u8(static_cast<uint8_t>(b->role));
+      put_u32(dep(b->record_type, b->record_type));
+      put_u64(b->slot);
+    },
+    [&](Procedure *p) {
+      put_kind(ImageKind::PROCEDURE);
+      put_symbols(p->parameters);
+      put_u8(p->is_variadic);
+      put_u32(dep(p->env, p->env));
+      put_expr(p->body);
+    },
+    [&](Parameter *p) {
+      put_kind(ImageKind::PARAMETER);
+      put_obj(p->value);
+      put_obj(p->converter);
+    },
+    [&](const auto&) {
+      throw std::runtime_error(std::format("save-image: cannot save {}", stringify(obj)));
+    }
+  }, obj);
+}
+
+void
+ImageWriter::write_entity(const Entity& entity) {
+  std::visit(Overloaded {
+    [&](const Obj&) {},
+    [&](Environment *env) {
+      put_kind(ImageKind::ENVIRONMENT);
+      put_u32(env->super ? dep(env->super, env->super) : NO_OBJECT);
+      put_u64(env->bindings().size());
+      for (const auto& [sym, value] : env->bindings()) {
+        put_symbol(sym);
+        put_obj(value);
+      }
+    },
+    [&](Expression *expr) {
+      expr->save(*this);
+    },
+    [&](PromiseState *state) {
+      if (state->step) {
+        throw std::runtime_error("save-image: streams from the stream library cannot be saved before they are forced");
+      }
+      put_kind(ImageKind::PROMISE_STATE);
+      put_u8(state->done);
+      put_u8(state->lazy);
+      put_obj(state->value);
+      put_u32(state->expr ? id_of(state->expr, state->expr) : NO_OBJECT);
+      put_u32(state->env ? id_of(state->env, state->env) : NO_OBJECT);
+    },
+    [&](Macro *macro) {
+      put_kind(ImageKind::MACRO);
+      put_symbol(macro->ellipsis);
+      put_u8(macro->has_ellipsis);
+      put_symbols(macro->literals);
+      put_u8(macro->top_level);
+      put_u64(macro->rules.size());
+      for (const auto& [pattern, tmpl] : macro->rules) {
+        put_obj(pattern);
+        put_obj(tmpl);
+      }
+    }
+  }, entity);
+}
+
+// written to a temporary file first, so a failed save leaves any image
+// already at path as it was
+void
+ImageWriter::save(const std::string& path) {
+  std::string globals {};
+  std::swap(globals, out);
+  const auto& bindings = interp.get_global_env()->bindings();
+  put_u64(bindings.size());
+  for (const auto& [sym, value] : bindings) {
+    put_symbol(sym);
+    put_obj(value);
+  }
+  std::vector<std::pair<Symbol, Macro*>> macros {};
+  for (const auto& [sym, macro] : interp.syntax.top_level_macros()) {
+    if (macro) {
+      macros.emplace_back(sym, macro);
+    }
+  }
+  put_u64(macros.size());
+  for (const auto& [sym, macro] : macros) {
+    put_symbol(sym);
+    put_u32(id_of(macro, macro));
+  }
+  std::swap(globals, out);
+
+  while (!pending.empty()) {
+    const auto entity = pending.back();
+    pending.pop_back();
+    const auto written_already = std::visit(Overloaded {
+      [&](const Obj& obj) {
+        auto copy = obj;
+        return written.contains(try_get_heap_entity(copy));
+      },
+      [&](const auto *ent) {
+        return written.contains(ent);
+      }
+    }, entity);
+    if (!written_already) {
+      write_record(entity);
+    }
+  }
+
+  std::string storage {};
+  std::swap(storage, out);
+  for (const auto& [base, s] : storages) {
+    put_u32(s.id);
+    put_u64(s.start);
+    put_string(std::string(reinterpret_cast<const char*>(base) + s.start, s.end - s.start));
+  }
+  std::swap(storage, out);
+
+  out.append(IMAGE_MAGIC, sizeof(IMAGE_MAGIC));
+  put_u32(IMAGE_VERSION);
+  put_u32(interp.builtins.size());
+  put_u32(symbol_count);
+  put_u32(storages.size());
+  put_u32(ids.size());
+  put_u32(object_count);
+
+  const auto temp = path + ".tmp";
+  {
+    std::ofstream file {temp, std::ios::binary | std::ios::trunc};
+    for (const auto section : {&out, &symbols, &storage, &objects, &globals}) {
+      file.write(section->data(), section->size());
+    }
+    if (!file) {
+      throw std::runtime_error(std::format("save-image: could not write {}", temp));
+    }
+  }
+  std::error_code error {};
+  std::filesystem::rename(temp, path, error);
+  if (error) {
+    throw std::runtime_error(std::format("save-image: could not write {}: {}", path, error.message()));
+  }
+}
+
+void
+save_image(const std::string& path, Interpreter& interp) {
+  ImageWriter(interp).save(path);
+}
+
+namespace {
+
+// the image's bytes, mapped so that pages are read in as loading reaches
+// them, or read whole where the file cannot be mapped
+class ImageFile {
+private:
+  void *mapping;
+  size_t length;
+  std::string contents;
+
+public:
+  explicit ImageFile(const std::string& path):
+    mapping {MAP_FAILED},
+    length {0},
+    contents {}
+  {
+    const int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      throw std::runtime_error(std::format("could not open image {}", path));
+    }
+    struct stat st;
+    if (fstat(fd, &st) == 0 && st.st_size > 0) {
+      length = st.st_size;
+      mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    }
+    close(fd);
+    if (mapping == MAP_FAILED) {
+      std::ifstream file {path, std::ios::binary};
+      contents.assign(std::istreambuf_iterator<char>(file), std::istreambuf_iterator<char>());
+    }
+  }
+
+  ~ImageFile() {
+    if (mapping != MAP_FAILED) {
+      munmap(mapping, length);
+    }
+  }
+
+  ImageFile(const ImageFile&) = delete;
+  ImageFile& operator=(const ImageFile&) = delete;
+
+  const char *data() const {
+    return mapping != MAP_FAILED ? static_cast<const char*>(mapping) : contents.data();
+  }
+
+  size_t size() const {
+    return mapping != MAP_FAILED ? length : contents.size();
+  }
+};
+
+// the heap pointer alternative of Obj at index, checked against what ent is
+template<size_t I = 0>
+Obj
+heap_obj(const size_t index, HeapEntity *ent) {
+  if constexpr (I == std::variant_size_v<Obj>) {
+    throw std::runtime_error("image is corrupt: bad object reference");
+  }
+  else {
+    using T = std::variant_alternative_t<I, Obj>;
+    if constexpr (std::is_pointer_v<T>) {
+      if (index == I) {
+        const auto ret = dynamic_cast<T>(ent);
+        if (!ret) {
+          throw std::runtime_error("image is corrupt: object of the wrong kind");
+        }
+        return Obj {std::in_place_index<I>, ret};
+      }
+    }
+    return heap_obj<I + 1>(index, ent);
+  }
+}
+
+// makes the objects of an image in the order they were written. a reference
+// to an object not made yet is noted, and filled in once every record has
+// been read; hash tables and persistent maps are filled last of all, when
+// the keys they hash are complete.
+class ImageReader {
+private:
+  struct Fixup {
+    Obj *slot;
+    uint32_t id;
+    uint8_t index;
+  };
+  struct Entries {
+    std::variant<HashTable*, PersistentMap*> target;
+    bool transient;
+    std::vector<std::pair<Obj, Obj>> entries;
+  };
+
+  Interpreter& interp;
+  const char *pos;
+  const char *end;
+  std::vector<Symbol> symbols;
+  std::vector<Bytevector*> storages;
+  std::vector<size_t> storage_starts;
+  std::vector<HeapEntity*> table;
+  std::vector<Fixup> fixups;
+  std::vector<std::function<void()>> pointer_fixups;
+  std::list<Entries> entries;
+
+  void need(const size_t n) {
+    if (static_cast<size_t>(end - pos) < n) {
+      throw std::runtime_error("image is truncated");
+    }
+  }
+
+  uint8_t get_u8() {
+    need(1);
+    return static_cast<uint8_t>(*pos++);
+  }
+
+  uint32_t get_u32() {
+    uint32_t ret = 0;
+    for (int i = 0; i < 4; i++) {
+      ret |= static_cast<uint32_t>(get_u8()) << (8 * i);
+    }
+    return ret;
+  }
+
+  uint64_t get_u64() {
+    uint64_t ret = 0;
+    for (int i = 0; i < 8; i++) {
+      ret |= static_cast<uint64_t>(get_u8()) << (8 * i);
+    }
+    return ret;
+  }
+
+  // every element takes at least a byte, so a longer count is corrupt
+  size_t get_count() {
+    const auto n = get_u64();
+    need(n);
+    return n;
+  }
+
+  size_t get_length() {
+    const auto n = get_u32();
+    need(n);
+    return n;
+  }
+
+  std::string get_string() {
+    const auto n = get_count();
+    std::string ret(pos, n);
+    pos += n;
+    return ret;
+  }
+
+  Symbol get_symbol() {
+    const auto id = get_u32();
+    if (id >= symbols.size()) {
+      throw std::runtime_error("image is corrupt: bad symbol reference");
+    }
+    return symbols[id];
+  }
+
+  std::vector<Symbol> get_symbols() {
+    const auto n = get_length();
+    std::vector<Symbol> ret {};
+    ret.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+      ret.push_back(get_symbol());
+    }
+    return ret;
+  }
+
+  uint32_t get_id() {
+    const auto id = get_u32();
+    if (id >= table.size()) {
+      throw std::runtime_error("image is corrupt: bad object reference");
+    }
+    return id;
+  }
+
+  // an object that must already have been made
+  template<typename T>
+  T *get_made(const bool nullable = false) {
+    const auto id = get_u32();
+    if (nullable && id == NO_OBJECT) {
+      return nullptr;
+    }
+    const auto ret = id < table.size() ? dynamic_cast<T*>(table[id]) : nullptr;
+    if (!ret) {
+      throw std::runtime_error("image is corrupt: object used before it is made");
+    }
+    return ret;
+  }
+
+  Expression *get_expr() {
+    return get_made<Expression>(true);
+  }
+
+  ExprList get_exprs() {
+    const auto n = get_length();
+    ExprList ret {};
+    ret.reserve(n);
+    for (size_t i = 0; i < n; i++) {
+      ret.push_back(get_expr());
+    }
+    return ret;
+  }
+
+  // slot must stay where it is until the fixups are done
+  void get_obj(Obj& slot) {
+    const auto index = get_u8();
+    switch (index) {
+      case 0:
+        slot = static_cast<bool>(get_u8());
+        return;
+      case 1:
+        slot = std::bit_cast<double>(get_u64());
+        return;
+      case 2:
+        slot = static_cast<char>(get_u8());
+        return;
+      case 3:
+        slot = get_symbol();
+        return;
+    }
+    if (index >= std::variant_size_v<Obj>) {
+      throw std::runtime_error("image is corrupt: bad object");
+    }
+    if (index == Obj {Null {}}.index()) {
+      slot = Null {};
+      return;
+    }
+    if (index == Obj {Void {}}.index()) {
+      slot = Void {};
+      return;
+    }
+    const auto id = get_id();
+    if (table[id]) {
+      slot = heap_obj(index, table[id]);
+    }
+    else {
+      slot = Void {};
+      fixups.push_back({&slot, id, index});
+    }
+  }
+
+  std::vector<Clause> get_clauses() {
+    const auto n = get_length();
+    std::vector<Clause> ret {};
+    for (size_t i = 0; i < n; i++) {
+      const bool is_else = get_u8();
+      const auto predicate = get_expr();
+      ret.push_back({is_else, predicate, get_expr()});
+    }
+    return ret;
+  }
+
+  void read_header() {
+    need(sizeof(IMAGE_MAGIC));
+    if (std::memcmp(pos, IMAGE_MAGIC, sizeof(IMAGE_MAGIC)) != 0) {
+      throw std::runtime_error("not an image");
+    }
+    pos += sizeof(IMAGE_MAGIC);
+    if (get_u32() != IMAGE_VERSION) {
+      throw std::runtime_error("image is from an incompatible version");
+    }
+    if (get_u32() != interp.builtins.size()) {
+      throw std::runtime_error("image was saved by a build with different builtins");
+    }
+  }
+
+  void read_symbols(const uint32_t count) {
+    symbols.reserve(count);
+    for (uint32_t i = 0; i < count; i++) {
+      if (get_u8()) {
+        const auto original = get_symbol();
+        symbols.push_back(interp.syntax.make_alias(original, get_u8()));
+      }
+      else {
+        symbols.push_back(interp.intern_symbol(get_string()));
+      }
+    }
+  }
+
+  void read_storages(const uint32_t count) {
+    storages.resize(count);
+    storage_starts.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+      const auto id = get_u32();
+      if (id >= count || storages[id]) {
+        throw std::runtime_error("image is corrupt: bad bytevector storage");
+      }
+      storage_starts[id] = get_u64();
+      const auto n = get_count();
+      storages[id] = interp.spawn<Bytevector>(n);
+      std::memcpy(storages[id]->data(), pos, n);
+      pos += n;
+    }
+  }
+
+  Bytevector *make_bytevector() {
+    const auto id = get_u32();
+    const auto start = get_u64();
+    const auto length = get_u64();
+    if (id >= storages.size() || start < storage_starts[id] || start - storage_starts[id] + length > storages[id]->size()) {
+      throw std::runtime_error("image is corrupt: bad bytevector");
+    }
+    const auto from = start - storage_starts[id];
+    return interp.spawn<Bytevector>(*storages[id], from, from + length);
+  }
+
+  HeapEntity *make_record(const ImageKind kind) {
+    switch (kind) {
+      case ImageKind::STRING:
+        return interp.spawn<String>(get_string());
+      case ImageKind::STRING_PORT: {
+        const auto port = interp.spawn<StringPort>();
+        port->buffer = get_string();
+        return port;
+      }
+      case ImageKind::CONS: {
+        const auto cons = interp.spawn<Cons>(Void {}, Void {});
+        get_obj(cons->car);
+        get_obj(cons->cdr);
+        return cons;
+      }
+      case ImageKind::VECTOR: {
+        const auto vector = interp.spawn<Vector>(ArgList(get_count(), Void {}));
+        for (auto& item : vector->data) {
+          get_obj(item);
+        }
+        return vector;
+      }
+      case ImageKind::BYTEVECTOR:
+        return make_bytevector();
+      case ImageKind::HASH_TABLE: {
+        const auto table_kind = static_cast<HashTable::Kind>(get_u8());
+        if (table_kind > HashTable::Kind::STRING) {
+          throw std::runtime_error("image is corrupt: bad hash table");
+        }
+        const auto table = interp.spawn<HashTable>(table_kind);
+        get_entries(table, false);
+        return table;
+      }
+      case ImageKind::PMAP: {
+        const bool is_set = get_u8();
+        const bool transient = get_u8();
+        const auto map = interp.spawn<PersistentMap>(nullptr, 0, is_set);
+        get_entries(map, transient);
+        return map;
+      }
+      case ImageKind::RECORD_TYPE: {
+        const auto name = get_symbol();
+        auto fields = get_symbols();
+        std::vector<size_t> slots(get_count());
+        for (auto& slot : slots) {
+          slot = get_u64();
+          if (slot >= fields.size()) {
+            throw std::runtime_error("image is corrupt: bad record constructor");
+          }
+        }
+        return interp.spawn<RecordType>(name, std::move(fields), std::move(slots));
+      }
+      case ImageKind::RECORD: {
+        const auto record = interp.spawn<Record>(get_made<RecordType>());
+        for (size_t i = 0; i < record->type->fields.size(); i++) {
+          get_obj(record->slots()[i]);
+        }
+        return record;
+      }
+      case ImageKind::PROMISE: {
+        const bool stream = get_u8();
+        const auto promise = interp.spawn<Promise>(nullptr, stream);
+        get_obj_as<PromiseState>(promise->state);
+        return promise;
+      }
+      case ImageKind::PROMISE_STATE: {
+        const auto state = interp.spawn<PromiseState>(Void {});
+        state->done = get_u8();
+        state->lazy = get_u8();
+        get_obj(state->value);
+        get_obj_as<Expression>(state->expr, true);
+        get_obj_as<Environment>(state->env, true);
+        return state;
+      }
+      case ImageKind::RECORD_PROCEDURE: {
+        const auto role = static_cast<RecordRole>(get_u8());
+        const auto type = get_made<RecordType>();
+        const auto slot = get_u64();
+        if (role == RecordRole::NONE || role > RecordRole::MODIFIER || ((role == RecordRole::ACCESSOR || role == RecordRole::MODIFIER) && slot >= type->fields.size())) {
+          throw std::runtime_error("image is corrupt: bad record procedure");
+        }
+        return make_record_procedure(type, role, slot, interp);
+      }
+      case ImageKind::PROCEDURE: {
+        auto parameters = get_symbols();
+        const bool is_variadic = get_u8();
+        const auto env = get_made<Environment>();
+        return interp.spawn<Procedure>(std::move(parameters), get_made<Expression>(), env, is_variadic);
+      }
+      case ImageKind::PARAMETER: {
+        const auto parameter = interp.spawn<Parameter>(Void {}, Void {});
+        get_obj(parameter->value);
+        get_obj(parameter->converter);
+        return parameter;
+      }
+      case ImageKind::ENVIRONMENT: {
+        const auto env = interp.spawn<Environment>(get_made<Environment>(true));
+        const auto n = get_count();
+        for (size_t i = 0; i < n; i++) {
+          const auto sym = get_symbol();
+          env->define(sym, Void {});
+          get_obj(env->get(sym));
+        }
+        return env;
+      }
+      case ImageKind::MACRO: {
+        const auto ellipsis = get_symbol();
+        const bool has_ellipsis = get_u8();
+        auto literals = get_symbols();
+        const bool top_level = get_u8();
+        std::vector<std::pair<Obj, Obj>> rules(get_count());
+        const auto macro = interp.spawn<Macro>(ellipsis, has_ellipsis, std::move(literals), std::move(rules), top_level, 1);
+        for (auto& [pattern, tmpl] : macro->rules) {
+          get_obj(pattern);
+          get_obj(tmpl);
+        }
+        return macro;
+      }
+      default:
+        return make_expression(kind);
+    }
+  }
+
+  Expression *make_expression(const ImageKind kind) {
+    switch (kind) {
+      case ImageKind::LITERAL: {
+        const auto literal = interp.spawn<Literal>(Void {});
+        get_obj(literal->obj);
+        return literal;
+      }
+      case ImageKind::VARIABLE: {
+        const auto sym = get_symbol();
+        const auto depth = static_cast<int>(get_u32());
+        return interp.spawn<Variable>(sym, depth, get_u8());
+      }
+      case ImageKind::GLOBAL_VARIABLE:
+        return interp.spawn<GlobalVariable>(get_symbol());
+      case ImageKind::QUOTED: {
+        const auto quoted = interp.spawn<Quoted>(Void {});
+        get_obj(quoted->text);
+        return quoted;
+      }
+      case ImageKind::QUASIQUOTED: {
+        if (get_u8()) {
+          return interp.spawn<Quasiquoted>(get_exprs());
+        }
+        const auto quasiquoted = interp.spawn<Quasiquoted>(Obj {Void {}});
+        get_obj(std::get<Obj>(quasiquoted->text));
+        return quasiquoted;
+      }
+      case ImageKind::SET: {
+        const auto sym = get_symbol();
+        return interp.spawn<Set>(sym, get_expr());
+      }
+      case ImageKind::IF: {
+        const auto predicate = get_expr();
+        const auto consequent = get_expr();
+        return interp.spawn<If>(predicate, consequent, get_expr());
+      }
+      case ImageKind::BEGIN:
+        return interp.spawn<Begin>(get_exprs());
+      case ImageKind::LAMBDA: {
+        auto parameters = get_symbols();
+        const bool is_variadic = get_u8();
+        return interp.spawn<Lambda>(std::move(parameters), get_made<Expression>(), is_variadic);
+      }
+      case ImageKind::DEFINE: {
+        const auto sym = get_symbol();
+        return interp.spawn<Define>(sym, get_expr());
+      }
+      case ImageKind::LET:
+      case ImageKind::LET_SEQ: {
+        LetBindings bindings(get_length());
+        for (auto& [sym, init] : bindings) {
+          sym = get_symbol();
+          init = get_expr();
+        }
+        if (kind == ImageKind::LET) {
+          return interp.spawn<Let>(std::move(bindings), get_expr());
+        }
+        return interp.spawn<LetSeq>(std::move(bindings), get_expr());
+      }
+      case ImageKind::LET_VALUES: {
+        std::vector<ValuesBinding> bindings(get_length());
+        for (auto& binding : bindings) {
+          binding.formals = get_symbols();
+          binding.is_variadic = get_u8();
+          binding.expr = get_expr();
+        }
+        const bool sequential = get_u8();
+        return interp.spawn<LetValues>(std::move(bindings), sequential, get_expr());
+      }
+      case ImageKind::COND:
+        return interp.spawn<Cond>(get_clauses());
+      case ImageKind::GUARD: {
+        const auto sym = get_symbol();
+        auto clauses = get_clauses();
+        return interp.spawn<Guard>(sym, std::move(clauses), get_expr());
+      }
+      case ImageKind::LOOP: {
+        const auto name = get_symbol();
+        auto variables = get_symbols();
+        auto inits = get_exprs();
+        return interp.spawn<Loop>(name, std::move(variables), std::move(inits), get_expr());
+      }
+      case ImageKind::RECUR: {
+        auto variables = get_symbols();
+        auto args = get_exprs();
+        const auto recur = interp.spawn<Recur>(std::move(variables), std::move(args));
+        recur->depth = static_cast<int>(get_u32());
+        recur->resolved = get_u8();
+        return recur;
+      }
+      case ImageKind::PARAMETERIZE: {
+        std::vector<std::pair<Expression*, Expression*>> bindings(get_length());
+        for (auto& [param, value] : bindings) {
+          param = get_expr();
+          value = get_expr();
+        }
+        return interp.spawn<Parameterize>(std::move(bindings), get_expr());
+      }
+      case ImageKind::DELAY: {
+        const auto expr = get_expr();
+        const bool lazy = get_u8();
+        return interp.spawn<Delay>(expr, lazy, get_u8());
+      }
+      case ImageKind::STREAM_CONS: {
+        const auto head = get_expr();
+        return interp.spawn<StreamCons>(head, get_expr());
+      }
+      case ImageKind::DEFINE_RECORD: {
+        const auto type_name = get_symbol();
+        auto fields = get_symbols();
+        std::optional<Symbol> constructor {};
+        if (get_u8()) {
+          constructor = get_symbol();
+        }
+        std::vector<size_t> slots(get_count());
+        for (auto& slot : slots) {
+          slot = get_u64();
+        }
+        const auto predicate = get_symbol();
+        std::vector<RecordField> procedures(get_count());
+        for (auto& proc : procedures) {
+          proc.slot = get_u64();
+          proc.accessor = get_symbol();
+          if (get_u8()) {
+            proc.modifier = get_symbol();
+          }
+        }
+        return interp.spawn<DefineRecord>(type_name, std::move(fields), constructor, std::move(slots), predicate, std::move(procedures));
+      }
+      case ImageKind::APPLICATION: {
+        const auto op = get_expr();
+        const auto application = interp.spawn<Application>(op, get_exprs());
+        application->at_tail = get_u8();
+        return application;
+      }
+      case ImageKind::AND:
+        return interp.spawn<And>(get_exprs());
+      case ImageKind::OR:
+        return interp.spawn<Or>(get_exprs());
+      case ImageKind::REPEAT:
+        return interp.spawn<Repeat>(get_expr());
+      case ImageKind::SELF_CALL: {
+        const auto recur = get_made<Recur>();
+        const auto call = get_made<Application>();
+        const auto self_call = interp.spawn<SelfCall>(recur, call, nullptr);
+        get_obj_as(self_call->body);
+        return self_call;
+      }
+      default:
+        throw std::runtime_error("image is corrupt: unknown record");
+    }
+  }
+
+  // a pointer to an object that may not have been made yet
+  template<typename T>
+  void get_obj_as(T*& slot, const bool nullable = false) {
+    const auto id = get_u32();
+    if (nullable && id == NO_OBJECT) {
+      slot = nullptr;
+      return;
+    }
+    if (id >= table.size()) {
+      throw std::runtime_error("image is corrupt: bad object reference");
+    }
+    pointer_fixups.push_back([this, &slot, id] {
+      slot = dynamic_cast<T*>(table[id]);
+      if (!slot) {
+        throw std::runtime_error("image is corrupt: bad object reference");
+      }
+    });
+  }
+
+  template<typename T>
+  void get_entries(T *target, const bool transient) {
+    auto& added = entries.emplace_back(Entries {target, transient, {}});
+    added.entries.resize(get_count());
+    for (auto& [key, value] : added.entries) {
+      get_obj(key);
+      get_obj(value);
+    }
+  }
+
+  void fill_entries() {
+    for (auto& e : entries) {
+      std::visit(Overloaded {
+        [&](HashTable *table) {
+          for (const auto& [key, value] : e.entries) {
+            table->set(key, value);
+          }
+        },
+        [&](PersistentMap *map) {
+          const auto builder = map->make_transient(interp);
+          for (const auto& [key, value] : e.entries) {
+            builder->assoc_in_place(key, value, interp);
+          }
+          map->root = builder->root;
+          map->count = builder->count;
+          if (e.transient) {
+            map->edit = builder->edit;
+            map->transient = true;
+          }
+        }
+      }, e.target);
+    }
+  }
+
+public:
+  ImageReader(Interpreter& interp, const char *data, const size_t size):
+    interp {interp},
+    pos {data},
+    end {data + size},
+    symbols {},
+    storages {},
+    storage_starts {},
+    table {},
+    fixups {},
+    pointer_fixups {},
+    entries {}
+  {}
+
+  void load() {
+    read_header();
+    const auto symbol_count = get_u32();
+    const auto storage_count = get_u32();
+    const auto id_count = get_u32();
+    const auto object_count = get_u32();
+    const auto known = known_objects(interp);
+    if (id_count < known.size()) {
+      throw std::runtime_error("image is corrupt: too few objects");
+    }
+    read_symbols(symbol_count);
+    read_storages(storage_count);
+
+    table.assign(id_count, nullptr);
+    std::copy(known.begin(), known.end(), table.begin());
+    for (uint32_t i = 0; i < object_count; i++) {
+      const auto id = get_id();
+      if (table[id]) {
+        throw std::runtime_error("image is corrupt: object made twice");
+      }
+      table[id] = make_record(static_cast<ImageKind>(get_u8()));
+    }
+
+    std::vector<std::pair<Symbol, Obj>> globals(get_count());
+    for (auto& [sym, value] : globals) {
+      sym = get_symbol();
+      get_obj(value);
+    }
+    std::vector<std::pair<Symbol, Macro*>> macros(get_count());
+    for (auto& [sym, macro] : macros) {
+      sym = get_symbol();
+      get_obj_as(macro);
+    }
+
+    for (const auto& fixup : fixups) {
+      if (!table[fixup.id]) {
+        throw std::runtime_error("image is corrupt: object never made");
+      }
+      *fixup.slot = heap_obj(fixup.index, table[fixup.id]);
+    }
+    for (const auto& fixup : pointer_fixups) {
+      fixup();
+    }
+    fill_entries();
+
+    for (const auto& [sym, value] : globals) {
+      interp.get_global_env()->define(sym, value);
+    }
+    for (const auto& [sym, macro] : macros) {
+      interp.syntax.define_macro(sym, macro);
+    }
+  }
+};
+
+}
+
+void
+load_image(const std::string& path, Interpreter& interp) {
+  const ImageFile file {path};
+  try {
+    ImageReader(interp, file.data(), file.size()).load();
+  }
+  catch (const std::runtime_error& e) {
+    throw std::runtime_error(std::format("could not load {}: {}", path, e.what()));
+  }
+}
+
+// the expressions' records, in the order ImageReader reads them
+
+void
+Literal::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::LITERAL);
+  w.put_obj(obj);
+}
+
+void
+Variable::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::VARIABLE);
+  w.put_symbol(sym);
+  w.put_u32(depth);
+  w.put_u8(resolved);
+}
+
+void
+GlobalVariable::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::GLOBAL_VARIABLE);
+  w.put_symbol(sym);
+}
+
+void
+Quoted::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::QUOTED);
+  w.put_obj(text);
+}
+
+void
+Quasiquoted::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::QUASIQUOTED);
+  if (std::holds_alternative<Obj>(text)) {
+    w.put_u8(0);
+    w.put_obj(std::get<Obj>(text));
+  }
+  else {
+    w.put_u8(1);
+    w.put_exprs(std::get<ExprList>(text));
+  }
+}
+
+void
+Set::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::SET);
+  w.put_symbol(variable);
+  w.put_expr(value);
+}
+
+void
+If::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::IF);
+  w.put_expr(predicate);
+  w.put_expr(consequent);
+  w.put_expr(alternative);
+}
+
+void
+Begin::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::BEGIN);
+  w.put_exprs(actions);
+}
+
+void
+Lambda::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::LAMBDA);
+  w.put_symbols(parameters);
+  w.put_u8(is_variadic);
+  w.put_expr(body);
+}
+
+void
+Define::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::DEFINE);
+  w.put_symbol(variable);
+  w.put_expr(value);
+}
+
+static void
+save_let(ImageWriter& w, const ImageKind kind, const LetBindings& bindings, Expression *body) {
+  w.put_kind(kind);
+  w.put_u32(bindings.size());
+  for (const auto& [sym, init] : bindings) {
+    w.put_symbol(sym);
+    w.put_expr(init);
+  }
+  w.put_expr(body);
+}
+
+void
+Let::save(ImageWriter& w) const {
+  save_let(w, ImageKind::LET, bindings, body);
+}
+
+void
+LetSeq::save(ImageWriter& w) const {
+  save_let(w, ImageKind::LET_SEQ, bindings, body);
+}
+
+void
+LetValues::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::LET_VALUES);
+  w.put_u32(bindings.size());
+  for (const auto& binding : bindings) {
+    w.put_symbols(binding.formals);
+    w.put_u8(binding.is_variadic);
+    w.put_expr(binding.expr);
+  }
+  w.put_u8(sequential);
+  w.put_expr(body);
+}
+
+static void
+save_clauses(ImageWriter& w, const std::vector<Clause>& clauses) {
+  w.put_u32(clauses.size());
+  for (const auto& clause : clauses) {
+    w.put_u8(clause.is_else);
+    w.put_expr(clause.predicate);
+    w.put_expr(clause.actions);
+  }
+}
+
+void
+Cond::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::COND);
+  save_clauses(w, clauses);
+}
+
+void
+Guard::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::GUARD);
+  w.put_symbol(variable);
+  save_clauses(w, clauses);
+  w.put_expr(body);
+}
+
+void
+Loop::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::LOOP);
+  w.put_symbol(name);
+  w.put_symbols(variables);
+  w.put_exprs(inits);
+  w.put_expr(body);
+}
+
+void
+Recur::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::RECUR);
+  w.put_symbols(variables);
+  w.put_exprs(args);
+  w.put_u32(depth);
+  w.put_u8(resolved);
+}
+
+void
+Parameterize::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::PARAMETERIZE);
+  w.put_u32(bindings.size());
+  for (const auto& [param, value] : bindings) {
+    w.put_expr(param);
+    w.put_expr(value);
+  }
+  w.put_expr(body);
+}
+
+void
+Delay::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::DELAY);
+  w.put_expr(expr);
+  w.put_u8(lazy);
+  w.put_u8(stream);
+}
+
+void
+StreamCons::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::STREAM_CONS);
+  w.put_expr(head);
+  w.put_expr(tail);
+}
+
+void
+DefineRecord::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::DEFINE_RECORD);
+  w.put_symbol(type_name);
+  w.put_symbols(fields);
+  w.put_u8(constructor.has_value());
+  if (constructor) {
+    w.put_symbol(*constructor);
+  }
+  w.put_u64(constructor_slots.size());
+  for (const auto slot : constructor_slots) {
+    w.put_u64(slot);
+  }
+  w.put_symbol(predicate);
+  w.put_u64(procedures.size());
+  for (const auto& proc : procedures) {
+    w.put_u64(proc.slot);
+    w.put_symbol(proc.accessor);
+    w.put_u8(proc.modifier.has_value());
+    if (proc.modifier) {
+      w.put_symbol(*proc.modifier);
+    }
+  }
+}
+
+// the call site's type feedback is not saved; it is gathered again
+void
+Application::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::APPLICATION);
+  w.put_expr(op);
+  w.put_exprs(params);
+  w.put_u8(at_tail);
+}
+
+void
+And::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::AND);
+  w.put_exprs(exprs);
+}
+
+void
+Or::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::OR);
+  w.put_exprs(exprs);
+}
+
+void
+Repeat::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::REPEAT);
+  w.put_expr(body);
+}
+
+// the Repeat around a self call contains it, so it is made after it
+void
+SelfCall::save(ImageWriter& w) const {
+  w.put_kind(ImageKind::SELF_CALL);
+  w.put_expr(recur);
+  w.put_expr(call);
+  w.put_expr_ref(body);
+}
+
+}
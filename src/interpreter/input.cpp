@@ -127,6 +127,10 @@ private:
               return std::nullopt;
             }
           }
+          else if (pos + 2 < input.size() && input[pos + 1] == '\\') {
+            // character literal; its first character may be a bracket
+            pos = parse_term(pos + 3);
+          }
           else {
             pos += 1;
           }
@@ -384,7 +388,14 @@ Session::run() {
   while (const auto expr = input->get_expr()) {
     try {
       const Obj result = interp->interpret(*expr);
-      input->print_result(result);
+      if (interp->is_values(result)) {
+        for (const auto& value : interp->values) {
+          input->print_result(value);
+        }
+      }
+      else {
+        input->print_result(result);
+      }
     }
     catch (const std::exception& e) {
       std::cerr << "ERROR: " << e.what() << std::endl;
@@ -5,12 +5,16 @@
 #include <interpreter/memory.hpp>
 #include <interpreter/lexer.hpp>
 #include <interpreter/parser.hpp>
+#include <interpreter/coroutine.hpp>
+#include <interpreter/image.hpp>
 #include <builtins/installer.hpp>
 #include <builtins/preamble.hpp>
 #include <unordered_map>
 #include <string>
 #include <string_view>
 #include <iostream>
+#include <filesystem>
+#include <algorithm>
 
 namespace Scheme {
 
@@ -34,22 +38,65 @@ public:
 void
 Interpreter::install_global_environment() {
   global_env = alloc.spawn<Environment>();
+  error_type = alloc.spawn<RecordType>(
+    intern_symbol("error-object"),
+    std::vector<Symbol> {intern_symbol("message"), intern_symbol("irritants")}
+  );
+  eof_object = alloc.spawn<Record>(alloc.spawn<RecordType>(intern_symbol("eof-object"), std::vector<Symbol> {}));
+  values_marker = alloc.spawn<Record>(alloc.spawn<RecordType>(intern_symbol("values"), std::vector<Symbol> {}));
   BuiltinInstaller(global_env, *this).install_all_functions();
 }
 
+// the image of the preamble is saved by the build, with the interpreter
+// that then loads it. one that is missing or from another build, as when
+// the binary has moved or the tree was built by other means, leaves the
+// preamble to be evaluated.
 void
-Interpreter::load_preamble() {
+Interpreter::load_preamble(const bool from_image) {
+#ifdef SCHEME_PREAMBLE_IMAGE
+  if (from_image && std::filesystem::exists(SCHEME_PREAMBLE_IMAGE)) {
+    try {
+      load_image(SCHEME_PREAMBLE_IMAGE, *this);
+      return;
+    }
+    catch (const std::runtime_error&) {}
+  }
+#endif
   interpret(std::string(preamble));
 }
 
-Interpreter::Interpreter(bool profiling): 
+Interpreter::Interpreter(bool profiling, const std::optional<std::string>& image, const bool preamble_image): 
   intern_table {},
   global_env {},
+  error_type {},
+  eof_object {},
+  values_marker {},
   profiling {profiling},
-  alloc {}
+  alloc {},
+  handlers {},
+  parameterizations {},
+  winders {},
+  continuation_frames {},
+  prompt {},
+  uncopyable_frames {0},
+  current_coroutine {},
+  live_coroutines {},
+  values {},
+  stack_limit {main_stack_limit()},
+  call_depth {0},
+  call_budget {size_t {1} << 20},
+  segments {},
+  evaluating {},
+  syntax {},
+  builtins {}
 {
   install_global_environment();
-  load_preamble();
+  if (image) {
+    load_image(*image, *this);
+  }
+  else {
+    load_preamble(preamble_image);
+  }
 }
 
 Interpreter::~Interpreter() {
@@ -59,6 +106,33 @@ Interpreter::~Interpreter() {
   alloc.recycle();
 }
 
+// a single value is returned as itself
+Obj
+Interpreter::return_values(const ArgList& objs) {
+  if (objs.size() == 1) {
+    return objs[0];
+  }
+  values.assign(objs.begin(), objs.end());
+  return values_marker;
+}
+
+Obj
+Interpreter::return_values(std::initializer_list<Obj> objs) {
+  if (objs.size() == 1) {
+    return *objs.begin();
+  }
+  values.assign(objs);
+  return values_marker;
+}
+
+Obj
+Interpreter::first_value() const {
+  if (values.empty()) {
+    throw std::runtime_error("expected a value, got none");
+  }
+  return values[0];
+}
+
 Symbol
 Interpreter::intern_symbol(const std::string_view str) {
   auto itr = intern_table.find(str);
@@ -72,8 +146,86 @@ Interpreter::intern_symbol(const std::string_view str) {
   }
 }
 
-Obj
-Interpreter::interpret(const std::string& code) {
+bool
+Interpreter::is_interned(const Symbol& sym) const {
+  const auto found = intern_table.find(sym.get_name());
+  return found != intern_table.end() && found->second == sym.id;
+}
+
+// the stack of a suspended coroutine that can still be resumed is scanned
+// as it is reached. those that can no longer be reached are unwound first,
+// and collected with the rest.
+void
+Interpreter::collect_garbage(Obj& result) {
+  std::vector<HeapEntity*> roots {global_env, error_type, eof_object, values_marker};
+  if (is_values(result)) {
+    for (auto& obj : values) {
+      if (auto ent = try_get_heap_entity(obj)) {
+        roots.push_back(ent);
+      }
+    }
+  }
+  else {
+    values.clear();
+  }
+  syntax.push_roots(roots);
+  roots.insert(roots.end(), builtins.begin(), builtins.end());
+  if (auto ent = try_get_heap_entity(result)) {
+    roots.push_back(ent);
+  }
+  if (!live_coroutines.empty()) {
+    alloc.mark(roots);
+    std::vector<Coroutine*> unreachable {};
+    for (const auto co : live_coroutines) {
+      if (!co->marked) {
+        unreachable.push_back(co);
+      }
+    }
+    alloc.unmark();
+    for (const auto co : unreachable) {
+      abandon(co, *this);
+    }
+  }
+  alloc.recycle(roots);
+}
+
+// a collection at a safe point. whatever the frames of the evaluator and
+// of builtins hold is found by scanning the stacks in use. the rest is
+// rooted as at the top level, with the values waiting in the register, the
+// forms being evaluated and every coroutine not yet finished, as only the
+// top level unwinds those; the stacks of the suspended ones are scanned as
+// they are marked. the scan runs on cleared stack, as what the last
+// collection left there would otherwise be taken for pointers into objects
+// allocated since.
+void
+Interpreter::collect_during_evaluation() {
+  Timer timer(garbage_collecting_time);
+  std::vector<HeapEntity*> roots {global_env, error_type, eof_object, values_marker};
+  clear_stack();
+  if (!scan_stacks(*this, roots)) {
+    alloc.defer_collection();
+    return;
+  }
+  syntax.push_roots(roots);
+  roots.insert(roots.end(), builtins.begin(), builtins.end());
+  roots.insert(roots.end(), evaluating.begin(), evaluating.end());
+  roots.insert(roots.end(), live_coroutines.begin(), live_coroutines.end());
+  for (auto& obj : values) {
+    if (auto ent = try_get_heap_entity(obj)) {
+      roots.push_back(ent);
+    }
+  }
+  PinnedObj::push_roots(roots);
+  alloc.recycle(roots);
+}
+
+// reads code into the expression to evaluate, in a frame of its own. the
+// datum the expression is built from is garbage once evaluation starts, so
+// interpret clears the stack this ran on before evaluating: a collection
+// would take the words left there for pointers into whatever is allocated
+// at the datum's addresses later.
+[[gnu::noinline]] Expression*
+Interpreter::build(const std::string& code) {
   if (profiling) {
     auto tokens = [&](){
       Timer timer(lexing_time);
@@ -85,38 +237,41 @@ Interpreter::interpret(const std::string& code) {
       return Parser(tokens, *this).parse();
     }();
 
-    auto ast = [&](){ 
-      Timer timer(ast_building_time);
-      return build_ast(s_expr, *this);
-    }();
+    Timer timer(ast_building_time);
+    return build_ast(s_expr, *this);
+  }
+  else {
+    auto tokens = Lexer(code).all_tokens();
+    auto s_expr = Parser(tokens, *this).parse();
+    return build_ast(s_expr, *this);
+  }
+}
 
+Obj
+Interpreter::interpret(const std::string& code) {
+  const auto ast = build(code);
+  clear_stack();
+  if (profiling) {
     auto result = [&](){
       Timer timer(evaluating_time);
-      return as_obj(ast->eval(global_env, *this));
+      EvaluationScope scope {*this, ast};
+      return run_delimited(ast, *this);
     }();
 
     {
       Timer timer(garbage_collecting_time);
-      std::vector<HeapEntity*> roots {global_env};
-      if (auto ent = try_get_heap_entity(result)) {
-        roots.push_back(ent);
-      }
-      alloc.recycle(roots);
+      collect_garbage(result);
     }
     
     return result;
 
   } 
   else {
-    auto tokens = Lexer(code).all_tokens();
-    auto s_expr = Parser(tokens, *this).parse();
-    auto ast = build_ast(s_expr, *this); 
-    auto result = as_obj(ast->eval(global_env, *this));
-    std::vector<HeapEntity*> roots {global_env};
-    if (auto ent = try_get_heap_entity(result)) {
-      roots.push_back(ent);
-    }
-    alloc.recycle(roots);
+    auto result = [&](){
+      EvaluationScope scope {*this, ast};
+      return run_delimited(ast, *this);
+    }();
+    collect_garbage(result);
     return result;
   }
 }
@@ -128,6 +283,7 @@ Interpreter::print_timings() const {
     << "Lexing:             " << duration_cast<microseconds>(lexing_time).count()             << " μs\n"
     << "Parsing:            " << duration_cast<microseconds>(parsing_time).count()            << " μs\n"
     << "AST Building:       " << duration_cast<microseconds>(ast_building_time).count()        << " μs\n"
+    << "Macro Expanding:    " << duration_cast<microseconds>(syntax.expanding_time).count()   << " μs\n"
     << "Evaluating:         " << duration_cast<microseconds>(evaluating_time).count()         << " μs\n"
     << "Garbage Collecting: " << duration_cast<microseconds>(garbage_collecting_time).count() << " μs\n";
   std::cout.flush();
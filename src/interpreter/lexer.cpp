@@ -4,6 +4,9 @@
 #include <string>
 #include <string_view>
 #include <format>
+#include <charconv>
+#include <limits>
+#include <optional>
 
 namespace Scheme {
 
@@ -28,6 +31,179 @@ is_digit(const char c) {
   }
 }
 
+static int
+digit_value(const char c) {
+  if ('0' <= c && c <= '9') {
+    return c - '0';
+  }
+  else if ('a' <= c && c <= 'z') {
+    return c - 'a' + 10;
+  }
+  else if ('A' <= c && c <= 'Z') {
+    return c - 'A' + 10;
+  }
+  else {
+    return -1;
+  }
+}
+
+static bool
+is_number_prefix(const char c) {
+  switch (c) {
+    case 'x': case 'X': case 'b': case 'B':
+    case 'o': case 'O': case 'd': case 'D':
+    case 'e': case 'E': case 'i': case 'I':
+      return true;
+    default:
+      return false;
+  }
+}
+
+static std::optional<double>
+read_uinteger(const std::string_view text, const int radix) {
+  if (text.empty()) {
+    return std::nullopt;
+  }
+  for (const char c : text) {
+    const int d = digit_value(c);
+    if (d < 0 || d >= radix) {
+      return std::nullopt;
+    }
+  }
+  if (radix == 10) {
+    double value;
+    std::from_chars(text.data(), text.data() + text.size(), value);
+    return value;
+  }
+  double value = 0;
+  for (const char c : text) {
+    value = value * radix + digit_value(c);
+  }
+  return value;
+}
+
+// digits [. digits] [e [sign] digits], with at least one mantissa digit
+static std::optional<double>
+read_decimal(const std::string_view text) {
+  size_t i = 0;
+  size_t mantissa_digits = 0;
+  while (i < text.size() && is_digit(text[i])) {
+    i++;
+    mantissa_digits++;
+  }
+  if (i < text.size() && text[i] == '.') {
+    i++;
+    while (i < text.size() && is_digit(text[i])) {
+      i++;
+      mantissa_digits++;
+    }
+  }
+  if (mantissa_digits == 0) {
+    return std::nullopt;
+  }
+  if (i < text.size() && (text[i] == 'e' || text[i] == 'E')) {
+    i++;
+    if (i < text.size() && (text[i] == '+' || text[i] == '-')) {
+      i++;
+    }
+    const size_t exponent_start = i;
+    while (i < text.size() && is_digit(text[i])) {
+      i++;
+    }
+    if (i == exponent_start) {
+      return std::nullopt;
+    }
+  }
+  if (i != text.size()) {
+    return std::nullopt;
+  }
+  double value;
+  const auto [ptr, ec] = std::from_chars(text.data(), text.data() + text.size(), value);
+  if (ptr != text.data() + text.size()) {
+    return std::nullopt;
+  }
+  // from_chars reports out-of-range magnitudes without storing a value
+  if (ec == std::errc::result_out_of_range) {
+    const auto exponent = text.find_first_of("eE");
+    const bool tiny = exponent != std::string_view::npos && text[exponent + 1] == '-';
+    return tiny ? 0.0 : std::numeric_limits<double>::infinity();
+  }
+  return value;
+}
+
+static std::optional<double>
+read_ureal(const std::string_view text, const int radix) {
+  const auto slash = text.find('/');
+  if (slash != std::string_view::npos) {
+    // no exact rationals yet, so n/d reads as the nearest double
+    const auto num = read_uinteger(text.substr(0, slash), radix);
+    const auto den = read_uinteger(text.substr(slash + 1), radix);
+    if (!num || !den) {
+      return std::nullopt;
+    }
+    return *num / *den;
+  }
+  else if (radix == 10) {
+    return read_decimal(text);
+  }
+  else {
+    return read_uinteger(text, radix);
+  }
+}
+
+// R7RS real syntax: [#radix][#exactness] in either order, an optional sign,
+// then an integer, rational, decimal, or one of +inf.0 -inf.0 +nan.0 -nan.0.
+// every number is a double, so #e and #i are accepted but change nothing.
+std::optional<double>
+read_number(std::string_view text, int radix) {
+  bool seen_radix = false;
+  bool seen_exactness = false;
+  while (text.size() >= 2 && text[0] == '#') {
+    switch (text[1]) {
+      case 'x': case 'X': radix = 16; break;
+      case 'b': case 'B': radix = 2; break;
+      case 'o': case 'O': radix = 8; break;
+      case 'd': case 'D': radix = 10; break;
+      case 'e': case 'E': case 'i': case 'I':
+        if (seen_exactness) {
+          return std::nullopt;
+        }
+        seen_exactness = true;
+        text.remove_prefix(2);
+        continue;
+      default:
+        return std::nullopt;
+    }
+    if (seen_radix) {
+      return std::nullopt;
+    }
+    seen_radix = true;
+    text.remove_prefix(2);
+  }
+
+  if (text.empty()) {
+    return std::nullopt;
+  }
+
+  bool negative = false;
+  if (text[0] == '+' || text[0] == '-') {
+    negative = text[0] == '-';
+    text.remove_prefix(1);
+    if (text == "inf.0") {
+      return negative ? -std::numeric_limits<double>::infinity() : std::numeric_limits<double>::infinity();
+    }
+    else if (text == "nan.0") {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+  }
+
+  const auto value = read_ureal(text, radix);
+  if (!value) {
+    return std::nullopt;
+  }
+  return negative ? -*value : *value;
+}
+
 static bool
 is_special(const char c) {
   switch (c) {
@@ -237,9 +413,15 @@ Lexer::hash_token() {
   else if (match('(')) {
     return make_token(Token::VEC_BEGIN);
   }
+  else if (match_word("u8(")) {
+    return make_token(Token::BYTEVEC_BEGIN);
+  }
   else if (match('\\')) {
     return char_token();
   }
+  else if (is_number_prefix(peek())) {
+    return number_token();
+  }
   else {
     throw error("unidentified constant");
   }
@@ -248,6 +430,10 @@ Lexer::hash_token() {
 Token
 Lexer::char_token() {
   start += 2;
+  // the first character is taken as is, so #\( and #\; are characters
+  if (!at_end()) {
+    advance();
+  }
   while (!at_boundary()) {
     advance();
   }
@@ -285,42 +471,21 @@ Lexer::symbol_token() {
 
 Token
 Lexer::number_token() { 
-  if (peek_prev() == '-' && match_exact_word("inf.0")) {
-    return make_token(Token::MINUS_INF);
-  }
-  if (peek_prev() == '-' && match_exact_word("nan.0")) {
-    return make_token(Token::MINUS_NAN);
-  }
-  if (peek_prev() == '+' && match_exact_word("inf.0")) {
-    return make_token(Token::PLUS_INF);
-  }
-  if (peek_prev() == '+' && match_exact_word("nan.0")) {
-    return make_token(Token::PLUS_NAN);
+  // a second prefix may directly follow the first, as in #e#x10
+  while (!at_boundary() || (peek() == '#' && curr == start + 2 && input[start] == '#')) {
+    advance();
   }
-  curr--;
-  bool has_digits = false;
-  while (!at_boundary()) {
-    const char c = advance();
-    if (is_digit(c)) {
-      has_digits = true;
-    }
-    else {
-      switch (c) {
-        case '.':
-        case '+': case '-':
-        case 'e': case 'E':
-          break;
-
-        default:
-          return symbol_token();
-      }
-    }
+  const auto lexeme = input.substr(start, curr - start);
+  if (const auto value = read_number(lexeme)) {
+    auto tok = make_token(Token::NUMBER);
+    tok.number = *value;
+    return tok;
   }
-  if (!has_digits) {
-    return make_token(Token::SYMBOL);
+  else if (lexeme.front() == '#') {
+    throw error("bad number syntax");
   }
   else {
-    return make_token(Token::NUMBER);
+    return make_token(Token::SYMBOL);
   }
 }
 
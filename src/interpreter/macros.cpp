@@ -0,0 +1,631 @@
+#include <interpreter/types.hpp>
+#include <interpreter/expressions.hpp>
+#include <interpreter/interpreter.hpp>
+#include <interpreter/macros.hpp>
+#include <interpreter/memory.hpp>
+#include <algorithm>
+#include <format>
+
+namespace Scheme {
+
+// past this many cached expansions the cache starts over, so that code
+// generated and evaluated in a loop cannot grow it without bound
+static constexpr size_t MAX_CACHED_EXPANSIONS = 1 << 14;
+
+size_t
+SyntaxTable::UseSiteHash::operator()(const UseSite& site) const {
+  return std::hash<const void*>()(site.macro) ^ equal_hash(site.form);
+}
+
+bool
+SyntaxTable::UseSiteEqual::operator()(const UseSite& a, const UseSite& b) const {
+  return a.macro == b.macro && equal(a.form, b.form);
+}
+
+SyntaxTable::SyntaxTable():
+  scopes {},
+  frames {0},
+  aliases {},
+  alias_names {},
+  expansions {}
+{
+  scopes.push_back({{}, false});
+}
+
+const std::pair<const Symbol, Macro*>*
+SyntaxTable::find(const Symbol& sym) const {
+  for (auto itr = scopes.rbegin(); itr != scopes.rend(); ++itr) {
+    const auto found = itr->names.find(sym);
+    if (found != itr->names.end()) {
+      return &*found;
+    }
+  }
+  return nullptr;
+}
+
+Symbol
+SyntaxTable::make_alias(const Symbol& sym, const bool top_level) {
+  alias_names.push_back(std::make_unique<std::string>(sym.get_name()));
+  const Symbol alias {alias_names.back().get()};
+  aliases.emplace(alias, Alias {sym, top_level});
+  return alias;
+}
+
+const Alias*
+SyntaxTable::get_alias(const Symbol& sym) const {
+  const auto found = aliases.find(sym);
+  return found == aliases.end() ? nullptr : &found->second;
+}
+
+// the symbol an alias was renamed from, through any number of expansions
+Symbol
+SyntaxTable::strip(Symbol sym) const {
+  while (const auto alias = get_alias(sym)) {
+    sym = alias->original;
+  }
+  return sym;
+}
+
+// a datum with its aliases replaced by the symbols they were renamed from,
+// for quote. structure without aliases is shared, not copied.
+Obj
+SyntaxTable::strip(const Obj& obj, Interpreter& interp) const {
+  if (is_symbol(obj)) {
+    return strip(as_symbol(obj));
+  }
+  if (is_vector(obj)) {
+    ArgList data {};
+    bool changed = false;
+    for (const auto& item : as_vector(obj)->data) {
+      data.push_back(strip(item, interp));
+      changed |= !(data.back() == item);
+    }
+    return changed ? Obj {interp.spawn<Vector>(std::move(data))} : obj;
+  }
+  if (!is_pair(obj)) {
+    return obj;
+  }
+  // along the spine iteratively, so long quoted lists are no problem
+  ArgList items {};
+  bool changed = false;
+  Obj tail = obj;
+  for (; is_pair(tail); tail = as_pair(tail)->cdr) {
+    const auto& car = as_pair(tail)->car;
+    items.push_back(strip(car, interp));
+    changed |= !(items.back() == car);
+  }
+  auto rest = strip(tail, interp);
+  changed |= !(rest == tail);
+  if (!changed) {
+    return obj;
+  }
+  for (auto itr = items.rbegin(); itr != items.rend(); ++itr) {
+    rest = interp.spawn<Cons>(*itr, rest);
+  }
+  return rest;
+}
+
+// the macro a keyword names where it is used. an alias that its expansion
+// did not bind means what the symbol it was renamed from means where the
+// macro was defined; for a top-level macro, that is at the top level.
+Macro*
+SyntaxTable::get_macro(const Symbol& sym) const {
+  if (const auto entry = find(sym)) {
+    return entry->second;
+  }
+  if (const auto alias = get_alias(sym)) {
+    if (alias->top_level) {
+      const auto found = scopes.front().names.find(strip(sym));
+      return found == scopes.front().names.end() ? nullptr : found->second;
+    }
+    return get_macro(alias->original);
+  }
+  return nullptr;
+}
+
+// the name to look a special form up by, or nothing where a binding form
+// has made the symbol a variable
+std::optional<Symbol>
+SyntaxTable::get_keyword(const Symbol& sym) const {
+  if (const auto entry = find(sym)) {
+    if (!entry->second) {
+      return std::nullopt;
+    }
+    return sym;
+  }
+  if (const auto alias = get_alias(sym)) {
+    if (alias->top_level) {
+      return strip(sym);
+    }
+    return get_keyword(alias->original);
+  }
+  return sym;
+}
+
+// the symbol the run-time environment knows a variable by. an alias its
+// expansion did not bind refers to what the symbol it was renamed from does
+// where the macro was defined.
+Symbol
+SyntaxTable::resolve(const Symbol& sym) const {
+  if (find(sym)) {
+    return sym;
+  }
+  if (const auto alias = get_alias(sym)) {
+    return alias->top_level ? strip(sym) : resolve(alias->original);
+  }
+  return sym;
+}
+
+// the binding an identifier refers to, among the first visible scopes: the
+// index of the scope that binds it, 0 where that is the top level or
+// nothing, with the symbol it is bound as
+std::pair<size_t, Symbol>
+SyntaxTable::binding(const Symbol& sym, const size_t visible) const {
+  for (size_t i = visible; i-- > 1;) {
+    if (scopes[i].names.contains(sym)) {
+      return {i, sym};
+    }
+  }
+  if (const auto alias = get_alias(sym)) {
+    return alias->top_level ? std::pair {size_t {0}, strip(sym)} : binding(alias->original, visible);
+  }
+  return {0, sym};
+}
+
+// free-identifier=?: whether an identifier in a macro use means what a
+// literal of the macro means where the macro was defined. a literal of a
+// top-level macro means its top-level binding.
+bool
+SyntaxTable::same_binding(const Symbol& form, const Symbol& literal, const Macro& macro) const {
+  const auto meaning = macro.top_level
+    ? std::pair {size_t {0}, strip(literal)}
+    : binding(literal, std::min(macro.depth, scopes.size()));
+  return binding(form, scopes.size()) == meaning;
+}
+
+// for a top-level macro, that is the top-level variable, even where a
+// binding around the macro use shadows it
+Expression*
+SyntaxTable::make_reference(const Symbol& sym, Interpreter& interp) const {
+  const auto resolved = resolve(sym);
+  if (!(resolved == sym) && get_alias(sym)->top_level) {
+    const auto entry = find(resolved);
+    if (entry && !entry->second) {
+      return interp.spawn<GlobalVariable>(resolved);
+    }
+  }
+  return interp.spawn<Variable>(resolved);
+}
+
+SyntaxTable::Scope&
+SyntaxTable::innermost_frame() {
+  auto itr = scopes.rbegin();
+  while (!itr->is_frame) {
+    ++itr;
+  }
+  return *itr;
+}
+
+// the symbol a definition binds: at the top level, aliases mean the symbol
+// they were renamed from; inside a body, the definition is local to it
+Symbol
+SyntaxTable::bind(const Symbol& sym) {
+  if (frames == 0) {
+    return strip(sym);
+  }
+  innermost_frame().names[sym] = nullptr;
+  return sym;
+}
+
+void
+SyntaxTable::define_macro(const Symbol& sym, Macro *macro) {
+  if (frames == 0) {
+    scopes.front().names[strip(sym)] = macro;
+  }
+  else {
+    innermost_frame().names[sym] = macro;
+  }
+}
+
+bool
+SyntaxTable::at_top_level() const {
+  return scopes.size() == 1;
+}
+
+size_t
+SyntaxTable::depth() const {
+  return scopes.size();
+}
+
+const std::unordered_map<Symbol, Macro*>&
+SyntaxTable::top_level_macros() const {
+  return scopes.front().names;
+}
+
+void
+SyntaxTable::push_roots(std::vector<HeapEntity*>& roots) {
+  for (const auto& [sym, macro] : scopes.front().names) {
+    if (macro) {
+      roots.push_back(macro);
+    }
+  }
+  for (const auto& [site, expansion] : expansions) {
+    roots.push_back(site.macro);
+    for (auto obj : {site.form, expansion}) {
+      if (const auto ent = try_get_heap_entity(obj)) {
+        roots.push_back(ent);
+      }
+    }
+  }
+}
+
+SyntaxScope::SyntaxScope(Interpreter& interp, const ParamList& binders, const bool is_frame):
+  table {interp.syntax}
+{
+  table.scopes.push_back({{}, is_frame});
+  table.frames += is_frame;
+  add(binders);
+}
+
+SyntaxScope::~SyntaxScope() {
+  table.frames -= table.scopes.back().is_frame;
+  table.scopes.pop_back();
+}
+
+void
+SyntaxScope::add(const ParamList& binders) {
+  for (const auto& sym : binders) {
+    table.scopes.back().names[sym] = nullptr;
+  }
+}
+
+void
+SyntaxScope::add_macro(const Symbol& sym, Macro *macro) {
+  table.scopes.back().names[sym] = macro;
+}
+
+// (syntax-rules (literal ...) (pattern template) ...), optionally with a
+// symbol to use as the ellipsis before the literals
+Macro*
+make_macro(const Obj& spec, const bool top_level, Interpreter& interp) {
+  const auto [length, proper] = list_profile(spec);
+  if (!is_pair(spec) || !proper || length < 2 || !is_symbol(as_pair(spec)->car)
+      || interp.syntax.strip(as_symbol(as_pair(spec)->car)).get_name() != "syntax-rules") {
+    throw std::runtime_error(std::format("expected a syntax-rules transformer, got {}", stringify(spec)));
+  }
+  Obj rest = as_pair(spec)->cdr;
+  Symbol ellipsis = interp.intern_symbol("...");
+  if (is_symbol(as_pair(rest)->car)) {
+    ellipsis = as_symbol(as_pair(rest)->car);
+    rest = as_pair(rest)->cdr;
+    if (!is_pair(rest)) {
+      throw std::runtime_error("syntax-rules: missing literals");
+    }
+  }
+
+  std::vector<Symbol> literals {};
+  Obj ls = as_pair(rest)->car;
+  for (; is_pair(ls); ls = as_pair(ls)->cdr) {
+    if (!is_symbol(as_pair(ls)->car)) {
+      throw std::runtime_error(std::format("syntax-rules: literal {} is not a symbol", stringify(as_pair(ls)->car)));
+    }
+    literals.push_back(as_symbol(as_pair(ls)->car));
+  }
+  if (!is_null(ls)) {
+    throw std::runtime_error("syntax-rules: literals must be a proper list");
+  }
+  const bool has_ellipsis = std::none_of(literals.begin(), literals.end(), [&](const Symbol& s) {
+    return interp.syntax.strip(s) == interp.syntax.strip(ellipsis);
+  });
+
+  std::vector<std::pair<Obj, Obj>> rules {};
+  for (Obj r = as_pair(rest)->cdr; is_pair(r); r = as_pair(r)->cdr) {
+    const auto rule = as_pair(r)->car;
+    if (!is_pair(rule) || list_length(rule) != 2 || !is_pair(as_pair(rule)->car)) {
+      throw std::runtime_error(std::format("syntax-rules: bad rule {}", stringify(rule)));
+    }
+    rules.emplace_back(as_pair(rule)->car, as_pair(rule)->at("cadr"));
+  }
+  return interp.spawn<Macro>(ellipsis, has_ellipsis, std::move(literals), std::move(rules), top_level, interp.syntax.depth());
+}
+
+namespace {
+
+// what a pattern variable matched: a form, or under an ellipsis, one binding
+// per repetition
+struct MatchBinding {
+  Obj value;
+  std::vector<MatchBinding> items;
+  bool is_sequence = false;
+};
+
+using MatchBindings = std::unordered_map<Symbol, MatchBinding>;
+
+// the bindings in effect while a template is transcribed: those of the
+// match, with the current repetition's in place of the sequences being
+// repeated
+struct TemplateBindings {
+  const MatchBindings& matched;
+  std::vector<std::pair<Symbol, const MatchBinding*>> repeated {};
+
+  const MatchBinding *get(const Symbol& sym) const {
+    for (auto itr = repeated.rbegin(); itr != repeated.rend(); ++itr) {
+      if (itr->first == sym) {
+        return itr->second;
+      }
+    }
+    const auto found = matched.find(sym);
+    return found == matched.end() ? nullptr : &found->second;
+  }
+};
+
+class Transformer {
+private:
+  const Macro& macro;
+  SyntaxTable& table;
+  Interpreter& interp;
+  // each introduced symbol is renamed to the same alias throughout one
+  // expansion
+  std::unordered_map<Symbol, Symbol> renames {};
+
+  bool is_ellipsis(const Obj& obj) const {
+    return macro.has_ellipsis && is_symbol(obj) && table.strip(as_symbol(obj)) == table.strip(macro.ellipsis);
+  }
+
+  bool is_literal(const Symbol& sym) const {
+    return std::find(macro.literals.begin(), macro.literals.end(), sym) != macro.literals.end();
+  }
+
+  bool is_underscore(const Symbol& sym) const {
+    return table.strip(sym).get_name() == "_";
+  }
+
+  Obj vector_to_list(const Vector *v) {
+    Obj ret = Null {};
+    for (auto itr = v->data.rbegin(); itr != v->data.rend(); ++itr) {
+      ret = interp.spawn<Cons>(*itr, ret);
+    }
+    return ret;
+  }
+
+  void pattern_variables(const Obj& pattern, std::vector<Symbol>& out) const {
+    if (is_symbol(pattern)) {
+      const auto sym = as_symbol(pattern);
+      if (!is_literal(sym) && !is_underscore(sym) && !is_ellipsis(pattern)) {
+        out.push_back(sym);
+      }
+    }
+    else if (is_pair(pattern)) {
+      pattern_variables(as_pair(pattern)->car, out);
+      pattern_variables(as_pair(pattern)->cdr, out);
+    }
+    else if (is_vector(pattern)) {
+      for (const auto& item : as_vector(pattern)->data) {
+        pattern_variables(item, out);
+      }
+    }
+  }
+
+  bool match_list(Obj pattern, Obj form, MatchBindings& out) {
+    while (is_pair(pattern)) {
+      const auto p = as_pair(pattern);
+      if (is_pair(p->cdr) && is_ellipsis(as_pair(p->cdr)->car)) {
+        const Obj rest = as_pair(p->cdr)->cdr;
+        size_t after = 0;
+        for (Obj r = rest; is_pair(r); r = as_pair(r)->cdr) {
+          after++;
+        }
+        ArgList items {};
+        for (Obj f = form; is_pair(f); f = as_pair(f)->cdr) {
+          items.push_back(as_pair(f)->car);
+        }
+        if (items.size() < after) {
+          return false;
+        }
+        const size_t count = items.size() - after;
+        std::vector<MatchBindings> matches(count);
+        for (size_t i = 0; i < count; i++) {
+          if (!match(p->car, items[i], matches[i])) {
+            return false;
+          }
+          form = as_pair(form)->cdr;
+        }
+        std::vector<Symbol> variables {};
+        pattern_variables(p->car, variables);
+        for (const auto& var : variables) {
+          MatchBinding binding {Void {}, {}, true};
+          for (auto& m : matches) {
+            binding.items.push_back(std::move(m[var]));
+          }
+          out[var] = std::move(binding);
+        }
+        pattern = rest;
+        continue;
+      }
+      if (!is_pair(form) || !match(p->car, as_pair(form)->car, out)) {
+        return false;
+      }
+      pattern = p->cdr;
+      form = as_pair(form)->cdr;
+    }
+    if (is_null(pattern)) {
+      return is_null(form);
+    }
+    return match(pattern, form, out);
+  }
+
+  bool match(const Obj& pattern, const Obj& form, MatchBindings& out) {
+    if (is_symbol(pattern)) {
+      const auto sym = as_symbol(pattern);
+      if (is_literal(sym)) {
+        return is_symbol(form) && table.same_binding(as_symbol(form), sym, macro);
+      }
+      if (!is_underscore(sym)) {
+        out[sym] = {form, {}, false};
+      }
+      return true;
+    }
+    if (is_pair(pattern)) {
+      return match_list(pattern, form, out);
+    }
+    if (is_vector(pattern)) {
+      return is_vector(form) && match_list(vector_to_list(as_vector(pattern)), vector_to_list(as_vector(form)), out);
+    }
+    return equal(pattern, form);
+  }
+
+  Symbol rename(const Symbol& sym) {
+    const auto found = renames.find(sym);
+    if (found != renames.end()) {
+      return found->second;
+    }
+    const auto alias = table.make_alias(sym, macro.top_level);
+    renames.emplace(sym, alias);
+    return alias;
+  }
+
+  // the variables of a subtemplate that an ellipsis after it repeats over
+  void sequence_variables(const Obj& tmpl, const TemplateBindings& bindings, std::vector<Symbol>& out) const {
+    if (is_symbol(tmpl)) {
+      const auto binding = bindings.get(as_symbol(tmpl));
+      if (binding && binding->is_sequence && std::find(out.begin(), out.end(), as_symbol(tmpl)) == out.end()) {
+        out.push_back(as_symbol(tmpl));
+      }
+    }
+    else if (is_pair(tmpl)) {
+      sequence_variables(as_pair(tmpl)->car, bindings, out);
+      sequence_variables(as_pair(tmpl)->cdr, bindings, out);
+    }
+    else if (is_vector(tmpl)) {
+      for (const auto& item : as_vector(tmpl)->data) {
+        sequence_variables(item, bindings, out);
+      }
+    }
+  }
+
+  void transcribe_repeated(const Obj& tmpl, const int depth, TemplateBindings& bindings, ArgList& out) {
+    std::vector<Symbol> variables {};
+    sequence_variables(tmpl, bindings, variables);
+    if (variables.empty()) {
+      throw std::runtime_error(std::format("syntax-rules: no pattern variable to repeat in {}", stringify(tmpl)));
+    }
+    const auto count = bindings.get(variables[0])->items.size();
+    for (const auto& var : variables) {
+      if (bindings.get(var)->items.size() != count) {
+        throw std::runtime_error(std::format("syntax-rules: pattern variables repeated together matched different lengths in {}", stringify(tmpl)));
+      }
+    }
+    for (size_t i = 0; i < count; i++) {
+      for (const auto& var : variables) {
+        bindings.repeated.emplace_back(var, &bindings.get(var)->items[i]);
+      }
+      if (depth == 1) {
+        out.push_back(transcribe(tmpl, bindings, true));
+      }
+      else {
+        transcribe_repeated(tmpl, depth - 1, bindings, out);
+      }
+      bindings.repeated.resize(bindings.repeated.size() - variables.size());
+    }
+  }
+
+  Obj transcribe(const Obj& tmpl, TemplateBindings& bindings, const bool ellipses) {
+    if (is_symbol(tmpl)) {
+      const auto sym = as_symbol(tmpl);
+      if (const auto binding = bindings.get(sym)) {
+        if (binding->is_sequence) {
+          throw std::runtime_error(std::format("syntax-rules: pattern variable {} used without an ellipsis", sym.get_name()));
+        }
+        return binding->value;
+      }
+      return rename(sym);
+    }
+    if (is_vector(tmpl)) {
+      auto ls = transcribe(vector_to_list(as_vector(tmpl)), bindings, ellipses);
+      ArgList data {};
+      for (; is_pair(ls); ls = as_pair(ls)->cdr) {
+        data.push_back(as_pair(ls)->car);
+      }
+      return interp.spawn<Vector>(std::move(data));
+    }
+    if (!is_pair(tmpl)) {
+      return tmpl;
+    }
+    // (... template) stands for template with ellipses taken literally
+    if (ellipses && is_ellipsis(as_pair(tmpl)->car) && is_pair(as_pair(tmpl)->cdr)) {
+      return transcribe(as_pair(tmpl)->at("cadr"), bindings, false);
+    }
+    ArgList items {};
+    Obj ls = tmpl;
+    while (is_pair(ls)) {
+      const auto element = as_pair(ls)->car;
+      ls = as_pair(ls)->cdr;
+      int depth = 0;
+      while (ellipses && is_pair(ls) && is_ellipsis(as_pair(ls)->car)) {
+        depth++;
+        ls = as_pair(ls)->cdr;
+      }
+      if (depth > 0) {
+        transcribe_repeated(element, depth, bindings, items);
+      }
+      else {
+        items.push_back(transcribe(element, bindings, ellipses));
+      }
+    }
+    Obj ret = is_null(ls) ? Obj {Null {}} : transcribe(ls, bindings, ellipses);
+    for (auto itr = items.rbegin(); itr != items.rend(); ++itr) {
+      ret = interp.spawn<Cons>(*itr, ret);
+    }
+    return ret;
+  }
+
+public:
+  Transformer(const Macro& macro, SyntaxTable& table, Interpreter& interp):
+    macro {macro},
+    table {table},
+    interp {interp}
+  {}
+
+  // the keyword positions of the pattern and the form are not matched
+  Obj expand(const Obj& form) {
+    for (const auto& [pattern, tmpl] : macro.rules) {
+      MatchBindings matched {};
+      if (match_list(as_pair(pattern)->cdr, as_pair(form)->cdr, matched)) {
+        TemplateBindings bindings {matched};
+        return transcribe(tmpl, bindings, true);
+      }
+    }
+    throw std::runtime_error(std::format("no syntax-rules pattern matches {}", stringify(form)));
+  }
+};
+
+}
+
+// whether a literal matches depends on what the identifier means where the
+// macro is used, so inside a binding form the expansion of a macro with
+// literals is not cached
+Obj
+SyntaxTable::expand(Macro *macro, const Obj& form, Interpreter& interp) {
+  const UseSite site {macro, form};
+  const bool cached = macro->literals.empty() || at_top_level();
+  const auto found = cached ? expansions.find(site) : expansions.end();
+  if (found != expansions.end()) {
+    return found->second;
+  }
+  const auto start = std::chrono::high_resolution_clock::now();
+  auto expansion = Transformer(*macro, *this, interp).expand(form);
+  if (interp.is_profiled()) {
+    const auto end = std::chrono::high_resolution_clock::now();
+    expanding_time += std::chrono::duration_cast<std::chrono::microseconds>(end - start);
+  }
+  if (!cached) {
+    return expansion;
+  }
+  if (expansions.size() >= MAX_CACHED_EXPANSIONS) {
+    expansions.clear();
+  }
+  expansions.emplace(site, expansion);
+  return expansion;
+}
+
+}
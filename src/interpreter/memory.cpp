@@ -2,11 +2,26 @@
 #include <interpreter/environment.hpp>
 #include <interpreter/expressions.hpp>
 #include <interpreter/memory.hpp>
+#include <interpreter/macros.hpp>
+#include <algorithm>
 
 namespace Scheme {
 
 void String::push_children(MarkStack&) {}
 
+void StringPort::push_children(MarkStack&) {}
+
+void
+Macro::push_children(MarkStack& worklist) {
+  for (auto& [pattern, tmpl] : rules) {
+    for (auto obj : {pattern, tmpl}) {
+      if (auto ent = try_get_heap_entity(obj)) {
+        worklist.push(ent);
+      }
+    }
+  }
+}
+
 void
 Cons::push_children(MarkStack& worklist) {
   if (auto car_ent = try_get_heap_entity(car)) {
@@ -26,7 +41,87 @@ Vector::push_children(MarkStack& worklist) {
   }
 }
 
-void Builtin::push_children(MarkStack&) {}
+void
+HashTable::push_children(MarkStack& worklist) {
+  for (Slot& slot : slots) {
+    if (!slot.full) {
+      continue;
+    }
+    if (auto ent = try_get_heap_entity(slot.key)) {
+      worklist.push(ent);
+    }
+    if (auto ent = try_get_heap_entity(slot.value)) {
+      worklist.push(ent);
+    }
+  }
+}
+
+void Bytevector::push_children(MarkStack&) {}
+
+void
+HamtNode::push_children(MarkStack& worklist) {
+  for (Entry& e : entries) {
+    if (e.child) {
+      worklist.push(e.child);
+      continue;
+    }
+    if (auto ent = try_get_heap_entity(e.key)) {
+      worklist.push(ent);
+    }
+    if (auto ent = try_get_heap_entity(e.value)) {
+      worklist.push(ent);
+    }
+  }
+}
+
+void
+PersistentMap::push_children(MarkStack& worklist) {
+  if (root) {
+    worklist.push(root);
+  }
+}
+
+void
+Promise::push_children(MarkStack& worklist) {
+  worklist.push(state);
+}
+
+void
+PromiseState::push_children(MarkStack& worklist) {
+  if (auto ent = try_get_heap_entity(value)) {
+    worklist.push(ent);
+  }
+  if (expr) {
+    worklist.push(expr);
+  }
+  if (env) {
+    worklist.push(env);
+  }
+  for (Obj& arg : args) {
+    if (auto ent = try_get_heap_entity(arg)) {
+      worklist.push(ent);
+    }
+  }
+}
+
+void RecordType::push_children(MarkStack&) {}
+
+void
+Record::push_children(MarkStack& worklist) {
+  worklist.push(type);
+  for (size_t i = 0; i < type->fields.size(); i++) {
+    if (auto ent = try_get_heap_entity(slots()[i])) {
+      worklist.push(ent);
+    }
+  }
+}
+
+void
+Builtin::push_children(MarkStack& worklist) {
+  if (record_type) {
+    worklist.push(record_type);
+  }
+}
 
 void 
 Procedure::push_children(MarkStack& worklist) {
@@ -34,6 +129,26 @@ Procedure::push_children(MarkStack& worklist) {
   worklist.push(env);
 }
 
+void
+Parameter::push_children(MarkStack& worklist) {
+  if (auto ent = try_get_heap_entity(value)) {
+    worklist.push(ent);
+  }
+  if (auto ent = try_get_heap_entity(converter)) {
+    worklist.push(ent);
+  }
+}
+
+void
+Coroutine::push_children(MarkStack& worklist) {
+  if (auto ent = try_get_heap_entity(thunk)) {
+    worklist.push(ent);
+  }
+  if (auto ent = try_get_heap_entity(transfer)) {
+    worklist.push(ent);
+  }
+}
+
 void
 Environment::push_children(MarkStack& worklist) {
   for (auto& [key, value] : frame) {
@@ -53,6 +168,7 @@ void Literal::push_children(MarkStack& worklist) {
 }
 
 void Variable::push_children(MarkStack& worklist) {}
+void GlobalVariable::push_children(MarkStack& worklist) {}
 
 void 
 Quoted::push_children(MarkStack& worklist) {
@@ -104,6 +220,19 @@ Define::push_children(MarkStack& worklist) {
   worklist.push(value);
 }
 
+void DefineRecord::push_children(MarkStack&) {}
+
+void
+Delay::push_children(MarkStack& worklist) {
+  worklist.push(expr);
+}
+
+void
+StreamCons::push_children(MarkStack& worklist) {
+  worklist.push(head);
+  worklist.push(tail);
+}
+
 void 
 Let::push_children(MarkStack& worklist) {
   for (auto& [key, value] : bindings) {
@@ -120,6 +249,14 @@ LetSeq::push_children(MarkStack& worklist) {
   worklist.push(body);
 }
 
+void
+LetValues::push_children(MarkStack& worklist) {
+  for (auto& binding : bindings) {
+    worklist.push(binding.expr);
+  }
+  worklist.push(body);
+}
+
 void
 Cond::push_children(MarkStack& worklist) {
   for (auto& clause : clauses) {
@@ -132,12 +269,63 @@ Cond::push_children(MarkStack& worklist) {
   }
 }
 
+void 
+Loop::push_children(MarkStack& worklist) {
+  for (auto init : inits) {
+    worklist.push(init);
+  }
+  worklist.push(body);
+}
+
+void 
+Recur::push_children(MarkStack& worklist) {
+  for (auto arg : args) {
+    worklist.push(arg);
+  }
+}
+
+void 
+Repeat::push_children(MarkStack& worklist) {
+  worklist.push(body);
+}
+
+void 
+SelfCall::push_children(MarkStack& worklist) {
+  worklist.push(recur);
+  worklist.push(call);
+}
+
+void 
+Parameterize::push_children(MarkStack& worklist) {
+  for (auto& [param, value] : bindings) {
+    worklist.push(param);
+    worklist.push(value);
+  }
+  worklist.push(body);
+}
+
+void 
+Guard::push_children(MarkStack& worklist) {
+  for (auto& clause : clauses) {
+    if (clause.predicate) {
+      worklist.push(clause.predicate);
+    }
+    if (clause.actions) {
+      worklist.push(clause.actions);
+    }
+  }
+  worklist.push(body);
+}
+
 void 
 Application::push_children(MarkStack& worklist) {
   worklist.push(op);
   for (auto& param : params) {
     worklist.push(param);
   }
+  if (feedback_target) {
+    worklist.push(feedback_target);
+  }
 }
 
 void
@@ -154,6 +342,113 @@ Or::push_children(MarkStack& worklist) {
   }
 }
 
+void
+PinnedObj::push_roots(std::vector<HeapEntity*>& roots) {
+  for (auto pin = pins; pin; pin = pin->next) {
+    auto obj = pin->obj;
+    if (auto ent = try_get_heap_entity(obj)) {
+      roots.push_back(ent);
+    }
+  }
+}
+
+// collections during evaluation are paid for by allocation: the next waits
+// until the live objects have doubled, and for a floor of them
+static constexpr size_t MIN_COLLECTION_THRESHOLD = size_t {1} << 17;
+// how many bytes held outside the objects count as one object
+static constexpr size_t HELD_BYTES_PER_OBJECT = 64;
+
+void
+Allocator::defer_collection() {
+  threshold = std::max(MIN_COLLECTION_THRESHOLD, 2 * (live_memory.size() + held));
+}
+
+void
+Allocator::hold(const size_t bytes) {
+  held += bytes / HELD_BYTES_PER_OBJECT;
+}
+
+void
+Allocator::index() {
+  by_address = live_memory;
+  std::sort(by_address.begin(), by_address.end());
+  blocks.clear();
+  for (auto block = scanned_blocks.next; block != &scanned_blocks; block = block->next) {
+    blocks.push_back(block);
+  }
+  std::sort(blocks.begin(), blocks.end());
+  indexed = true;
+}
+
+void
+Allocator::drop_index() {
+  if (indexed) {
+    for (auto block : blocks) {
+      block->scanned = false;
+    }
+    by_address.clear();
+    blocks.clear();
+    indexed = false;
+  }
+}
+
+// the object that addr points into, if any, interior pointers included
+HeapEntity*
+Allocator::find_entity(const uintptr_t addr) const {
+  auto itr = std::upper_bound(by_address.begin(), by_address.end(), addr, [](uintptr_t a, HeapEntity *ent) {
+    return a < reinterpret_cast<uintptr_t>(ent);
+  });
+  if (itr == by_address.begin()) {
+    return nullptr;
+  }
+  const auto ent = *--itr;
+  return addr < reinterpret_cast<uintptr_t>(ent) + ent->extent ? ent : nullptr;
+}
+
+ScannedBlock*
+Allocator::find_block(const uintptr_t addr) const {
+  auto itr = std::upper_bound(blocks.begin(), blocks.end(), addr, [](uintptr_t a, ScannedBlock *block) {
+    return a < reinterpret_cast<uintptr_t>(block + 1);
+  });
+  if (itr == blocks.begin()) {
+    return nullptr;
+  }
+  const auto block = *--itr;
+  return addr < reinterpret_cast<uintptr_t>(block + 1) + block->bytes ? block : nullptr;
+}
+
+// a conservative scan: every aligned word in [lo, hi) that points into a
+// live object makes the object a root, and one that points into a scanned
+// buffer has the buffer scanned the same way. a word that only looks like
+// such a pointer keeps something alive until a later collection.
+void
+Allocator::scan(const void *lo, const void *hi, std::vector<HeapEntity*>& roots) {
+  if (!indexed) {
+    index();
+  }
+  const auto align = [](const void *ptr) {
+    const auto addr = reinterpret_cast<uintptr_t>(ptr);
+    return reinterpret_cast<const uintptr_t*>((addr + sizeof(uintptr_t) - 1) & ~(sizeof(uintptr_t) - 1));
+  };
+  std::vector<std::pair<const uintptr_t*, const uintptr_t*>> pending {{align(lo), static_cast<const uintptr_t*>(hi)}};
+  while (!pending.empty()) {
+    const auto [from, to] = pending.back();
+    pending.pop_back();
+    for (auto word = from; word < to; word++) {
+      if (const auto ent = find_entity(*word)) {
+        roots.push_back(ent);
+      }
+      else if (const auto block = find_block(*word); block && !block->scanned) {
+        block->scanned = true;
+        const auto data = reinterpret_cast<const char*>(block + 1);
+        pending.emplace_back(align(data), reinterpret_cast<const uintptr_t*>(data + block->bytes));
+      }
+    }
+  }
+}
+
+// a continuation's copy of the stack, or a suspended coroutine's stacks, are
+// scanned once it is marked, and what that finds can mark more in turn
 void 
 Allocator::mark(const std::vector<HeapEntity*>& roots) {
   MarkStack worklist;
@@ -163,17 +458,53 @@ Allocator::mark(const std::vector<HeapEntity*>& roots) {
     }
   }
 
+  std::vector<HeapEntity*> found;
   while (!worklist.empty()) {
-    auto curr = worklist.top();
-    worklist.pop();
+    while (!worklist.empty()) {
+      auto curr = worklist.top();
+      worklist.pop();
+
+      if (!curr->marked) {
+        curr->marked = true;
+        curr->push_children(worklist);
+      }
+    }
 
-    if (!curr->marked) {
-      curr->marked = true;
-      curr->push_children(worklist);
+    found.clear();
+    for (auto k : continuations) {
+      if (k->marked && !k->scanned) {
+        k->scanned = true;
+        k->scan(*this, found);
+      }
+    }
+    for (auto co : coroutines) {
+      if (co->marked && !co->scanned) {
+        co->scanned = true;
+        co->scan(*this, found);
+      }
+    }
+    for (auto ent : found) {
+      if (!ent->marked) {
+        worklist.push(ent);
+      }
     }
   }
 }
 
+void
+Allocator::unmark() {
+  for (auto ptr : live_memory) {
+    ptr->marked = false;
+  }
+  for (auto k : continuations) {
+    k->scanned = false;
+  }
+  for (auto co : coroutines) {
+    co->scanned = false;
+  }
+  drop_index();
+}
+
 void
 Allocator::sweep() {
   auto is_dead = [](HeapEntity *ptr) {
@@ -187,7 +518,22 @@ Allocator::sweep() {
     }
   };
 
+  // the index goes first, as the dead may free scanned buffers of their own
+  drop_index();
+  held = 0;
+  std::erase_if(continuations, [this](Continuation *k) {
+    k->scanned = false;
+    if (k->marked) {
+      hold(k->bytes());
+    }
+    return !k->marked;
+  });
+  std::erase_if(coroutines, [](Coroutine *co) {
+    co->scanned = false;
+    return !co->marked;
+  });
   std::erase_if(live_memory, is_dead);
+  defer_collection();
 }
 
 void
@@ -55,25 +55,33 @@ Parser::symbol() {
 
 Obj
 Parser::number() {
-  try {
-    size_t chars_processed;
-    const double val = std::stod(std::string(curr_token().lexeme), &chars_processed);
-
-    if (chars_processed == curr_token().lexeme.size()) {
-      return val;
-    }
-    else {
-      return symbol();
-    }
-  }
-  catch (const std::exception& e) {
-    return symbol();
-  }
+  return curr_token().number;
 }
 
 Obj 
 Parser::character() {
-  return curr_token().lexeme.front();
+  const auto lexeme = curr_token().lexeme;
+  if (lexeme.size() == 1) {
+    return lexeme.front();
+  }
+  else if (lexeme == "space") {
+    return ' ';
+  }
+  else if (lexeme == "newline" || lexeme == "linefeed") {
+    return '\n';
+  }
+  else if (lexeme == "tab") {
+    return '\t';
+  }
+  else if (lexeme == "return") {
+    return '\r';
+  }
+  else if (lexeme == "null" || lexeme == "nul") {
+    return '\0';
+  }
+  else {
+    throw std::runtime_error("unknown character name: " + std::string(lexeme));
+  }
 }
 
 Obj
@@ -93,6 +101,9 @@ Parser::parse_atom() {
 
     case Token::VEC_BEGIN:
       return parse_vec();
+
+    case Token::BYTEVEC_BEGIN:
+      return parse_bytevec();
       
     case Token::DOT:
       return parse_dotted_tail();
@@ -115,16 +126,6 @@ Parser::parse_atom() {
     case Token::FALSE:
       return false;
       
-    case Token::PLUS_INF:
-      return std::numeric_limits<double>::infinity();
-      
-    case Token::MINUS_INF:
-      return -std::numeric_limits<double>::infinity();
-      
-    case Token::PLUS_NAN:
-    case Token::MINUS_NAN:
-      return std::numeric_limits<double>::quiet_NaN();
-      
     case Token::NUMBER:
       return number();
       
@@ -159,13 +160,28 @@ Parser::parse_list() {
 
 Obj
 Parser::parse_vec() {
-  std::vector<Obj> ret {};
+  ArgList ret {};
   while (!match(Token::RPAREN)) {
     ret.push_back(parse_atom());
   }
   return interp.spawn<Vector>(std::move(ret));
 }
 
+Obj
+Parser::parse_bytevec() {
+  std::vector<uint8_t> bytes {};
+  while (!match(Token::RPAREN)) {
+    const auto byte = parse_atom();
+    if (!is_number(byte) || !(0 <= as_number(byte) && as_number(byte) <= 255) || as_number(byte) != std::trunc(as_number(byte))) {
+      throw std::runtime_error("bytevector elements must be integers between 0 and 255");
+    }
+    bytes.push_back(as_number(byte));
+  }
+  const auto ret = interp.spawn<Bytevector>(bytes.size());
+  std::copy(bytes.begin(), bytes.end(), ret->data());
+  return ret;
+}
+
 Obj 
 Parser::parse_dotted_tail() {
   if (match(Token::RPAREN)) {
@@ -0,0 +1,316 @@
+#include <interpreter/types.hpp>
+#include <interpreter/interpreter.hpp>
+#include <interpreter/persistent_map.hpp>
+#include <bit>
+
+namespace Scheme {
+
+static constexpr unsigned BITS = 5;
+static constexpr unsigned HASH_BITS = 64;
+
+using Entry = HamtNode::Entry;
+
+static uint32_t
+branch_bit(const size_t hash, const unsigned shift) {
+  return uint32_t {1} << ((hash >> shift) & 31);
+}
+
+static size_t
+branch_index(const uint32_t bitmap, const uint32_t bit) {
+  return std::popcount(bitmap & (bit - 1));
+}
+
+// the node itself if the transient owning edit may change it, else a copy
+// that it may
+static HamtNode*
+editable(HamtNode *node, const uint64_t edit, Interpreter& interp) {
+  if (edit != 0 && node->edit == edit) {
+    return node;
+  }
+  return interp.spawn<HamtNode>(node->bitmap, node->collision, edit, node->entries);
+}
+
+static HamtNode*
+make_pair_node(const unsigned shift, Entry a, Entry b, const uint64_t edit, Interpreter& interp) {
+  if (a.hash == b.hash || shift >= HASH_BITS) {
+    return interp.spawn<HamtNode>(0, true, edit, std::vector<Entry> {std::move(a), std::move(b)});
+  }
+  const auto bit_a = branch_bit(a.hash, shift);
+  const auto bit_b = branch_bit(b.hash, shift);
+  if (bit_a == bit_b) {
+    const auto child = make_pair_node(shift + BITS, std::move(a), std::move(b), edit, interp);
+    return interp.spawn<HamtNode>(bit_a, false, edit, std::vector<Entry> {{Void {}, Void {}, 0, child}});
+  }
+  std::vector<Entry> entries {};
+  if (bit_a < bit_b) {
+    entries = {std::move(a), std::move(b)};
+  }
+  else {
+    entries = {std::move(b), std::move(a)};
+  }
+  return interp.spawn<HamtNode>(bit_a | bit_b, false, edit, std::move(entries));
+}
+
+static const Obj*
+find_in(const HamtNode *node, unsigned shift, const size_t hash, const Obj& key) {
+  while (node) {
+    if (node->collision) {
+      for (const auto& e : node->entries) {
+        if (e.hash == hash && equal(e.key, key)) {
+          return &e.value;
+        }
+      }
+      return nullptr;
+    }
+    const auto bit = branch_bit(hash, shift);
+    if (!(node->bitmap & bit)) {
+      return nullptr;
+    }
+    const auto& e = node->entries[branch_index(node->bitmap, bit)];
+    if (e.child) {
+      node = e.child;
+      shift += BITS;
+    }
+    else {
+      return e.hash == hash && equal(e.key, key) ? &e.value : nullptr;
+    }
+  }
+  return nullptr;
+}
+
+static HamtNode*
+assoc_in(HamtNode *node, const unsigned shift, Entry leaf, const uint64_t edit, bool& added, Interpreter& interp) {
+  if (!node) {
+    added = true;
+    const auto bit = branch_bit(leaf.hash, shift);
+    return interp.spawn<HamtNode>(bit, false, edit, std::vector<Entry> {std::move(leaf)});
+  }
+
+  if (node->collision) {
+    const auto shared_hash = node->entries[0].hash;
+    if (leaf.hash != shared_hash && shift < HASH_BITS) {
+      // a key that only shares a prefix with the colliding ones: push the
+      // collision node one level down and branch above it
+      const auto bit = branch_bit(shared_hash, shift);
+      const auto branch = interp.spawn<HamtNode>(bit, false, edit, std::vector<Entry> {{Void {}, Void {}, 0, node}});
+      return assoc_in(branch, shift, std::move(leaf), edit, added, interp);
+    }
+    for (size_t i = 0; i < node->entries.size(); i++) {
+      if (equal(node->entries[i].key, leaf.key)) {
+        const auto ret = editable(node, edit, interp);
+        ret->entries[i].value = std::move(leaf.value);
+        return ret;
+      }
+    }
+    added = true;
+    const auto ret = editable(node, edit, interp);
+    ret->entries.push_back(std::move(leaf));
+    return ret;
+  }
+
+  const auto bit = branch_bit(leaf.hash, shift);
+  const auto index = branch_index(node->bitmap, bit);
+
+  if (!(node->bitmap & bit)) {
+    added = true;
+    const auto ret = editable(node, edit, interp);
+    ret->bitmap |= bit;
+    ret->entries.insert(ret->entries.begin() + index, std::move(leaf));
+    return ret;
+  }
+
+  const auto& e = node->entries[index];
+  if (e.child) {
+    const auto child = assoc_in(e.child, shift + BITS, std::move(leaf), edit, added, interp);
+    if (child == e.child) {
+      return node;
+    }
+    const auto ret = editable(node, edit, interp);
+    ret->entries[index].child = child;
+    return ret;
+  }
+  else if (e.hash == leaf.hash && equal(e.key, leaf.key)) {
+    const auto ret = editable(node, edit, interp);
+    ret->entries[index].value = std::move(leaf.value);
+    return ret;
+  }
+  else {
+    added = true;
+    const auto child = make_pair_node(shift + BITS, e, std::move(leaf), edit, interp);
+    const auto ret = editable(node, edit, interp);
+    ret->entries[index] = Entry {Void {}, Void {}, 0, child};
+    return ret;
+  }
+}
+
+// nullptr once the node is empty. a child left holding a single leaf is
+// pulled up into its parent so lookups stay short.
+static HamtNode*
+dissoc_in(HamtNode *node, const unsigned shift, const size_t hash, const Obj& key, const uint64_t edit, bool& removed, Interpreter& interp) {
+  if (!node) {
+    return nullptr;
+  }
+
+  if (node->collision) {
+    for (size_t i = 0; i < node->entries.size(); i++) {
+      if (equal(node->entries[i].key, key)) {
+        removed = true;
+        if (node->entries.size() == 1) {
+          return nullptr;
+        }
+        const auto ret = editable(node, edit, interp);
+        ret->entries.erase(ret->entries.begin() + i);
+        return ret;
+      }
+    }
+    return node;
+  }
+
+  const auto bit = branch_bit(hash, shift);
+  if (!(node->bitmap & bit)) {
+    return node;
+  }
+  const auto index = branch_index(node->bitmap, bit);
+  const auto& e = node->entries[index];
+
+  if (e.child) {
+    const auto child = dissoc_in(e.child, shift + BITS, hash, key, edit, removed, interp);
+    if (child == e.child) {
+      return node;
+    }
+    const auto ret = editable(node, edit, interp);
+    if (!child) {
+      ret->bitmap &= ~bit;
+      ret->entries.erase(ret->entries.begin() + index);
+      return ret->entries.empty() ? nullptr : ret;
+    }
+    if (child->entries.size() == 1 && !child->entries[0].child) {
+      ret->entries[index] = child->entries[0];
+    }
+    else {
+      ret->entries[index].child = child;
+    }
+    return ret;
+  }
+  else if (e.hash == hash && equal(e.key, key)) {
+    removed = true;
+    if (node->entries.size() == 1) {
+      return nullptr;
+    }
+    const auto ret = editable(node, edit, interp);
+    ret->bitmap &= ~bit;
+    ret->entries.erase(ret->entries.begin() + index);
+    return ret;
+  }
+  else {
+    return node;
+  }
+}
+
+const Obj*
+PersistentMap::find(const Obj& key) const {
+  return find_in(root, 0, equal_hash(key), key);
+}
+
+PersistentMap*
+PersistentMap::assoc(const Obj& key, const Obj& value, Interpreter& interp) const {
+  if (transient) {
+    throw std::runtime_error("transient map cannot be updated persistently");
+  }
+  bool added = false;
+  const auto new_root = assoc_in(root, 0, Entry {key, value, equal_hash(key), nullptr}, 0, added, interp);
+  return interp.spawn<PersistentMap>(new_root, count + added, is_set);
+}
+
+PersistentMap*
+PersistentMap::dissoc(const Obj& key, Interpreter& interp) const {
+  if (transient) {
+    throw std::runtime_error("transient map cannot be updated persistently");
+  }
+  bool removed = false;
+  const auto new_root = dissoc_in(root, 0, equal_hash(key), key, 0, removed, interp);
+  if (!removed) {
+    return const_cast<PersistentMap*>(this);
+  }
+  return interp.spawn<PersistentMap>(new_root, count - 1, is_set);
+}
+
+void
+PersistentMap::assoc_in_place(const Obj& key, const Obj& value, Interpreter& interp) {
+  if (!transient) {
+    throw std::runtime_error("transient map used after being made persistent");
+  }
+  bool added = false;
+  root = assoc_in(root, 0, Entry {key, value, equal_hash(key), nullptr}, edit, added, interp);
+  count += added;
+}
+
+void
+PersistentMap::dissoc_in_place(const Obj& key, Interpreter& interp) {
+  if (!transient) {
+    throw std::runtime_error("transient map used after being made persistent");
+  }
+  bool removed = false;
+  root = dissoc_in(root, 0, equal_hash(key), key, edit, removed, interp);
+  count -= removed;
+}
+
+PersistentMap*
+PersistentMap::make_transient(Interpreter& interp) const {
+  static uint64_t next_edit = 0;
+  const auto ret = interp.spawn<PersistentMap>(root, count, is_set);
+  ret->edit = ++next_edit;
+  ret->transient = true;
+  return ret;
+}
+
+// the transient's token is retired, so the nodes it edited are frozen from
+// here on and may be shared freely
+PersistentMap*
+PersistentMap::make_persistent(Interpreter& interp) {
+  if (!transient) {
+    throw std::runtime_error("transient map used after being made persistent");
+  }
+  transient = false;
+  edit = 0;
+  return interp.spawn<PersistentMap>(root, count, is_set);
+}
+
+std::vector<const HamtNode::Entry*>
+PersistentMap::leaves() const {
+  std::vector<const Entry*> ret {};
+  ret.reserve(count);
+  std::vector<const HamtNode*> stack {};
+  if (root) {
+    stack.push_back(root);
+  }
+  while (!stack.empty()) {
+    const auto node = stack.back();
+    stack.pop_back();
+    for (const auto& e : node->entries) {
+      if (e.child) {
+        stack.push_back(e.child);
+      }
+      else {
+        ret.push_back(&e);
+      }
+    }
+  }
+  return ret;
+}
+
+bool
+PersistentMap::equals(const PersistentMap& other) const {
+  if (count != other.count || is_set != other.is_set) {
+    return false;
+  }
+  for (const auto e : leaves()) {
+    const auto found = find_in(other.root, 0, e->hash, e->key);
+    if (!found || (!is_set && !equal(e->value, *found))) {
+      return false;
+    }
+  }
+  return true;
+}
+
+}
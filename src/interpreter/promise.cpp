@@ -0,0 +1,70 @@
+#include <interpreter/types.hpp>
+#include <interpreter/expressions.hpp>
+#include <interpreter/promise.hpp>
+#include <interpreter/interpreter.hpp>
+
+namespace Scheme {
+
+// drops the computation so that whatever it referenced can be collected
+void
+PromiseState::resolve(Obj result) {
+  done = true;
+  lazy = false;
+  value = std::move(result);
+  expr = nullptr;
+  env = nullptr;
+  step = nullptr;
+  args.clear();
+}
+
+void
+PromiseState::adopt(const PromiseState& other) {
+  done = other.done;
+  lazy = other.lazy;
+  value = other.value;
+  expr = other.expr;
+  env = other.env;
+  step = other.step;
+  args = other.args;
+}
+
+// R7RS force, iterative over delay-force chains. forcing a non-promise
+// returns it unchanged. if forcing re-enters the same promise, the value
+// that is ready first wins.
+Obj
+force(const Obj& obj, Interpreter& interp) {
+  if (!is_promise(obj)) {
+    return obj;
+  }
+  const auto promise = as_promise(obj);
+  while (true) {
+    interp.safe_point();
+    auto state = promise->state;
+    if (state->done) {
+      return state->value;
+    }
+    auto result =
+        state->expr
+      ? interp.one_value(as_obj(state->expr->eval(state->env, interp)))
+      : state->step(state->args, interp);
+
+    state = promise->state;
+    if (state->done) {
+      return state->value;
+    }
+    if (!state->lazy) {
+      state->resolve(result);
+      return state->value;
+    }
+    if (!is_promise(result)) {
+      throw std::runtime_error("delay-force: expression did not yield a promise, got " + stringify(result));
+    }
+    const auto inner = as_promise(result);
+    if (inner->state != state) {
+      state->adopt(*inner->state);
+      inner->state = state;
+    }
+  }
+}
+
+}
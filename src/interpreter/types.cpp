@@ -1,7 +1,17 @@
 #include <interpreter/types.hpp>
+#include <interpreter/persistent_map.hpp>
+#include <interpreter/promise.hpp>
 #include <string>
-#include <sstream>
-#include <format>
+#include <charconv>
+#include <cmath>
+#include <cstdint>
+#include <bit>
+#include <functional>
+#include <string_view>
+#include <algorithm>
+#include <optional>
+#include <unordered_map>
+#include <utility>
 
 namespace Scheme {
 
@@ -50,144 +60,405 @@ list_profile(const Obj ls) {
   }
 }
 
+// compares everything but pairs and vectors, which equal walks itself
+static bool
+equal_leaves(const Obj& obj_0, const Obj& obj_1) {
+  return std::visit(Overloaded{
+    [&](PersistentMap*) -> bool {
+      return obj_0 == obj_1 || as_pmap(obj_0)->equals(*as_pmap(obj_1));
+    },
+
+    [&](Bytevector*) -> bool {
+      const auto a = as_bytevector(obj_0);
+      const auto b = as_bytevector(obj_1);
+      return std::equal(a->data(), a->data() + a->size(), b->data(), b->data() + b->size());
+    },
+
+    [&](String*) -> bool {
+      return as_string(obj_0)->data == as_string(obj_1)->data;
+    },
+
+    [&](Null) -> bool {
+      return true;
+    },
+
+    [&](Void) -> bool {
+      return true;
+    },
+
+    [&](const auto&) -> bool {
+      return obj_0 == obj_1;
+    },
+  }, obj_0);
+}
+
+// union-find over the pairs and vectors compared so far. two nodes in the
+// same class are assumed equal, which is what makes cyclic structures
+// terminate: a comparison that comes back around is not repeated.
+class EquivalenceClasses {
+private:
+  std::unordered_map<const HeapEntity*, const HeapEntity*> parent;
+
+  const HeapEntity *find(const HeapEntity *x) {
+    const HeapEntity *root = x;
+    for (auto found = parent.find(root); found != parent.end(); found = parent.find(root)) {
+      root = found->second;
+    }
+    while (x != root) {
+      x = std::exchange(parent[x], root);
+    }
+    return root;
+  }
+
+public:
+  // true if a and b were already known to be equivalent; merges them if not
+  bool unite(const HeapEntity *a, const HeapEntity *b) {
+    const auto root_a = find(a);
+    const auto root_b = find(b);
+    if (root_a == root_b) {
+      return true;
+    }
+    parent[root_a] = root_b;
+    return false;
+  }
+};
+
+// structures up to this many pairs and vectors are compared without the
+// bookkeeping for cycles
+static constexpr int EQUAL_CYCLE_BUDGET = 1000;
+
+// iterative, so neither deep nor long structures use the C++ stack
 bool
 equal(const Obj obj_0, const Obj obj_1) {
-  if (!same_type(obj_0, obj_1)) {
-    return false;
+  std::vector<std::pair<Obj, Obj>> worklist {{obj_0, obj_1}};
+  std::optional<EquivalenceClasses> classes {};
+  int budget = EQUAL_CYCLE_BUDGET;
+
+  // false if a and b have been compared before and need not be again
+  const auto first_visit = [&](const HeapEntity *a, const HeapEntity *b) {
+    if (a == b) {
+      return false;
+    }
+    if (budget > 0) {
+      budget--;
+      return true;
+    }
+    if (!classes) {
+      classes.emplace();
+    }
+    return !classes->unite(a, b);
+  };
+
+  while (!worklist.empty()) {
+    const auto [a, b] = std::move(worklist.back());
+    worklist.pop_back();
+    if (!same_type(a, b)) {
+      return false;
+    }
+    if (is_pair(a)) {
+      const auto x = as_pair(a);
+      const auto y = as_pair(b);
+      if (first_visit(x, y)) {
+        // the car is compared first, and a list's spine does not pile up
+        worklist.emplace_back(x->cdr, y->cdr);
+        worklist.emplace_back(x->car, y->car);
+      }
+    }
+    else if (is_vector(a)) {
+      const auto& x = as_vector(a)->data;
+      const auto& y = as_vector(b)->data;
+      if (x.size() != y.size()) {
+        return false;
+      }
+      if (first_visit(as_vector(a), as_vector(b))) {
+        for (size_t i = x.size(); i > 0; i--) {
+          worklist.emplace_back(x[i - 1], y[i - 1]);
+        }
+      }
+    }
+    else if (!equal_leaves(a, b)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// splitmix64 finalizer. std::hash is the identity for pointers and integers,
+// which would leave the low bits hash tables mask on mostly zero.
+static size_t
+mix_hash(uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ULL;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static size_t
+combine_hash(const size_t seed, const size_t h) {
+  return mix_hash(seed ^ (h + 0x9e3779b97f4a7c15ULL + (seed << 6) + (seed >> 2)));
+}
+
+size_t
+eqv_hash(const Obj& obj) {
+  const uint64_t tag = obj.index();
+  return std::visit(Overloaded{
+    [=](const bool b) -> size_t {
+      return mix_hash(tag << 8 | b);
+    },
+    [=](const double n) -> size_t {
+      // eqv? compares numbers with ==, so 0.0 and -0.0 must collide
+      return mix_hash(std::bit_cast<uint64_t>(n == 0 ? 0.0 : n));
+    },
+    [=](const char c) -> size_t {
+      return mix_hash(tag << 8 | static_cast<unsigned char>(c));
+    },
+    [=](const Symbol& s) -> size_t {
+      return mix_hash(reinterpret_cast<uintptr_t>(s.id));
+    },
+    [=](const Null) -> size_t {
+      return mix_hash(tag);
+    },
+    [=](const Void) -> size_t {
+      return mix_hash(tag);
+    },
+    [=](const auto *ptr) -> size_t {
+      return mix_hash(reinterpret_cast<uintptr_t>(ptr));
+    },
+  }, obj);
+}
+
+size_t
+string_hash(const std::string& str) {
+  return mix_hash(std::hash<std::string_view>()(str));
+}
+
+// only the first EQUAL_HASH_BUDGET nodes of a structure contribute, which keeps
+// hashing of long or circular structures bounded and is still consistent with
+// equal: equal structures agree on every node that is visited
+static constexpr int EQUAL_HASH_BUDGET = 64;
+
+static size_t
+equal_hash_impl(const Obj& obj, int& budget) {
+  if (budget-- <= 0) {
+    return 0;
+  }
+  if (is_string(obj)) {
+    return string_hash(as_string(obj)->data);
+  }
+  else if (is_pair(obj)) {
+    size_t ret = mix_hash(obj.index());
+    Obj curr = obj;
+    while (is_pair(curr) && budget > 0) {
+      ret = combine_hash(ret, equal_hash_impl(as_pair(curr)->car, budget));
+      curr = as_pair(curr)->cdr;
+    }
+    if (!is_pair(curr)) {
+      ret = combine_hash(ret, equal_hash_impl(curr, budget));
+    }
+    return ret;
+  }
+  else if (is_bytevector(obj)) {
+    const auto b = as_bytevector(obj);
+    const std::string_view bytes(reinterpret_cast<const char*>(b->data()), b->size());
+    return mix_hash(std::hash<std::string_view>()(bytes));
+  }
+  else if (is_pmap(obj)) {
+    // equal maps may differ in layout, so only the size is hashed
+    return mix_hash(as_pmap(obj)->count);
+  }
+  else if (is_vector(obj)) {
+    const auto& data = as_vector(obj)->data;
+    size_t ret = mix_hash(data.size());
+    for (size_t i = 0; i < data.size() && budget > 0; i++) {
+      ret = combine_hash(ret, equal_hash_impl(data[i], budget));
+    }
+    return ret;
   }
   else {
-    return std::visit(Overloaded{
-      [=](bool) -> bool {
-        return obj_0 == obj_1;
-      },
-
-      [=](double) -> bool {
-        return obj_0 == obj_1;
-      },
-
-      [=](char) -> bool {
-        return obj_0 == obj_1;
-      },
-
-      [=](Symbol) -> bool {
-        return obj_0 == obj_1;
-      },
-
-      [=](Procedure*) -> bool {
-        return obj_0 == obj_1;
-      },
-
-      [=](Builtin*) -> bool {
-        return obj_0 == obj_1;
-      },
-
-      [=](Null) -> bool {
-        return true;
-      },
-
-      [=](Void) -> bool {
-        return true;
-      },
-
-      [=](String*) -> bool {
-        return as_string(obj_0)->data == as_string(obj_1)->data;
-      },
-      
-      [=](Cons*) -> bool {
-        return (
-          equal(as_pair(obj_0)->car, as_pair(obj_1)->car) &&
-          equal(as_pair(obj_0)->cdr, as_pair(obj_1)->cdr)
-        );
-      },
+    return eqv_hash(obj);
+  }
+}
 
-      [=](Vector*) -> bool {
-        return std::equal(
-          as_vector(obj_0)->data.begin(),
-          as_vector(obj_0)->data.end(), 
-          as_vector(obj_1)->data.begin(), 
-          equal
-        );
-      },
+size_t
+equal_hash(const Obj& obj) {
+  int budget = EQUAL_HASH_BUDGET;
+  return equal_hash_impl(obj, budget);
+}
 
-    }, obj_0);
+static void
+write_number(std::string& out, const double n) {
+  if (std::isnan(n)) {
+    out += "+nan.0";
+  }
+  else if (std::isinf(n)) {
+    out += n > 0 ? "+inf.0" : "-inf.0";
+  }
+  else {
+    // integral values print without an exponent, as 200000 rather than 2e+05
+    char buf[32];
+    const bool fixed = n == std::trunc(n) && std::abs(n) < 1e21;
+    const auto [end, ec] =
+        fixed
+      ? std::to_chars(buf, buf + sizeof(buf), n, std::chars_format::fixed)
+      : std::to_chars(buf, buf + sizeof(buf), n);
+    out.append(buf, end);
   }
 }
-std::string 
-stringify(const Obj obj) {
-  return std::visit(Overloaded{
-    [](const bool b) -> std::string {
-      return b ? "#t" : "#f";
+
+// <point> prints as point
+static std::string_view
+record_type_name(const RecordType *t) {
+  std::string_view name = t->name.get_name();
+  if (name.size() > 2 && name.front() == '<' && name.back() == '>') {
+    name = name.substr(1, name.size() - 2);
+  }
+  return name;
+}
+
+static void
+write_address(std::string& out, const void *p) {
+  char buf[2 * sizeof(void*) + 2] = {'0', 'x'};
+  const auto [end, ec] = std::to_chars(buf + 2, buf + sizeof(buf), reinterpret_cast<uintptr_t>(p), 16);
+  out += "<procedure at ";
+  out.append(buf, end);
+  out += ">";
+}
+
+void
+stringify_into(std::string& out, const Obj obj) {
+  std::visit(Overloaded{
+    [&](const bool b) {
+      out += b ? "#t" : "#f";
     },
 
-    [](const double n) -> std::string {
-      return std::format("{}", n);
+    [&](const double n) {
+      write_number(out, n);
     },
 
-    [](const char n) -> std::string {
-      return std::format("#\\{}", n);
+    [&](const char n) {
+      out += "#\\";
+      out += n;
     },
 
-    [](const Symbol& s) -> std::string {
-      return s.get_name();
+    [&](const Symbol& s) {
+      out += s.get_name();
     },
 
-[](const String *w) -> std::string {
-      return w->data;
+    [&](const String *w) {
+      out += w->data;
     },
     
-    [](Cons* const ls) -> std::string {
-      if (!ls) {
-        return "()";
-      }
-      
-      std::ostringstream ret;
-      ret << "(" << stringify(ls->car);
+    [&](Cons* const ls) {
+      out += "(";
+      stringify_into(out, ls->car);
       
       Obj curr = ls->cdr;
       while (is_pair(curr)) {
-        ret << " " << stringify(as_pair(curr)->car);
+        out += " ";
+        stringify_into(out, as_pair(curr)->car);
         curr = as_pair(curr)->cdr;
       }
       
       if (!is_null(curr)) {
-        ret << " . " << stringify(curr);
+        out += " . ";
+        stringify_into(out, curr);
       }
       
-      ret << ")";
-      return ret.str();
+      out += ")";
     },
 
-    [](Vector* const v) -> std::string {
-      if (v->data.empty()) {
-        return "#()";
+    [&](Vector* const v) {
+      out += "#(";
+      for (size_t i = 0; i < v->data.size(); i++) {
+        if (i > 0) {
+          out += " ";
+        }
+        stringify_into(out, v->data[i]);
       }
-      std::ostringstream ret;
-      ret << "#(" << stringify(v->data[0]);
-      for (size_t i = 1; i < v->data.size(); i++) {
-        ret << " " << stringify(v->data[i]);
+      out += ")";
+    },
+
+    [&](const Procedure* p) {
+      write_address(out, p);
+    },
+
+    [&](const Builtin* p) {
+      write_address(out, p);
+    },
+
+    [&](const Parameter*) {
+      out += "#<parameter>";
+    },
+
+    [&](const Coroutine*) {
+      out += "#<generator>";
+    },
+
+    [&](const HashTable*) {
+      out += "#<hash-table>";
+    },
+
+    [&](const StringPort*) {
+      out += "#<string-port>";
+    },
+
+    [&](const Promise* p) {
+      out += p->stream ? "#<stream>" : "#<promise>";
+    },
+
+    [&](const RecordType* t) {
+      out += "#<record-type ";
+      out += record_type_name(t);
+      out += ">";
+    },
+
+    [&](const Record* r) {
+      out += "#<";
+      out += record_type_name(r->type);
+      for (size_t i = 0; i < r->type->fields.size(); i++) {
+        out += " ";
+        stringify_into(out, r->slots()[i]);
       }
-      ret << ")";
-      return ret.str();
+      out += ">";
     },
 
-    [](const Procedure* p) -> std::string {
-      return std::format("<procedure at {}>", static_cast<const void*>(p));
+    [&](const PersistentMap* m) {
+      out += m->is_set ? "#<pset " : "#<pmap ";
+      write_number(out, m->count);
+      out += ">";
     },
 
-    [](const Builtin* p) -> std::string {
-      return std::format("<procedure at {}>", static_cast<const void*>(p));
+    [&](const Bytevector* b) {
+      out += "#u8(";
+      for (size_t i = 0; i < b->size(); i++) {
+        if (i > 0) {
+          out += " ";
+        }
+        char buf[4];
+        const auto [end, ec] = std::to_chars(buf, buf + sizeof(buf), b->data()[i]);
+        out.append(buf, end);
+      }
+      out += ")";
     },
 
-    [](const Null) -> std::string {
-      return "()";
+    [&](const Null) {
+      out += "()";
     },
 
-    [](const Void) -> std::string {
-      return "#<void>";
+    [&](const Void) {
+      out += "#<void>";
     },
 
   }, obj);
 }
 
+std::string 
+stringify(const Obj obj) {
+  std::string out;
+  stringify_into(out, obj);
+  return out;
 }
 
+}
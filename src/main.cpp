@@ -1,3 +1,4 @@
+#include <interpreter/image.hpp>
 #include <interpreter/input.hpp>
 #include <interpreter/interpreter.hpp>
 #include <interpreter/types.hpp>
@@ -21,10 +22,10 @@ make_reader(const std::optional<std::string>& filename, const bool enter_repl) {
 }
 
 Session
-make_session(const bool profiling, const bool enter_repl, const std::optional<std::string>& filename) {
+make_session(const bool profiling, const bool enter_repl, const std::optional<std::string>& filename, const std::optional<std::string>& image) {
   return Session(
     make_reader(filename, enter_repl), 
-    std::make_unique<Interpreter>(profiling)
+    std::make_unique<Interpreter>(profiling, image)
   );
 }
 
@@ -35,12 +36,15 @@ print_help() {
   std::cout << "Options:\n";
   std::cout << "  -h, --help     Show this help message\n";
   std::cout << "  -p, --profile  Enable profiling (show timing information)\n";
-  std::cout << "  -b, --batch    Run in batch mode (no REPL after script)\n\n";
+  std::cout << "  -b, --batch    Run in batch mode (no REPL after script)\n";
+  std::cout << "  -i, --image    Start from an image written by save-image\n";
+  std::cout << "  --save-preamble FILE  Write an image of the preamble (done by the build)\n\n";
   std::cout << "Examples:\n";
   std::cout << "  ./scheme                    Start interactive REPL\n";
   std::cout << "  ./scheme script.scm         Run script then enter REPL\n";
   std::cout << "  ./scheme -b script.scm      Run script in batch mode\n";
   std::cout << "  ./scheme -p script.scm      Run script with profiling\n";
+  std::cout << "  ./scheme -i lib.img app.scm Run script on top of a saved image\n";
 }
 
 int 
@@ -48,6 +52,8 @@ main(const int argc, const char **argv) {
   bool profiling = false;
   bool enter_repl = true;
   std::optional<std::string> filename = std::nullopt;
+  std::optional<std::string> image = std::nullopt;
+  std::optional<std::string> preamble_image = std::nullopt;
 
   for (int i = 1; i < argc; i++) {
     std::string arg = argv[i];
@@ -61,6 +67,12 @@ main(const int argc, const char **argv) {
       print_help();
       return 0;
     }
+    else if ((arg == "--image" || arg == "-i") && i + 1 < argc) {
+      image = std::string(argv[++i]);
+    }
+    else if (arg == "--save-preamble" && i + 1 < argc) {
+      preamble_image = std::string(argv[++i]);
+    }
     else if (!filename) {
       filename = std::string(argv[i]);
     }
@@ -71,6 +83,17 @@ main(const int argc, const char **argv) {
     }
   }
   
-  auto session = make_session(profiling, enter_repl, filename);
-  session.run();
+  try {
+    if (preamble_image) {
+      Interpreter interp {false, std::nullopt, false};
+      save_image(*preamble_image, interp);
+      return 0;
+    }
+    auto session = make_session(profiling, enter_repl, filename, image);
+    session.run();
+  }
+  catch (const std::exception& e) {
+    std::cerr << "ERROR: " << e.what() << std::endl;
+    return 1;
+  }
 }
@@ -0,0 +1,83 @@
+; every loop here runs ten million times in tail position. with no stack
+; segments allowed, a call that was not a tail call would overflow the
+; thread's own stack long before the end.
+(stack-limit 0)
+
+(define n 10000000)
+
+(define failures 0)
+
+(define (fail name message)
+  (set! failures (+ failures 1))
+  (display "FAIL ") (display name) (display ": ") (display message) (newline))
+
+(define (run-check name thunk expected)
+  (guard (e (#t (fail name (if (error-object? e) (error-object-message e) e))))
+    (let ((actual (thunk)))
+      (unless (equal? actual expected)
+        (fail name actual)))))
+
+(define-syntax check
+  (syntax-rules ()
+    ((_ name expr expected) (run-check name (lambda () expr) expected))))
+
+(define (count-if i)
+  (if (= i 0) 'done (count-if (- i 1))))
+(check "if" (count-if n) 'done)
+
+(define (count-cond i)
+  (cond ((= i 0) 'done)
+        ((odd? i) (count-cond (- i 1)))
+        (else (count-cond (- i 1)))))
+(check "cond" (count-cond n) 'done)
+
+(define (count-and i)
+  (and #t (or (= i 0) (count-and (- i 1)))))
+(check "and/or" (count-and n) #t)
+
+(define (count-when i)
+  (when (>= i 0) (if (= i 0) 'done (count-when (- i 1)))))
+(check "when" (count-when n) 'done)
+
+(define (count-unless i)
+  (unless (< i 0) (if (= i 0) 'done (count-unless (- i 1)))))
+(check "unless" (count-unless n) 'done)
+
+(define (count-begin i acc)
+  (begin
+    (set! acc (+ acc 1))
+    (if (= i 0) acc (count-begin (- i 1) acc))))
+(check "begin" (count-begin n 0) (+ n 1))
+
+(define (count-let i)
+  (let ((j (- i 1)))
+    (let* ((k j))
+      (letrec ((m k))
+        (if (< k 0) 'done (count-let m))))))
+(check "let, let* and letrec" (count-let n) 'done)
+
+(define (count-let-values i)
+  (let-values (((q r) (floor/ i 2)))
+    (if (= i 0) 'done (count-let-values (- i 1)))))
+(check "let-values" (count-let-values n) 'done)
+
+(define (my-even? i) (if (= i 0) #t (my-odd? (- i 1))))
+(define (my-odd? i) (if (= i 0) #f (my-even? (- i 1))))
+(check "mutual recursion" (my-even? n) #t)
+
+(check "named let"
+  (let loop ((i 0) (acc 0))
+    (if (= i n) acc (loop (+ i 1) (+ acc 1))))
+  n)
+
+(check "do"
+  (do ((i 0 (+ i 1)) (acc 0 (+ acc 2))) ((= i n) acc))
+  (* 2 n))
+
+(define (count-closure i)
+  ((lambda (j) (if (= j 0) 'done (count-closure (- j 1)))) i))
+(check "lambda body" (count-closure n) 'done)
+
+(if (= failures 0)
+    (begin (display "tail calls ok") (newline))
+    (error "tail call tests failed" failures))